@@ -6,6 +6,7 @@
 #include <csignal>
 #include <filesystem>
 #include <iostream>
+#include <string_view>
 
 int main(int argc, char** argv){
 #if defined(SIGPIPE)
@@ -17,15 +18,25 @@ int main(int argc, char** argv){
         argv, "certs/ca.crt.pem", "certs/ca.crt.pem"
     );
 
-    if(argc > 4){
-        std::cerr << "usage: " << argv[0] << " [ip] [port] [ca_path]" << "\n";
+    command_codec::wire_format format = command_codec::wire_format::text;
+
+    if(argc > 5){
+        std::cerr << "usage: " << argv[0] << " [ip] [port] [ca_path] [text|binary]" << "\n";
         return 1;
     }
     if(argc >= 2) ip = argv[1];
     if(argc >= 3) port = argv[2];
     if(argc >= 4) ca_path = argv[3];
+    if(argc >= 5){
+        std::string_view mode = argv[4];
+        if(mode == "binary") format = command_codec::wire_format::binary;
+        else if(mode != "text"){
+            std::cerr << "usage: " << argv[0] << " [ip] [port] [ca_path] [text|binary]" << "\n";
+            return 1;
+        }
+    }
 
-    auto client_exp = chat_client::create(ip.c_str(), port.c_str(), ca_path.string());
+    auto client_exp = chat_client::create(ip.c_str(), port.c_str(), ca_path.string(), format);
     if(!client_exp) return 1;
 
     client_console::print_line("connected to " + ip + ":" + port);
@@ -5,6 +5,8 @@
 #include "database/db_connector.hpp"
 #include "database/db_service.hpp"
 #include "net/tls_context.hpp"
+#include "search/message_index.hpp"
+#include "server/server_options.hpp"
 #include <cerrno>
 #include <csignal>
 #include <ctime>
@@ -20,7 +22,6 @@ const char* signal_to_string(int sig){
 }
 
 int main(int argc, char** argv){
-    (void)argc;
 #if defined(SIGPIPE)
     std::signal(SIGPIPE, SIG_IGN);
 #endif
@@ -72,10 +73,17 @@ int main(int argc, char** argv){
     std::string db_password =
         config_loader::trim_wrapping_quotes(config_loader::get_or(env, "db.password", ""));
 
-    std::string server_port = config_loader::get_or(cfg, "server.port", "8080");
+    // An explicit port lets several nodes share one config on a host.
+    std::string server_port = argc > 1 ? argv[1] : config_loader::get_or(cfg, "server.port", "8080");
     std::string tls_cert_raw = config_loader::get_or(cfg, "tls.cert", "");
     std::string tls_key_raw = config_loader::get_or(cfg, "tls.key", "");
 
+    auto opts_exp = server_options::from_config(cfg);
+    if(!opts_exp){
+        logger::log_error("invalid server options", __func__, opts_exp);
+        return 1;
+    }
+
     std::string tls_cert_path = path_util::resolve_from_root(root_path, tls_cert_raw).string();
     std::string tls_key_path = path_util::resolve_from_root(root_path, tls_key_raw).string();
 
@@ -89,6 +97,68 @@ int main(int argc, char** argv){
     logger::log_info("db connect success / cert = " + tls_cert_raw + " / key = " + tls_key_raw);
 
     db_service db(*db_exp);
+
+    // LISTEN ties up its session, so cluster fan-out gets a connection of its own.
+    const cluster_options& cluster = opts_exp->cluster;
+    const bool use_notify = cluster.enabled && cluster.transport == cluster_transport::notify;
+    auto notify_db_exp = use_notify
+        ? db_connector::create(db_host, db_port, db_name, db_user, db_password)
+        : std::expected<db_connector, error_code>(std::unexpect, error_code{});
+    if(use_notify){
+        if(!notify_db_exp){
+            logger::log_error("cluster notify db connect failed", __func__, notify_db_exp);
+            return 1;
+        }
+        db.set_room_notify(cluster.channel, cluster.node_id);
+        logger::log_info("cluster fan-out enabled / node = " + cluster.node_id);
+    } else if(cluster.enabled){
+        logger::log_info("cluster fan-out enabled / bus = " + cluster.bus_listen.to_string());
+    }
+
+    message_index search_index;
+    const std::string& index_raw = opts_exp->search.index_path;
+    if(!index_raw.empty()){
+        const std::string index_path = path_util::resolve_from_root(root_path, index_raw).string();
+        auto open_exp = search_index.open(index_path);
+        if(!open_exp){
+            logger::log_error("search index open failed", __func__, open_exp);
+            return 1;
+        }
+        db.set_search_index(&search_index);
+    }
+
+    const message_partition_options& partitions = opts_exp->partitions;
+    auto partitions_exp = db.maintain_message_partitions(
+        partitions.partition_rows, partitions.partitions_ahead, partitions.retention_days
+    );
+    if(!partitions_exp){
+        logger::log_error("message partition maintenance failed", __func__, partitions_exp);
+        return 1;
+    }
+    logger::log_info(
+        "message partitions created " + std::to_string(partitions_exp->created)
+        + " / detached " + std::to_string(partitions_exp->detached)
+        + " / first message id " + std::to_string(partitions_exp->first_message_id)
+    );
+
+    if(search_index.is_open()){
+        auto sync_exp = db.sync_search_index();
+        if(!sync_exp){
+            logger::log_error("search index sync failed", __func__, sync_exp);
+            return 1;
+        }
+        auto compact_exp = db.compact_search_index();
+        if(!compact_exp){
+            logger::log_error("search index compaction failed", __func__, compact_exp);
+            return 1;
+        }
+        logger::log_info(
+            "search index ready / rooms = " + std::to_string(search_index.room_count())
+            + " / indexed at startup = " + std::to_string(*sync_exp)
+            + " / reclaimed bytes = " + std::to_string(*compact_exp)
+        );
+    }
+
     auto tls_ctx_exp = tls_context::create_server(tls_cert_path, tls_key_path);
     if(!tls_ctx_exp){
         logger::log_error("tls context create failed", __func__, tls_ctx_exp);
@@ -96,7 +166,10 @@ int main(int argc, char** argv){
     }
     logger::log_info("tls context create success");
 
-    auto server_exp = epoll_server::create(server_port.c_str(), db, std::move(*tls_ctx_exp));
+    auto server_exp = epoll_server::create(
+        server_port.c_str(), db, std::move(*tls_ctx_exp), *opts_exp,
+        notify_db_exp ? &*notify_db_exp : nullptr, search_index.is_open() ? &search_index : nullptr
+    );
     if(!server_exp) return 1;
     logger::log_info("server create success");
 
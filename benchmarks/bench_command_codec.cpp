@@ -0,0 +1,141 @@
+#include "bench_fixture.hpp"
+#include "protocol/command_codec.hpp"
+#include <array>
+#include <benchmark/benchmark.h>
+#include <string>
+
+template<class T>
+static void bm_encode(benchmark::State& state){
+    const command_codec::command cmd = bench::sample<T>();
+    std::size_t bytes = 0;
+    for(auto _ : state){
+        std::string wire = command_codec::encode(cmd);
+        bytes += wire.size();
+        benchmark::DoNotOptimize(wire);
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(bytes));
+}
+
+template<class T>
+static void bm_decode(benchmark::State& state){
+    const std::string wire = command_codec::encode(bench::sample<T>());
+    for(auto _ : state){
+        auto dec_exp = command_codec::decode(wire);
+        benchmark::DoNotOptimize(dec_exp);
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * wire.size()));
+}
+
+template<class T>
+static void bm_decode_materialize(benchmark::State& state){
+    const std::string wire = command_codec::encode(bench::sample<T>());
+    for(auto _ : state){
+        auto dec_exp = command_codec::decode(wire);
+        command_codec::command cmd = command_codec::materialize(*dec_exp);
+        benchmark::DoNotOptimize(cmd);
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * wire.size()));
+}
+
+template<class T>
+static void bm_encode_binary(benchmark::State& state){
+    const command_codec::command cmd = bench::sample<T>();
+    std::size_t bytes = 0;
+    for(auto _ : state){
+        std::string wire = command_codec::encode(cmd, command_codec::wire_format::binary);
+        bytes += wire.size();
+        benchmark::DoNotOptimize(wire);
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(bytes));
+}
+
+template<class T>
+static void bm_decode_binary(benchmark::State& state){
+    const std::string wire = command_codec::encode(bench::sample<T>(), command_codec::wire_format::binary);
+    for(auto _ : state){
+        std::string_view payload;
+        auto frame_exp = command_codec::read_binary_frame(wire, payload);
+        auto dec_exp = command_codec::decode_binary(payload);
+        benchmark::DoNotOptimize(frame_exp);
+        benchmark::DoNotOptimize(dec_exp);
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * wire.size()));
+}
+
+// Name lookup alone, cycling through every command name plus one miss.
+static void bm_find_descriptor(benchmark::State& state){
+    const std::array<std::string_view, 20> names{
+        "say", "nick", "response", "login", "register", "friend_request", "friend_accept",
+        "friend_reject", "friend_remove", "list_friend", "list_friend_request", "create_room",
+        "delete_room", "invite_room", "leave_room", "list_room", "history", "history_before",
+        "search", "not_a_command"
+    };
+    std::size_t i = 0;
+    for(auto _ : state){
+        const auto* d = command_codec::find_descriptor(names[i]);
+        benchmark::DoNotOptimize(d);
+        if(++i == names.size()) i = 0;
+    }
+}
+
+static void bm_decode_invalid(benchmark::State& state){
+    const std::string wire = "not_a_command\rfoo\rbar\n";
+    for(auto _ : state){
+        auto dec_exp = command_codec::decode(wire);
+        benchmark::DoNotOptimize(dec_exp);
+    }
+}
+
+BENCHMARK_TEMPLATE(bm_encode, command_codec::cmd_say);
+BENCHMARK_TEMPLATE(bm_encode, command_codec::cmd_nick);
+BENCHMARK_TEMPLATE(bm_encode, command_codec::cmd_response);
+BENCHMARK_TEMPLATE(bm_encode, command_codec::cmd_login);
+BENCHMARK_TEMPLATE(bm_encode, command_codec::cmd_register);
+BENCHMARK_TEMPLATE(bm_encode, command_codec::cmd_friend_request);
+BENCHMARK_TEMPLATE(bm_encode, command_codec::cmd_friend_accept);
+BENCHMARK_TEMPLATE(bm_encode, command_codec::cmd_friend_reject);
+BENCHMARK_TEMPLATE(bm_encode, command_codec::cmd_friend_remove);
+BENCHMARK_TEMPLATE(bm_encode, command_codec::cmd_list_friend);
+BENCHMARK_TEMPLATE(bm_encode, command_codec::cmd_list_friend_request);
+BENCHMARK_TEMPLATE(bm_encode, command_codec::cmd_create_room);
+BENCHMARK_TEMPLATE(bm_encode, command_codec::cmd_delete_room);
+BENCHMARK_TEMPLATE(bm_encode, command_codec::cmd_invite_room);
+BENCHMARK_TEMPLATE(bm_encode, command_codec::cmd_leave_room);
+BENCHMARK_TEMPLATE(bm_encode, command_codec::cmd_list_room);
+BENCHMARK_TEMPLATE(bm_encode, command_codec::cmd_history);
+BENCHMARK_TEMPLATE(bm_encode, command_codec::cmd_history_before);
+BENCHMARK_TEMPLATE(bm_encode, command_codec::cmd_search);
+BENCHMARK_TEMPLATE(bm_encode, command_codec::cmd_ping);
+
+BENCHMARK_TEMPLATE(bm_decode, command_codec::cmd_say);
+BENCHMARK_TEMPLATE(bm_decode, command_codec::cmd_nick);
+BENCHMARK_TEMPLATE(bm_decode, command_codec::cmd_response);
+BENCHMARK_TEMPLATE(bm_decode, command_codec::cmd_login);
+BENCHMARK_TEMPLATE(bm_decode, command_codec::cmd_register);
+BENCHMARK_TEMPLATE(bm_decode, command_codec::cmd_friend_request);
+BENCHMARK_TEMPLATE(bm_decode, command_codec::cmd_friend_accept);
+BENCHMARK_TEMPLATE(bm_decode, command_codec::cmd_friend_reject);
+BENCHMARK_TEMPLATE(bm_decode, command_codec::cmd_friend_remove);
+BENCHMARK_TEMPLATE(bm_decode, command_codec::cmd_list_friend);
+BENCHMARK_TEMPLATE(bm_decode, command_codec::cmd_list_friend_request);
+BENCHMARK_TEMPLATE(bm_decode, command_codec::cmd_create_room);
+BENCHMARK_TEMPLATE(bm_decode, command_codec::cmd_delete_room);
+BENCHMARK_TEMPLATE(bm_decode, command_codec::cmd_invite_room);
+BENCHMARK_TEMPLATE(bm_decode, command_codec::cmd_leave_room);
+BENCHMARK_TEMPLATE(bm_decode, command_codec::cmd_list_room);
+BENCHMARK_TEMPLATE(bm_decode, command_codec::cmd_history);
+BENCHMARK_TEMPLATE(bm_decode, command_codec::cmd_history_before);
+BENCHMARK_TEMPLATE(bm_decode, command_codec::cmd_search);
+BENCHMARK_TEMPLATE(bm_decode, command_codec::cmd_ping);
+BENCHMARK_TEMPLATE(bm_decode_materialize, command_codec::cmd_say);
+BENCHMARK_TEMPLATE(bm_decode_materialize, command_codec::cmd_login);
+BENCHMARK_TEMPLATE(bm_decode_materialize, command_codec::cmd_list_room);
+BENCHMARK_TEMPLATE(bm_encode_binary, command_codec::cmd_say);
+BENCHMARK_TEMPLATE(bm_encode_binary, command_codec::cmd_login);
+BENCHMARK_TEMPLATE(bm_encode_binary, command_codec::cmd_list_room);
+BENCHMARK_TEMPLATE(bm_encode_binary, command_codec::cmd_ping);
+BENCHMARK_TEMPLATE(bm_decode_binary, command_codec::cmd_say);
+BENCHMARK_TEMPLATE(bm_decode_binary, command_codec::cmd_login);
+BENCHMARK_TEMPLATE(bm_decode_binary, command_codec::cmd_list_room);
+BENCHMARK(bm_find_descriptor);
+BENCHMARK(bm_decode_invalid);
@@ -0,0 +1,169 @@
+#include "bench_fixture.hpp"
+#include "core/logger.hpp"
+#include "reactor/epoll_registry.hpp"
+#include <benchmark/benchmark.h>
+#include <sys/epoll.h>
+#include <string>
+#include <vector>
+
+namespace{
+    constexpr std::int64_t bench_room_id = 1;
+
+    struct room_fixture{
+        epoll_registry registry;
+        std::vector<conn_handle> members;
+        std::vector<unique_fd> peers;
+
+        static epoll_wakeup make_wakeup(){
+            auto wakeup_exp = epoll_wakeup::create();
+            if(!wakeup_exp) throw std::runtime_error("epoll_wakeup::create failed");
+            return std::move(*wakeup_exp);
+        }
+
+        explicit room_fixture(int member_count, send_limits limits = {}) :
+            registry(make_wakeup(), bench::server_tls_context(), limits){
+            logger::set_log_level(logger::log_level::warn);
+            std::vector<int> fds;
+            for(int i = 0; i < member_count; ++i){
+                auto [local, peer] = bench::make_socket_pair();
+                fds.push_back(local.get());
+                registry.request_register(std::move(local), EPOLLIN | EPOLLRDHUP);
+                peers.push_back(std::move(peer));
+            }
+            registry.work();
+
+            for(int fd : fds) members.push_back(registry.find(fd)->handle);
+            for(conn_handle conn : members) registry.request_set_joined_rooms(conn, {bench_room_id});
+            registry.work();
+        }
+
+        void drop_pending_send(conn_handle conn){
+            socket_info* si = registry.find(conn);
+            if(si == nullptr) return;
+            si->send.clear();
+        }
+
+        void drop_pending_send(){
+            for(conn_handle conn : members) drop_pending_send(conn);
+        }
+    };
+}
+
+// One chat line fanned out to every member of a room. Send buffers are reset
+// between iterations, as if every member flushed, so each iteration also pays
+// for the EPOLLOUT re-arm an idle member costs in production.
+static void bm_room_broadcast(benchmark::State& state){
+    room_fixture fx(static_cast<int>(state.range(0)));
+    const conn_handle sender = fx.members.front();
+
+    const std::size_t allocs_before = bench::alloc_count();
+    for(auto _ : state){
+        fx.registry.request_room_broadcast(
+            sender, bench_room_id, command_codec::cmd_response{"hello everyone in this room"}
+        );
+        fx.registry.work();
+        fx.drop_pending_send();
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.counters["allocs_per_op"] = benchmark::Counter(
+        static_cast<double>(bench::alloc_count() - allocs_before), benchmark::Counter::kAvgIterations
+    );
+}
+
+static void bm_send_one(benchmark::State& state){
+    room_fixture fx(static_cast<int>(state.range(0)));
+    const conn_handle target = fx.members.back();
+
+    const std::size_t allocs_before = bench::alloc_count();
+    for(auto _ : state){
+        fx.registry.request_send(target, command_codec::cmd_response{"login success"});
+        fx.registry.work();
+        fx.drop_pending_send(target);
+    }
+
+    state.counters["allocs_per_op"] = benchmark::Counter(
+        static_cast<double>(bench::alloc_count() - allocs_before), benchmark::Counter::kAvgIterations
+    );
+}
+
+// Every member is already over the high watermark and never drains, so each
+// broadcast only pays for the drop accounting.
+// A page of history rows for one connection: range(1) = 0 queues one
+// request_send per row, 1 queues the page as a single response_block.
+static void bm_history_page(benchmark::State& state){
+    room_fixture fx(1);
+    const conn_handle target = fx.members.front();
+    const int rows = static_cast<int>(state.range(0));
+    const bool as_block = state.range(1) != 0;
+    const std::string row = "history: id=123456 at=2026-01-01 00:00:00+00 from=bench_user text=hello everyone in this room";
+
+    const std::size_t allocs_before = bench::alloc_count();
+    for(auto _ : state){
+        if(as_block){
+            response_block block;
+            for(int i = 0; i < rows; ++i) block.push({row});
+            fx.registry.request_send_block(target, std::move(block));
+        }
+        else{
+            for(int i = 0; i < rows; ++i) fx.registry.request_send(target, command_codec::cmd_response{row});
+        }
+        fx.registry.work();
+        fx.drop_pending_send(target);
+    }
+
+    state.SetItemsProcessed(state.iterations() * rows);
+    state.counters["allocs_per_op"] = benchmark::Counter(
+        static_cast<double>(bench::alloc_count() - allocs_before), benchmark::Counter::kAvgIterations
+    );
+}
+
+static void bm_room_broadcast_throttled(benchmark::State& state){
+    send_limits limits{};
+    limits.high_watermark = 1;
+    limits.low_watermark = 0;
+    limits.stall_timeout = std::chrono::hours(1);
+    room_fixture fx(static_cast<int>(state.range(0)), limits);
+    logger::set_log_level(logger::log_level::error);
+    const conn_handle sender = fx.members.front();
+
+    fx.registry.request_room_broadcast(sender, bench_room_id, command_codec::cmd_response{"fill"});
+    fx.registry.work();
+    for(auto _ : state){
+        fx.registry.request_room_broadcast(
+            sender, bench_room_id, command_codec::cmd_response{"hello everyone in this room"}
+        );
+        fx.registry.work();
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.counters["dropped"] = static_cast<double>(fx.registry.dropped_send_count());
+}
+
+// Logged-in members sitting in one room with nothing queued: the steady state
+// of most connections. Reports what the registry holds per connection; the
+// OpenSSL session is not included.
+static void bm_idle_connection_memory(benchmark::State& state){
+    room_fixture fx(static_cast<int>(state.range(0)));
+    for(std::size_t i = 0; i < fx.members.size(); ++i){
+        fx.registry.request_set_user_id(fx.members[i], "user" + std::to_string(i % 64));
+        fx.registry.request_set_joined_rooms(fx.members[i], {bench_room_id});
+    }
+    fx.registry.work();
+
+    conn_memory_report report;
+    for(auto _ : state){
+        report = fx.registry.memory_report();
+        benchmark::DoNotOptimize(report);
+    }
+
+    state.counters["record_bytes"] = static_cast<double>(sizeof(socket_info));
+    state.counters["heap_bytes"] = static_cast<double>(report.buffer_bytes) / report.connections;
+    state.counters["bytes_per_conn"] = static_cast<double>(report.per_connection());
+}
+
+BENCHMARK(bm_room_broadcast)->RangeMultiplier(4)->Range(1, 1024);
+BENCHMARK(bm_room_broadcast_throttled)->Arg(64)->Arg(1024);
+BENCHMARK(bm_send_one)->Arg(1)->Arg(1024);
+BENCHMARK(bm_history_page)->ArgsProduct({{100, 1000}, {0, 1}});
+BENCHMARK(bm_idle_connection_memory)->Arg(256)->Arg(1024);
@@ -0,0 +1,107 @@
+#include "bench_fixture.hpp"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <new>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace{
+    std::atomic<std::size_t> allocations{0};
+}
+
+void* operator new(std::size_t size){
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if(size == 0) size = 1;
+    if(void* p = std::malloc(size)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept{ std::free(p); }
+void operator delete(void* p, std::size_t) noexcept{ std::free(p); }
+
+std::size_t bench::alloc_count() noexcept{ return allocations.load(std::memory_order_relaxed); }
+
+namespace{
+    struct pkey_deleter{ void operator()(EVP_PKEY* p) const noexcept{ ::EVP_PKEY_free(p); } };
+    struct x509_deleter{ void operator()(X509* p) const noexcept{ ::X509_free(p); } };
+    struct file_deleter{ void operator()(FILE* p) const noexcept{ if(p) std::fclose(p); } };
+
+    std::filesystem::path write_self_signed_pair(){
+        std::unique_ptr<EVP_PKEY, pkey_deleter> key(::EVP_EC_gen("P-256"));
+        if(!key) throw std::runtime_error("EVP_EC_gen failed");
+
+        std::unique_ptr<X509, x509_deleter> cert(::X509_new());
+        ::ASN1_INTEGER_set(::X509_get_serialNumber(cert.get()), 1);
+        ::X509_gmtime_adj(::X509_getm_notBefore(cert.get()), 0);
+        ::X509_gmtime_adj(::X509_getm_notAfter(cert.get()), 60L * 60L * 24L);
+        ::X509_set_pubkey(cert.get(), key.get());
+
+        X509_NAME* name = ::X509_get_subject_name(cert.get());
+        ::X509_NAME_add_entry_by_txt(
+            name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("127.0.0.1"), -1, -1, 0
+        );
+        ::X509_set_issuer_name(cert.get(), name);
+        if(::X509_sign(cert.get(), key.get(), ::EVP_sha256()) == 0){
+            throw std::runtime_error("X509_sign failed");
+        }
+
+        char dir_template[] = "/tmp/socket_prac_bench_XXXXXX";
+        if(::mkdtemp(dir_template) == nullptr) throw std::runtime_error("mkdtemp failed");
+        std::filesystem::path dir(dir_template);
+
+        std::unique_ptr<FILE, file_deleter> cert_file(std::fopen((dir / "cert.pem").c_str(), "w"));
+        std::unique_ptr<FILE, file_deleter> key_file(std::fopen((dir / "key.pem").c_str(), "w"));
+        if(!cert_file || !key_file) throw std::runtime_error("cert/key file open failed");
+
+        ::PEM_write_X509(cert_file.get(), cert.get());
+        ::PEM_write_PrivateKey(key_file.get(), key.get(), nullptr, nullptr, 0, nullptr, nullptr);
+        return dir;
+    }
+}
+
+tls_context& bench::server_tls_context(){
+    static tls_context ctx = [](){
+        std::filesystem::path dir = write_self_signed_pair();
+        auto ctx_exp = tls_context::create_server((dir / "cert.pem").string(), (dir / "key.pem").string());
+        std::filesystem::remove_all(dir);
+        if(!ctx_exp) throw std::runtime_error("tls_context::create_server failed: " + to_string(ctx_exp.error()));
+        return std::move(*ctx_exp);
+    }();
+    return ctx;
+}
+
+tls_context& bench::client_tls_context(){
+    static tls_context ctx = [](){
+        auto ctx_exp = tls_context::create_client();
+        if(!ctx_exp) throw std::runtime_error("tls_context::create_client failed: " + to_string(ctx_exp.error()));
+        ::SSL_CTX_set_verify(ctx_exp->get(), SSL_VERIFY_NONE, nullptr);
+        return std::move(*ctx_exp);
+    }();
+    return ctx;
+}
+
+std::pair<unique_fd, unique_fd> bench::make_socket_pair(){
+    int sv[2]{-1, -1};
+    if(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) == -1){
+        throw std::runtime_error("socketpair failed");
+    }
+    return {unique_fd(sv[0]), unique_fd(sv[1])};
+}
+
+std::string bench::make_pipelined_lines(std::size_t line_count, std::size_t text_size){
+    const std::string line = command_codec::encode(
+        command_codec::cmd_say{"42", std::string(text_size, 'x')}
+    );
+
+    std::string out;
+    out.reserve(line.size() * line_count);
+    for(std::size_t i = 0; i < line_count; ++i) out += line;
+    return out;
+}
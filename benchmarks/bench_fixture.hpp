@@ -0,0 +1,43 @@
+#pragma once
+#include "core/unique_fd.hpp"
+#include "net/tls_context.hpp"
+#include "protocol/command_codec.hpp"
+#include <cstddef>
+#include <string>
+#include <utility>
+
+namespace bench{
+    tls_context& server_tls_context();
+    // Trusts any server certificate; only for talking to server_tls_context().
+    tls_context& client_tls_context();
+    std::pair<unique_fd, unique_fd> make_socket_pair();
+    std::string make_pipelined_lines(std::size_t line_count, std::size_t text_size);
+
+    // Calls to the global operator new since start, across all threads.
+    std::size_t alloc_count() noexcept;
+
+    template<class T> T sample();
+}
+
+namespace bench{
+    template<> inline command_codec::cmd_say sample(){ return {"42", "hello everyone in this room"}; }
+    template<> inline command_codec::cmd_nick sample(){ return {"bench_nick"}; }
+    template<> inline command_codec::cmd_response sample(){ return {"bench_nick: hello everyone in this room"}; }
+    template<> inline command_codec::cmd_login sample(){ return {"bench_user", "bench_password"}; }
+    template<> inline command_codec::cmd_register sample(){ return {"bench_user", "bench_password"}; }
+    template<> inline command_codec::cmd_friend_request sample(){ return {"bench_friend"}; }
+    template<> inline command_codec::cmd_friend_accept sample(){ return {"bench_friend"}; }
+    template<> inline command_codec::cmd_friend_reject sample(){ return {"bench_friend"}; }
+    template<> inline command_codec::cmd_friend_remove sample(){ return {"bench_friend"}; }
+    template<> inline command_codec::cmd_list_friend sample(){ return {}; }
+    template<> inline command_codec::cmd_list_friend_request sample(){ return {}; }
+    template<> inline command_codec::cmd_create_room sample(){ return {"bench_room"}; }
+    template<> inline command_codec::cmd_delete_room sample(){ return {"42"}; }
+    template<> inline command_codec::cmd_invite_room sample(){ return {"42", "bench_friend"}; }
+    template<> inline command_codec::cmd_leave_room sample(){ return {"42"}; }
+    template<> inline command_codec::cmd_list_room sample(){ return {}; }
+    template<> inline command_codec::cmd_history sample(){ return {"42", "50"}; }
+    template<> inline command_codec::cmd_ping sample(){ return {}; }
+    template<> inline command_codec::cmd_history_before sample(){ return {"42", "200", "123456"}; }
+    template<> inline command_codec::cmd_search sample(){ return {"42", "deploy window friday"}; }
+}
@@ -0,0 +1,113 @@
+#include "bench_fixture.hpp"
+#include "core/constant.hpp"
+#include "net/io_helper.hpp"
+#include "protocol/frame_scanner.hpp"
+#include "protocol/line_parser.hpp"
+#include <array>
+#include <benchmark/benchmark.h>
+#include <string>
+
+// Two-pass path: find('\n') per frame, then find('\r') per token.
+static void bm_split_find(benchmark::State& state){
+    const std::string burst = bench::make_pipelined_lines(
+        static_cast<std::size_t>(state.range(0)), static_cast<std::size_t>(state.range(1))
+    );
+
+    recv_buffer buf;
+    std::size_t lines = 0;
+    for(auto _ : state){
+        buf.append(burst.data(), burst.size());
+        while(auto line = line_parser::parse_line(buf)){
+            auto info = command_codec::decode_line(*line);
+            benchmark::DoNotOptimize(info);
+            ++lines;
+        }
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(lines));
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * burst.size()));
+}
+
+// Single sweep over the burst with the kernel selected by range(2).
+static void bm_split_scan(benchmark::State& state){
+    const auto isa = static_cast<frame_scanner::scan_isa>(state.range(2));
+    if(!frame_scanner::isa_supported(isa)){
+        state.SkipWithError("isa not supported on this cpu");
+        return;
+    }
+    state.SetLabel(std::string(frame_scanner::isa_name(isa)));
+
+    const std::string burst = bench::make_pipelined_lines(
+        static_cast<std::size_t>(state.range(0)), static_cast<std::size_t>(state.range(1))
+    );
+
+    std::array<frame_scanner::frame, FRAME_BATCH> frames;
+    std::size_t lines = 0;
+    for(auto _ : state){
+        std::string_view rest = burst;
+        while(true){
+            std::size_t consumed = 0;
+            std::size_t count = frame_scanner::scan(rest, frames, consumed, isa);
+            if(count == 0) break;
+            benchmark::DoNotOptimize(frames);
+            lines += count;
+            rest.remove_prefix(consumed);
+        }
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(lines));
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * burst.size()));
+}
+
+static void bm_parse_frames_and_decode(benchmark::State& state){
+    const std::string burst = bench::make_pipelined_lines(static_cast<std::size_t>(state.range(0)), 64);
+
+    recv_buffer buf;
+    std::array<frame_scanner::frame, FRAME_BATCH> frames;
+    std::size_t lines = 0;
+    for(auto _ : state){
+        buf.append(burst.data(), burst.size());
+        while(std::size_t count = line_parser::parse_frames(buf, frames)){
+            for(std::size_t i = 0; i < count; ++i){
+                auto dec_exp = command_codec::decode(frames[i].info);
+                benchmark::DoNotOptimize(dec_exp);
+            }
+            lines += count;
+        }
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(lines));
+}
+
+// Binary framing of the same `say` commands: cost follows field count, not bytes.
+static void bm_parse_binary_frames(benchmark::State& state){
+    const std::size_t line_count = static_cast<std::size_t>(state.range(0));
+    const command_codec::command cmd = command_codec::cmd_say{
+        "1", std::string(static_cast<std::size_t>(state.range(1)), 'x')
+    };
+    std::string burst;
+    for(std::size_t i = 0; i < line_count; ++i){
+        burst += command_codec::encode(cmd, command_codec::wire_format::binary);
+    }
+
+    recv_buffer buf;
+    std::size_t lines = 0;
+    for(auto _ : state){
+        buf.append(burst.data(), burst.size());
+        while(true){
+            auto frame_exp = line_parser::parse_binary_frame(buf);
+            if(!frame_exp || !*frame_exp) break;
+            auto dec_exp = command_codec::decode_binary(**frame_exp);
+            benchmark::DoNotOptimize(dec_exp);
+            ++lines;
+        }
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(lines));
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * burst.size()));
+}
+
+BENCHMARK(bm_split_find)->ArgsProduct({{16, 256}, {16, 256}});
+BENCHMARK(bm_split_scan)->ArgsProduct({{16, 256}, {16, 256}, {0, 1, 2}});
+BENCHMARK(bm_parse_frames_and_decode)->Arg(1)->Arg(16)->Arg(256);
+BENCHMARK(bm_parse_binary_frames)->ArgsProduct({{16, 256}, {16, 256}});
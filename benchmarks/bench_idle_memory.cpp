@@ -0,0 +1,120 @@
+#include "bench_fixture.hpp"
+#include "core/buffer_pool.hpp"
+#include "net/io_helper.hpp"
+#include "reactor/epoll_utility.hpp"
+#include <benchmark/benchmark.h>
+#include <fstream>
+#include <malloc.h>
+#include <memory>
+#include <stdexcept>
+#include <unistd.h>
+#include <vector>
+
+namespace{
+    std::size_t heap_in_use(){ return ::mallinfo2().uordblks; }
+
+    std::size_t pool_bytes_in_use(){
+        const buffer_pool::stats st = buffer_pool::local().get_stats();
+        std::size_t bytes = 0;
+        for(std::size_t cls = 0; cls < st.in_use.size(); ++cls) bytes += st.in_use[cls] * buffer_pool::CLASS_SIZES[cls];
+        return bytes;
+    }
+
+    std::size_t resident_bytes(){
+        std::ifstream statm("/proc/self/statm");
+        std::size_t size = 0;
+        std::size_t resident = 0;
+        statm >> size >> resident;
+        return resident * static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    }
+
+    socket_info make_endpoint(unique_fd fd, tls_context& ctx){
+        if(!epoll_utility::set_nonblocking(fd.get())) throw std::runtime_error("set_nonblocking failed");
+
+        auto tls_exp = ctx.is_server()
+            ? tls_session::create_server(ctx, fd.get())
+            : tls_session::create_client(ctx, fd.get(), "127.0.0.1");
+        if(!tls_exp) throw std::runtime_error("tls_session create failed");
+
+        socket_info si{};
+        si.tls = std::move(*tls_exp);
+        si.ufd = std::move(fd);
+        return si;
+    }
+
+    void handshake(socket_info& server, socket_info& client){
+        for(int i = 0; i < 64; ++i){
+            if(server.tls.is_handshake_done() && client.tls.is_handshake_done()) return;
+            if(!client.tls.is_handshake_done() && !client.tls.handshake()) break;
+            if(!server.tls.is_handshake_done() && !server.tls.handshake()) break;
+        }
+        throw std::runtime_error("tls handshake failed");
+    }
+
+    // Moves one command from `from` to `to` and consumes it, leaving both
+    // buffers drained the way an idle connection looks after its last message.
+    void exchange(socket_info& from, socket_info& to, bool release){
+        from.send.append(bench::sample<command_codec::cmd_response>());
+        if(!flush_send(from) || !drain_recv(to)) throw std::runtime_error("tls exchange failed");
+        to.recv.advance(to.recv.remaining());
+
+        if(!release) return;
+        from.send.release_if_done();
+        to.recv.release_if_done();
+    }
+}
+
+// Logged-in connections after one message each way, then idle. Counts both
+// TLS ends of every socketpair, so the per-connection figures are half of a
+// pair. range(0) toggles SSL_MODE_RELEASE_BUFFERS and drained buffer release.
+static void bm_idle_tls_connection_memory(benchmark::State& state){
+    const bool release = state.range(0) != 0;
+    const int pairs = static_cast<int>(state.range(1));
+    tls_context& server_ctx = bench::server_tls_context();
+    tls_context& client_ctx = bench::client_tls_context();
+    server_ctx.set_release_buffers(release);
+    client_ctx.set_release_buffers(release);
+
+    std::size_t heap_delta = 0;
+    std::size_t pool_delta = 0;
+    std::size_t rss_delta = 0;
+    for(auto _ : state){
+        ::malloc_trim(0);
+        const std::size_t heap_before = heap_in_use();
+        const std::size_t pool_before = pool_bytes_in_use();
+        const std::size_t rss_before = resident_bytes();
+
+        std::vector<std::unique_ptr<socket_info>> conns;
+        conns.reserve(static_cast<std::size_t>(pairs) * 2);
+        for(int i = 0; i < pairs; ++i){
+            auto [local, peer] = bench::make_socket_pair();
+            auto server = std::make_unique<socket_info>(make_endpoint(std::move(local), server_ctx));
+            auto client = std::make_unique<socket_info>(make_endpoint(std::move(peer), client_ctx));
+            handshake(*server, *client);
+            exchange(*client, *server, release);
+            exchange(*server, *client, release);
+            conns.push_back(std::move(server));
+            conns.push_back(std::move(client));
+        }
+
+        heap_delta = heap_in_use() - heap_before;
+        pool_delta = pool_bytes_in_use() - pool_before;
+        rss_delta = resident_bytes() - rss_before;
+        state.PauseTiming();
+        conns.clear();
+        state.ResumeTiming();
+    }
+
+    server_ctx.set_release_buffers(true);
+    client_ctx.set_release_buffers(true);
+    state.counters["heap_per_conn"] = static_cast<double>(heap_delta) / (pairs * 2);
+    state.counters["pool_per_conn"] = static_cast<double>(pool_delta) / (pairs * 2);
+    state.counters["rss_per_conn"] = static_cast<double>(rss_delta) / (pairs * 2);
+}
+
+BENCHMARK(bm_idle_tls_connection_memory)
+    ->ArgNames({"release", "pairs"})
+    ->Args({0, 512})
+    ->Args({1, 512})
+    ->Iterations(1)
+    ->Unit(benchmark::kMillisecond);
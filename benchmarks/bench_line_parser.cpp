@@ -0,0 +1,67 @@
+#include "bench_fixture.hpp"
+#include "net/io_helper.hpp"
+#include "protocol/line_parser.hpp"
+#include <benchmark/benchmark.h>
+#include <string>
+
+// One recv burst carrying range(0) pipelined `say` lines, parsed the way
+// epoll_server::handle_execute drains the recv buffer.
+static void bm_parse_pipelined(benchmark::State& state){
+    const std::size_t line_count = static_cast<std::size_t>(state.range(0));
+    const std::string burst = bench::make_pipelined_lines(line_count, static_cast<std::size_t>(state.range(1)));
+
+    recv_buffer buf;
+    std::size_t lines = 0;
+    for(auto _ : state){
+        buf.append(burst.data(), burst.size());
+        while(auto line = line_parser::parse_line(buf)){
+            benchmark::DoNotOptimize(*line);
+            ++lines;
+        }
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(lines));
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * burst.size()));
+}
+
+// Same burst split at BUF_SIZE boundaries, so lines straddle recv calls.
+static void bm_parse_chunked(benchmark::State& state){
+    const std::string burst = bench::make_pipelined_lines(static_cast<std::size_t>(state.range(0)), 64);
+
+    recv_buffer buf;
+    std::size_t lines = 0;
+    for(auto _ : state){
+        for(std::size_t pos = 0; pos < burst.size(); pos += BUF_SIZE){
+            const std::size_t n = std::min<std::size_t>(BUF_SIZE, burst.size() - pos);
+            buf.append(burst.data() + pos, n);
+            while(auto line = line_parser::parse_line(buf)){
+                benchmark::DoNotOptimize(*line);
+                ++lines;
+            }
+        }
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(lines));
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * burst.size()));
+}
+
+static void bm_parse_and_decode(benchmark::State& state){
+    const std::string burst = bench::make_pipelined_lines(static_cast<std::size_t>(state.range(0)), 64);
+
+    recv_buffer buf;
+    std::size_t lines = 0;
+    for(auto _ : state){
+        buf.append(burst.data(), burst.size());
+        while(auto line = line_parser::parse_line(buf)){
+            auto dec_exp = command_codec::decode(*line);
+            benchmark::DoNotOptimize(dec_exp);
+            ++lines;
+        }
+    }
+
+    state.SetItemsProcessed(static_cast<std::int64_t>(lines));
+}
+
+BENCHMARK(bm_parse_pipelined)->ArgsProduct({{1, 16, 256}, {16, 256}});
+BENCHMARK(bm_parse_chunked)->Arg(256)->Arg(4096);
+BENCHMARK(bm_parse_and_decode)->Arg(1)->Arg(16)->Arg(256);
@@ -0,0 +1,73 @@
+#include "search/message_index.hpp"
+#include <benchmark/benchmark.h>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+namespace{
+    constexpr std::int64_t bench_room_id = 1;
+
+    // Messages of twelve words drawn from a 2000-word vocabulary with a
+    // skewed distribution, so common words have long posting lists.
+    struct index_fixture{
+        std::filesystem::path path;
+        message_index index;
+
+        static std::string word(std::size_t n){ return "w" + std::to_string(n); }
+
+        explicit index_fixture(std::size_t messages) :
+            path(std::filesystem::temp_directory_path() / ("bench_search_" + std::to_string(::getpid()) + ".idx")){
+            std::filesystem::remove(path);
+            if(!index.open(path.string())) throw std::runtime_error("message_index::open failed");
+
+            std::uint64_t seed = 88172645463325252ull;
+            std::string body;
+            for(std::size_t i = 1; i <= messages; ++i){
+                body.clear();
+                for(int w = 0; w < 12; ++w){
+                    seed ^= seed << 13;
+                    seed ^= seed >> 7;
+                    seed ^= seed << 17;
+                    const std::size_t r = seed % 2000;
+                    body += word(r * r / 2000) + " ";
+                }
+                if(!index.add(bench_room_id, static_cast<std::int64_t>(i), "bench_user", body)){
+                    throw std::runtime_error("message_index::add failed");
+                }
+            }
+        }
+
+        ~index_fixture(){ std::filesystem::remove(path); }
+    };
+}
+
+// Two-term AND query in one room; range(1) picks a common pair or a pair of
+// mid-frequency words.
+static void bm_search_room(benchmark::State& state){
+    index_fixture fx(static_cast<std::size_t>(state.range(0)));
+    const std::string terms = state.range(1) == 0 ? "w0 w1" : "w400 w900";
+
+    std::size_t found = 0;
+    for(auto _ : state){
+        auto matches = fx.index.search(bench_room_id, terms, 20);
+        found = matches.size();
+        benchmark::DoNotOptimize(matches.data());
+    }
+    state.counters["matches"] = static_cast<double>(found);
+}
+
+// Cost of indexing one stored message, including the log append.
+static void bm_index_add(benchmark::State& state){
+    index_fixture fx(0);
+    const std::string body = "deploy window moved to friday after the release review";
+    std::int64_t id = 0;
+    for(auto _ : state){
+        auto add_exp = fx.index.add(bench_room_id, ++id, "bench_user", body);
+        benchmark::DoNotOptimize(add_exp);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(bm_search_room)->Args({10000, 0})->Args({10000, 1})->Args({100000, 0})->Args({100000, 1});
+BENCHMARK(bm_index_add);
@@ -0,0 +1,98 @@
+#include "bench_fixture.hpp"
+#include "core/buffer_pool.hpp"
+#include "net/io_helper.hpp"
+#include <benchmark/benchmark.h>
+#include <string>
+
+// Broadcast-style appends followed by a full flush, the common case for a
+// client that keeps up with its room.
+static void bm_send_append_flush(benchmark::State& state){
+    const std::string msg(static_cast<std::size_t>(state.range(0)), 'm');
+    const int burst = static_cast<int>(state.range(1));
+
+    send_buffer buf;
+    for(auto _ : state){
+        for(int i = 0; i < burst; ++i) buf.append(msg);
+        buf.advance(buf.remaining());
+        buf.clear_if_done();
+    }
+
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * burst * msg.size()));
+}
+
+// Partial writes: the socket accepts only part of what is pending each round,
+// so the buffer keeps a tail and relies on compact_if_needed.
+static void bm_send_partial_flush(benchmark::State& state){
+    const std::string msg(static_cast<std::size_t>(state.range(0)), 'm');
+    const std::size_t write_size = static_cast<std::size_t>(state.range(1));
+
+    send_buffer buf;
+    for(auto _ : state){
+        for(int i = 0; i < 8; ++i) buf.append(msg);
+        while(buf.remaining() > write_size){
+            buf.advance(write_size);
+            buf.compact_if_needed();
+        }
+    }
+
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * 8 * msg.size()));
+    state.counters["tail_bytes"] = static_cast<double>(buf.remaining());
+}
+
+static void bm_recv_append_consume(benchmark::State& state){
+    const std::string chunk(BUF_SIZE, 'r');
+    const std::size_t consume = static_cast<std::size_t>(state.range(0));
+
+    recv_buffer buf;
+    for(auto _ : state){
+        buf.append(chunk.data(), chunk.size());
+        while(buf.remaining() >= consume){
+            buf.advance(consume);
+            if(!buf.clear_if_done()) buf.compact_if_needed();
+        }
+    }
+
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * chunk.size()));
+}
+
+// A buffer that is taken and released once per message, which is what
+// release_drained does to a connection trading small messages.
+static void bm_buffer_release_cycle(benchmark::State& state){
+    const std::string msg(static_cast<std::size_t>(state.range(0)), 'm');
+
+    send_buffer buf;
+    for(auto _ : state){
+        buf.append(msg);
+        buf.advance(buf.remaining());
+        buf.release_if_done();
+    }
+
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * msg.size()));
+}
+
+// Raw pool round trip for each size class, against the general heap.
+static void bm_pool_chunk(benchmark::State& state){
+    const std::size_t size = static_cast<std::size_t>(state.range(0));
+    buffer_pool& pool = buffer_pool::local();
+    for(auto _ : state){
+        buffer_pool::block b = pool.allocate(size);
+        benchmark::DoNotOptimize(b.data);
+        buffer_pool::release(b.data);
+    }
+}
+
+static void bm_heap_chunk(benchmark::State& state){
+    const std::size_t size = static_cast<std::size_t>(state.range(0));
+    for(auto _ : state){
+        char* p = new char[size];
+        benchmark::DoNotOptimize(p);
+        delete[] p;
+    }
+}
+
+BENCHMARK(bm_send_append_flush)->ArgsProduct({{32, 512}, {1, 64}});
+BENCHMARK(bm_send_partial_flush)->ArgsProduct({{512, 4096}, {1024, 16384}});
+BENCHMARK(bm_recv_append_consume)->Arg(64)->Arg(1000);
+BENCHMARK(bm_buffer_release_cycle)->Arg(32)->Arg(512);
+BENCHMARK(bm_pool_chunk)->Arg(4000)->Arg(16000)->Arg(64000);
+BENCHMARK(bm_heap_chunk)->Arg(4000)->Arg(16000)->Arg(64000);
@@ -0,0 +1,44 @@
+#include "reactor/timer_wheel.hpp"
+#include <benchmark/benchmark.h>
+#include <vector>
+
+// Arm one deadline per connection, spread over the idle timeout range, then
+// walk the clock far enough for all of them to fire. Covers insert, cascade
+// and expiry.
+static void bm_timer_schedule_expire(benchmark::State& state){
+    const int timers = static_cast<int>(state.range(0));
+    const auto start = timer_wheel::clock::now();
+    std::vector<int> expired;
+    expired.reserve(static_cast<std::size_t>(timers));
+
+    for(auto _ : state){
+        timer_wheel wheel(std::chrono::milliseconds(100), start);
+        for(int fd = 0; fd < timers; ++fd){
+            wheel.schedule(fd, start + std::chrono::milliseconds(1000 + (fd * 7919) % 600000));
+        }
+
+        expired.clear();
+        for(auto now = start; wheel.size() > 0; now += std::chrono::seconds(1)){
+            wheel.advance(now, expired);
+        }
+        benchmark::DoNotOptimize(expired.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * timers);
+}
+
+// The event loop asks for the epoll_wait timeout once per wakeup.
+static void bm_timer_timeout_ms(benchmark::State& state){
+    const auto start = timer_wheel::clock::now();
+    timer_wheel wheel(std::chrono::milliseconds(100), start);
+    for(int fd = 0; fd < 1024; ++fd){
+        wheel.schedule(fd, start + std::chrono::seconds(10 + fd % 300));
+    }
+
+    for(auto _ : state){
+        benchmark::DoNotOptimize(wheel.timeout_ms(start));
+    }
+}
+
+BENCHMARK(bm_timer_schedule_expire)->Arg(1024)->Arg(16384);
+BENCHMARK(bm_timer_timeout_ms);
@@ -20,7 +20,8 @@ public:
     chat_client& operator=(chat_client&& other) noexcept = delete;
 
     static std::expected <chat_client, error_code> create(
-        const char* ip, const char* port, std::string_view ca_file_path = "certs/ca.crt.pem"
+        const char* ip, const char* port, std::string_view ca_file_path = "certs/ca.crt.pem",
+        command_codec::wire_format format = command_codec::wire_format::text
     );
     std::expected <void, error_code> run();
 };
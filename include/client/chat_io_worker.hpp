@@ -9,6 +9,7 @@
 #include <optional>
 #include <stop_token>
 #include <string>
+#include <string_view>
 #include <vector>
 
 class chat_io_worker{
@@ -25,16 +26,18 @@ class chat_io_worker{
     bool peer_verified = false;
     std::optional<std::int64_t> selected_room_id;
 
-    static parsed_command parse(const std::string& line);
+    static parsed_command parse(std::string_view line);
     short socket_events() const;
     std::expected<void, error_code> progress_tls_handshake();
     std::expected<void, error_code> flush_pending_send();
 
     std::expected<bool, error_code> recv_socket();
+    std::expected<void, error_code> execute_received();
+    void execute_decoded(const std::expected<command_codec::command_view, error_code>& dec_exp);
     std::expected<bool, error_code> send_stdin();
 
-    void execute(const std::string& line);
-    void say(const std::string& line);
+    void execute(std::string_view line);
+    void say(std::string_view line);
     void change_nickname(const std::string& nick);
     void login(const std::string& id, const std::string& pw);
     void signup(const std::string& id, const std::string& pw);
@@ -51,6 +54,8 @@ class chat_io_worker{
     void select_room(const std::string& room_id);
     void list_room();
     void history(const std::string& room_id, const std::string& limit);
+    void history_before(const std::string& room_id, const std::string& limit, const std::string& before_id);
+    void search(const std::string& room_id, const std::string& terms);
     void help();
 public:
     chat_io_worker(socket_info& si, unique_fd& server_fd, chat_executor& executor, std::atomic_bool& logged_in);
@@ -0,0 +1,44 @@
+#pragma once
+#include "core/error_code.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <string>
+#include <string_view>
+
+// Frames on the node bus: varint(body_len) | type (1 byte) | body. Integers
+// in the body are varints and strings are varint-length prefixed.
+namespace bus_frame{
+    constexpr std::size_t MAX_BODY = 1024 * 1024;
+
+    enum class frame_type : std::uint8_t{
+        message = 1,        // room_id, nickname, text
+        interest_add,       // room_id
+        interest_remove,    // room_id
+        presence_online,    // user_id
+        presence_offline,   // user_id
+        presence_digest,    // count, digest
+        presence_reset,     // (empty) the full user set follows
+        presence_resync     // (empty) asks the peer for presence_reset
+    };
+
+    struct frame{
+        frame_type type{};
+        std::int64_t room_id{};
+        std::string_view nickname;
+        std::string_view text;
+        std::string_view user_id;
+        std::uint64_t count{};
+        std::uint64_t digest{};
+    };
+
+    void append_message(std::string& out, std::int64_t room_id, std::string_view nickname, std::string_view text);
+    void append_interest(std::string& out, frame_type type, std::int64_t room_id);
+    void append_presence(std::string& out, frame_type type, std::string_view user_id);
+    void append_digest(std::string& out, std::uint64_t count, std::uint64_t digest);
+    void append_control(std::string& out, frame_type type);
+
+    // Returns the bytes consumed, 0 if data does not hold a whole frame yet.
+    // The views in out point into data.
+    std::expected<std::size_t, error_code> decode(std::string_view data, frame& out);
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class cluster_transport{
+    notify = 0,
+    bus
+};
+
+struct host_port{
+    std::string host;
+    std::string port;
+
+    // "host:port"; the port is split at the last ':'.
+    static std::optional<host_port> parse(std::string_view sv);
+    std::string to_string() const;
+    bool operator==(const host_port&) const = default;
+};
+
+struct cluster_options{
+    bool enabled = false;
+    cluster_transport transport = cluster_transport::notify;
+
+    // LISTEN/NOTIFY transport
+    std::string channel = "room_messages";
+    std::string node_id;
+    std::chrono::milliseconds batch_window{5};
+    std::size_t batch_max = 256;
+
+    // Node bus transport
+    host_port bus_listen;
+    std::vector<host_port> bus_peers;
+    std::chrono::milliseconds bus_flush_delay{1};
+    std::size_t bus_flush_bytes = 16 * 1024;
+    std::chrono::milliseconds bus_reconnect{1000};
+    std::chrono::milliseconds presence_digest_interval{5000};
+};
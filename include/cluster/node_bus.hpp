@@ -0,0 +1,126 @@
+#pragma once
+#include "cluster/bus_frame.hpp"
+#include "cluster/cluster_options.hpp"
+#include "cluster/presence_directory.hpp"
+#include "core/constant.hpp"
+#include "core/error_code.hpp"
+#include "core/unique_fd.hpp"
+#include "net/io_helper.hpp"
+#include "server/epoll_listener.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include <sys/epoll.h>
+
+class epoll_registry;
+
+// Peer-to-peer room fan-out between server processes. Each node dials every
+// peer in cluster.bus_peers and keeps that connection open. The dialing side
+// sends room messages over it; the accepting side answers with the rooms
+// that have members on its node, so a message only travels to nodes that
+// want it. Frames for one peer are coalesced until cluster.bus_flush_bytes
+// are queued or cluster.bus_flush_ms has passed.
+//
+// The dialing side also streams which users are connected to it, followed by
+// a periodic digest; a peer whose copy no longer matches asks for the whole
+// set again.
+class node_bus{
+    using clock = std::chrono::steady_clock;
+
+    // Bytes queued for one peer before further messages to it are dropped.
+    static constexpr std::size_t MAX_PENDING = 4 * 1024 * 1024;
+
+    struct link{
+        unique_fd fd;
+        bool outbound = false;
+        bool connecting = false;
+        bool want_write = false;
+        std::size_t peer = 0;
+        recv_buffer recv;
+        send_buffer send;
+        // Outbound only: rooms the peer last reported members for.
+        std::unordered_set<std::int64_t> interest;
+        // Inbound only: users the peer reported online, mirrored into remote_presence.
+        std::unordered_set<std::string> users;
+        presence_digest users_digest;
+        bool resync_pending = false;
+        clock::time_point flush_at = clock::time_point::max();
+    };
+
+    struct pending_message{
+        std::int64_t room_id;
+        std::string nickname;
+        std::string text;
+    };
+
+    epoll_listener listener;
+    epoll_registry& reg;
+    cluster_options opts;
+    std::vector<host_port> peers;
+    std::vector<int> peer_fds;
+    std::vector<clock::time_point> retry_at;
+    std::vector<bool> dial_warned;
+    std::unordered_map<int, link> links;
+    std::unordered_set<std::int64_t> local_rooms;
+    std::unordered_set<std::string> local_users;
+    presence_digest local_digest;
+    presence_directory remote_presence;
+    clock::time_point next_digest_at = clock::time_point::min();
+    std::array<epoll_event, EVENT_SIZE> events;
+    std::string frame_buf;
+    std::atomic<std::size_t> dropped{0};
+
+    std::mutex mtx;
+    std::vector<pending_message> msg_q;
+    std::vector<pending_message> msg_batch;
+    std::vector<std::pair<std::int64_t, bool>> interest_q;
+    std::vector<std::pair<std::int64_t, bool>> interest_batch;
+    std::vector<std::pair<std::string, bool>> presence_q;
+    std::vector<std::pair<std::string, bool>> presence_batch;
+
+    bool queue_idle() const;
+    void drain_requests();
+    void on_connected(link& l, clock::time_point now);
+    void send_presence_snapshot(link& l, clock::time_point now);
+    void send_digests(clock::time_point now);
+    void drop_link_users(link& l);
+    void dial(std::size_t peer, clock::time_point now);
+    void accept_links();
+    void handle_event(int fd, uint32_t event);
+    std::expected<void, error_code> read_link(link& l);
+    std::expected<void, error_code> handle_frame(link& l, const bus_frame::frame& f);
+    bool queue(link& l, std::string_view bytes, clock::time_point now);
+    std::expected<void, error_code> flush(link& l);
+    void set_want_write(link& l, bool want);
+    void close_link(int fd, const error_code& ec);
+    int next_timeout_ms(clock::time_point now) const;
+public:
+    static std::expected<epoll_listener, error_code> listen(const cluster_options& opts);
+
+    node_bus(epoll_listener listener, epoll_registry& reg, cluster_options opts);
+
+    node_bus(const node_bus&) = delete;
+    node_bus& operator=(const node_bus&) = delete;
+    node_bus(node_bus&&) = delete;
+    node_bus& operator=(node_bus&&) = delete;
+
+    // Called from the reactor thread.
+    void publish(std::int64_t room_id, std::string_view nickname, std::string_view text);
+    void set_room_interest(std::int64_t room_id, bool has_members);
+    void set_user_presence(std::string_view user_id, bool online);
+
+    // Safe from any thread.
+    bool remote_online(std::string_view user_id) const;
+
+    std::size_t dropped_count() const noexcept;
+    std::expected<void, error_code> run(const std::stop_token& st);
+};
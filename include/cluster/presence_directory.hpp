@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Order-independent summary of a user set, kept up to date on every change
+// so two nodes can compare their copies without exchanging the set.
+struct presence_digest{
+    std::uint64_t count = 0;
+    std::uint64_t hash = 0;
+
+    void add(std::string_view user_id) noexcept;
+    void remove(std::string_view user_id) noexcept;
+    bool operator==(const presence_digest&) const = default;
+};
+
+// Users connected to other nodes, written by the node bus thread and read by
+// the reactor when it builds friend lists. A user online on several nodes is
+// counted once per node.
+class presence_directory{
+    struct string_hash{
+        using is_transparent = void;
+        std::size_t operator()(std::string_view sv) const noexcept{ return std::hash<std::string_view>{}(sv); }
+    };
+
+    mutable std::mutex mtx;
+    std::unordered_map<std::string, std::uint32_t, string_hash, std::equal_to<>> nodes_by_user;
+public:
+    void add(std::string_view user_id);
+    void remove(std::string_view user_id);
+    bool online(std::string_view user_id) const;
+    std::size_t size() const;
+};
@@ -0,0 +1,68 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Size-classed chunk allocator for connection buffers. Each thread gets its
+// own pool on first use, so a reactor allocates and frees without locks.
+// Slabs are mmap'd and first touched by the owning thread, which keeps their
+// pages on that thread's NUMA node under the default local policy.
+//
+// A chunk freed on another thread goes back to its owner through a lock-free
+// list that the owner drains on its next allocation. Pools live as long as
+// the process, because a chunk can outlive the thread that allocated it.
+class buffer_pool{
+public:
+    static constexpr std::array<std::size_t, 3> CLASS_SIZES{4096, 16384, 65536};
+    static constexpr std::size_t SLAB_SIZE = 1024 * 1024;
+
+    struct block{
+        char* data = nullptr;
+        std::size_t capacity = 0;
+    };
+
+    struct stats{
+        std::size_t slab_bytes = 0;
+        std::array<std::size_t, CLASS_SIZES.size()> in_use{};
+        std::size_t large_in_use = 0;
+    };
+
+    buffer_pool(const buffer_pool&) = delete;
+    buffer_pool& operator=(const buffer_pool&) = delete;
+
+    static buffer_pool& local();
+
+    // capacity is at least min_size; larger than the biggest class falls
+    // back to the general heap.
+    block allocate(std::size_t min_size);
+    static void release(char* data) noexcept;
+
+    stats get_stats() const noexcept;
+private:
+    struct alignas(16) header{
+        header* next;
+        buffer_pool* owner;
+        std::uint32_t size_class;
+        std::uint32_t capacity;
+    };
+
+    struct size_class_state{
+        header* free = nullptr;
+        char* bump = nullptr;
+        char* bump_end = nullptr;
+        std::atomic<header*> remote{nullptr};
+        std::size_t in_use = 0;
+    };
+
+    static constexpr std::uint32_t LARGE_CLASS = CLASS_SIZES.size();
+
+    std::array<size_class_state, CLASS_SIZES.size()> classes;
+    std::vector<void*> slabs;
+    std::atomic<std::size_t> large_in_use{0};
+
+    buffer_pool() = default;
+    header* take(std::size_t cls);
+    void give_back(header* h) noexcept;
+};
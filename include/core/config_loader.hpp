@@ -1,5 +1,6 @@
 #pragma once
 #include "core/error_code.hpp"
+#include <cstddef>
 #include <expected>
 #include <string>
 #include <string_view>
@@ -14,7 +15,8 @@ namespace config_loader{
         empty_key,
         duplicate_key,
         read_failed,
-        missing_required_key
+        missing_required_key,
+        invalid_value
     };
 
     std::string config_strerror(int code);
@@ -24,6 +26,9 @@ namespace config_loader{
     std::expected <config_map, error_code> load_key_value_file(std::string_view path);
     std::expected <std::string, error_code> require(const config_map& cfg, std::string_view key);
     std::string get_or(const config_map& cfg, std::string_view key, std::string_view fallback);
+    std::expected <std::size_t, error_code> get_size_or(
+        const config_map& cfg, std::string_view key, std::size_t fallback
+    );
     
     std::expected <void, error_code> check_server_require(const config_map& cfg, const config_map& env);
 } 
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+
+// Identifies one connection, not just its fd: gen changes every time the fd
+// slot is reused, so a handle held by a worker thread goes stale instead of
+// reaching the next client on the same fd.
+struct conn_handle{
+    int fd = -1;
+    std::uint32_t gen = 0;
+
+    constexpr std::uint64_t pack() const noexcept{
+        return (static_cast<std::uint64_t>(gen) << 32) | static_cast<std::uint32_t>(fd);
+    }
+
+    static constexpr conn_handle unpack(std::uint64_t v) noexcept{
+        return conn_handle{static_cast<int>(static_cast<std::uint32_t>(v)), static_cast<std::uint32_t>(v >> 32)};
+    }
+
+    friend constexpr bool operator==(const conn_handle&, const conn_handle&) = default;
+};
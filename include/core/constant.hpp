@@ -1,2 +1,3 @@
 #pragma once
-constexpr int EVENT_SIZE = 128;
\ No newline at end of file
+constexpr int EVENT_SIZE = 128;
+constexpr int FRAME_BATCH = 16;
@@ -0,0 +1,74 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+// Vector of trivially copyable values that keeps the first N inline and
+// only touches the heap once it grows past them.
+template<class T, std::size_t N>
+class small_vector{
+    static_assert(std::is_trivially_copyable_v<T>);
+    static_assert(N > 0);
+
+    std::unique_ptr<T[]> heap;
+    std::uint32_t count = 0;
+    std::uint32_t cap = N;
+    T inline_buf[N]{};
+
+    void grow(){
+        const std::uint32_t new_cap = cap * 2;
+        auto next = std::make_unique<T[]>(new_cap);
+        std::copy_n(data(), count, next.get());
+        heap = std::move(next);
+        cap = new_cap;
+    }
+public:
+    small_vector() noexcept = default;
+
+    small_vector(const small_vector& other){ *this = other; }
+    small_vector& operator=(const small_vector& other){
+        if(this == &other) return *this;
+        clear();
+        for(const T& v : other) push_back(v);
+        return *this;
+    }
+
+    small_vector(small_vector&& other) noexcept{ *this = std::move(other); }
+    small_vector& operator=(small_vector&& other) noexcept{
+        if(this == &other) return *this;
+        heap = std::move(other.heap);
+        count = other.count;
+        cap = other.cap;
+        std::copy_n(other.inline_buf, N, inline_buf);
+        other.count = 0;
+        other.cap = N;
+        return *this;
+    }
+
+    void push_back(const T& v){
+        if(count == cap) grow();
+        data()[count++] = v;
+    }
+
+    // Drops the heap block as well, so an emptied vector is back to inline.
+    void clear() noexcept{
+        heap.reset();
+        count = 0;
+        cap = N;
+    }
+
+    bool contains(const T& v) const noexcept{ return std::find(begin(), end(), v) != end(); }
+
+    T* data() noexcept{ return heap ? heap.get() : inline_buf; }
+    const T* data() const noexcept{ return heap ? heap.get() : inline_buf; }
+    std::size_t size() const noexcept{ return count; }
+    bool empty() const noexcept{ return count == 0; }
+    std::size_t heap_bytes() const noexcept{ return heap ? cap * sizeof(T) : 0; }
+
+    T* begin() noexcept{ return data(); }
+    T* end() noexcept{ return data() + count; }
+    const T* begin() const noexcept{ return data(); }
+    const T* end() const noexcept{ return data() + count; }
+};
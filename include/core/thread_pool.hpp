@@ -17,7 +17,7 @@ class thread_pool{
     struct task{
         command_codec::command cmd;
         epoll_registry& reg;
-        int fd;
+        conn_handle conn;
     };
 
     std::queue <task> tasks;
@@ -31,7 +31,8 @@ public:
     thread_pool& operator=(const thread_pool&) = delete;
 
     static bool is_pool_command(const command_codec::command& cmd) noexcept;
+    static bool is_pool_command(const command_codec::command_view& cmd) noexcept;
     void stop();
-    bool enqueue(command_codec::command cmd, epoll_registry& reg, int fd);
+    bool enqueue(command_codec::command cmd, epoll_registry& reg, conn_handle conn);
     bool enqueue(command_codec::command cmd, epoll_registry& reg, socket_info& si);
 };
@@ -2,78 +2,138 @@
 #include "database/db_service.hpp"
 #include "protocol/command_codec.hpp"
 #include "reactor/epoll_registry.hpp"
+#include "search/message_index.hpp"
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
 #include <queue>
+#include <string>
 #include <thread>
 #include <vector>
 
+// Unread messages replayed after login. per_room = 0 turns catch-up off.
+struct catchup_limits{
+    std::int32_t per_room = 50;
+    std::int32_t max_messages = 500;
+};
+
+// Unread counters are written to chat.read_state once this many room
+// messages are pending or the interval has passed since the last write.
+struct unread_flush_limits{
+    std::size_t max_messages = 256;
+    std::chrono::milliseconds interval{1000};
+};
+
+// chat.messages is range-partitioned by id. Partitions of partition_rows ids
+// are kept ready partitions_ahead past the next id, and with retention_days
+// set, fully used partitions whose newest message is older are detached.
+// Checked at startup and then every interval.
+struct message_partition_options{
+    std::int64_t partition_rows = 10'000'000;
+    std::int32_t partitions_ahead = 2;
+    std::int32_t retention_days = 0;
+    std::chrono::milliseconds interval{3'600'000};
+};
+
 class db_executor{
+    using clock = std::chrono::steady_clock;
+
+    static constexpr std::int32_t HISTORY_PAGE_MAX = 1000;
+    // A history page is queued to the connection as one block, or in blocks
+    // of about this size when it is larger.
+    static constexpr std::size_t HISTORY_BLOCK_BYTES = 64 * 1024;
+
     std::vector<std::jthread> workers;
     std::mutex mtx;
     std::condition_variable cv;
     bool run = true;
     db_service& db;
+    catchup_limits catchup;
+    unread_flush_limits unread_flush;
+    std::atomic<clock::rep> unread_flushed_at{0};
+    message_partition_options partitions;
+    std::atomic<clock::rep> partitions_checked_at{0};
+    std::chrono::milliseconds search_sync;
+    std::atomic<clock::rep> search_synced_at{0};
+    // Rewriting the search log can take long, so it runs on a thread of its
+    // own instead of holding up the command workers.
+    std::atomic<bool> compacting{false};
+    std::jthread compactor;
 
     struct task{
         command_codec::command cmd;
         epoll_registry& reg;
-        int fd;
+        conn_handle conn;
         std::string user_id;
     };
 
     std::queue<task> tasks;
+    // Users whose read cursors should move to the newest message.
+    std::queue<std::string> read_marks;
     void worker_loop(std::stop_token st);
     void execute(const task& t);
+    void mark_read(const std::string& user_id);
+    void flush_unread_if_due();
+    void maintain_partitions_if_due();
+    void sync_search_if_due();
+    void start_search_compaction();
+    void send_unread(epoll_registry& reg, conn_handle conn, std::string_view user_id);
     std::expected<std::vector<std::int64_t>, error_code> load_joined_room_ids(std::string_view user_id);
-    void execute_command(const command_codec::cmd_login& cmd, epoll_registry& reg, int fd);
-    void execute_command(const command_codec::cmd_register& cmd, epoll_registry& reg, int fd);
+    void execute_command(const command_codec::cmd_login& cmd, epoll_registry& reg, conn_handle conn);
+    void execute_command(const command_codec::cmd_register& cmd, epoll_registry& reg, conn_handle conn);
     void execute_command(
-        const command_codec::cmd_nick& cmd, epoll_registry& reg, int fd, std::string_view user_id
+        const command_codec::cmd_nick& cmd, epoll_registry& reg, conn_handle conn, std::string_view user_id
     );
     void execute_command(
-        const command_codec::cmd_friend_request& cmd, epoll_registry& reg, int fd, std::string_view user_id
+        const command_codec::cmd_friend_request& cmd, epoll_registry& reg, conn_handle conn, std::string_view user_id
     );
     void execute_command(
-        const command_codec::cmd_friend_accept& cmd, epoll_registry& reg, int fd, std::string_view user_id
+        const command_codec::cmd_friend_accept& cmd, epoll_registry& reg, conn_handle conn, std::string_view user_id
     );
     void execute_command(
-        const command_codec::cmd_friend_reject& cmd, epoll_registry& reg, int fd, std::string_view user_id
+        const command_codec::cmd_friend_reject& cmd, epoll_registry& reg, conn_handle conn, std::string_view user_id
     );
     void execute_command(
-        const command_codec::cmd_friend_remove& cmd, epoll_registry& reg, int fd, std::string_view user_id
+        const command_codec::cmd_friend_remove& cmd, epoll_registry& reg, conn_handle conn, std::string_view user_id
     );
     void execute_command(
-        const command_codec::cmd_list_friend& cmd, epoll_registry& reg, int fd, std::string_view user_id
+        const command_codec::cmd_list_friend& cmd, epoll_registry& reg, conn_handle conn, std::string_view user_id
     );
     void execute_command(
-        const command_codec::cmd_list_friend_request& cmd, epoll_registry& reg, int fd, std::string_view user_id
+        const command_codec::cmd_list_friend_request& cmd, epoll_registry& reg, conn_handle conn, std::string_view user_id
     );
     void execute_command(
-        const command_codec::cmd_create_room& cmd, epoll_registry& reg, int fd, std::string_view user_id
+        const command_codec::cmd_create_room& cmd, epoll_registry& reg, conn_handle conn, std::string_view user_id
     );
     void execute_command(
-        const command_codec::cmd_delete_room& cmd, epoll_registry& reg, int fd, std::string_view user_id
+        const command_codec::cmd_delete_room& cmd, epoll_registry& reg, conn_handle conn, std::string_view user_id
     );
     void execute_command(
-        const command_codec::cmd_invite_room& cmd, epoll_registry& reg, int fd, std::string_view user_id
+        const command_codec::cmd_invite_room& cmd, epoll_registry& reg, conn_handle conn, std::string_view user_id
     );
     void execute_command(
-        const command_codec::cmd_leave_room& cmd, epoll_registry& reg, int fd, std::string_view user_id
+        const command_codec::cmd_leave_room& cmd, epoll_registry& reg, conn_handle conn, std::string_view user_id
     );
     void execute_command(
-        const command_codec::cmd_list_room& cmd, epoll_registry& reg, int fd, std::string_view user_id
+        const command_codec::cmd_list_room& cmd, epoll_registry& reg, conn_handle conn, std::string_view user_id
     );
     void execute_command(
-        const command_codec::cmd_history& cmd, epoll_registry& reg, int fd, std::string_view user_id
+        const command_codec::cmd_history& cmd, epoll_registry& reg, conn_handle conn, std::string_view user_id
     );
     void execute_command(
-        const command_codec::cmd_say& cmd, epoll_registry& reg, int fd, std::string_view user_id
+        const command_codec::cmd_history_before& cmd, epoll_registry& reg, conn_handle conn, std::string_view user_id
     );
-    void execute_command(const command_codec::cmd_response& cmd, epoll_registry& reg, int fd);
+    void execute_command(
+        const command_codec::cmd_say& cmd, epoll_registry& reg, conn_handle conn, std::string_view user_id
+    );
+    void execute_command(const command_codec::cmd_response& cmd, epoll_registry& reg, conn_handle conn);
 
 public:
-    explicit db_executor(db_service& db, std::size_t sz = 1);
+    explicit db_executor(
+        db_service& db, std::size_t sz = 1, catchup_limits catchup = {}, unread_flush_limits unread_flush = {},
+        message_partition_options partitions = {}, const search_options& search = {}
+    );
     ~db_executor();
 
     db_executor(const db_executor&) = delete;
@@ -82,7 +142,9 @@ public:
     db_executor& operator=(db_executor&&) = delete;
 
     static bool is_db_command(const command_codec::command& cmd) noexcept;
+    static bool is_db_command(const command_codec::command_view& cmd) noexcept;
     void stop();
-    bool enqueue(command_codec::command cmd, epoll_registry& reg, int fd);
+    bool enqueue(command_codec::command cmd, epoll_registry& reg, conn_handle conn);
     bool enqueue(command_codec::command cmd, epoll_registry& reg, socket_info& si);
+    bool enqueue_mark_read(std::string user_id);
 };
@@ -1,6 +1,8 @@
 #pragma once
 #include "core/error_code.hpp"
+#include "database/unread_counters.hpp"
 #include <expected>
+#include <functional>
 #include <mutex>
 #include <optional>
 #include <string>
@@ -9,11 +11,13 @@
 #include <vector>
 
 class db_connector;
+class message_index;
 
 class db_service{
 public:
     struct message_info{
         std::int64_t id{};
+        std::int64_t room_id{};
         std::string sender_user_id;
         std::string body;
         std::string created_at;
@@ -24,6 +28,13 @@ public:
         std::string name;
         std::string owner_user_id;
         std::int64_t member_count{};
+        std::int64_t unread_count{};
+    };
+    struct partition_report{
+        std::int32_t created{};
+        std::int32_t detached{};
+        // Lowest message id that is still in an attached partition.
+        std::int64_t first_message_id{};
     };
     enum class invite_room_result{
         invited = 0,
@@ -40,6 +51,10 @@ public:
 private:
     db_connector& connector;
     std::mutex mtx;
+    std::string notify_channel;
+    std::string node_id;
+    unread_counters unread;
+    message_index* search = nullptr;
 
 public:
     explicit db_service(db_connector& connector) noexcept;
@@ -49,6 +64,12 @@ public:
     db_service(db_service&&) = delete;
     db_service& operator=(db_service&&) = delete;
 
+    // With a channel set, create_room_message() publishes each committed
+    // message there so other nodes can relay it (see room_notify_listener).
+    void set_room_notify(std::string channel, std::string node_id);
+    // Stored room messages and deleted rooms are also applied to index.
+    void set_search_index(message_index* index);
+
     std::expected<void, error_code> ping() noexcept;
     std::expected<std::optional<std::string>, error_code> login(
         std::string_view id, std::string_view pw
@@ -101,9 +122,49 @@ public:
     std::expected<std::vector<room_info>, error_code> list_rooms(
         std::string_view user_id
     ) noexcept;
-    std::expected<std::optional<std::vector<message_info>>, error_code> list_room_messages(
+    // Streams one page of a room's history to on_message without buffering
+    // it; the second argument is the page's row count. before_id = 0 reads
+    // the newest limit messages, oldest first, and counts as reading the room.
+    // Otherwise messages with id < before_id come newest first. nullopt if the
+    // user is not a member; otherwise the number of messages streamed.
+    std::expected<std::optional<std::size_t>, error_code> stream_room_messages(
         std::string_view user_id,
         std::int64_t room_id,
-        std::int32_t limit
+        std::int32_t limit,
+        std::int64_t before_id,
+        const std::function<void(message_info&&, std::size_t)>& on_message
+    ) noexcept;
+    // Messages past the user's read cursor in every joined room: the newest
+    // per_room of each room, at most max_total overall, ordered by room then
+    // id. Cursors move past what is returned in the same statement.
+    std::expected<std::vector<message_info>, error_code> take_unread_messages(
+        std::string_view user_id,
+        std::int32_t per_room,
+        std::int32_t max_total
+    ) noexcept;
+    // Moves the user's read cursors to the newest message of each joined room.
+    std::expected<void, error_code> mark_rooms_read(
+        std::string_view user_id
     ) noexcept;
+
+    // Brings the search index up to date: drops rooms that no longer exist
+    // and indexes the messages past its sync mark that it does not hold yet,
+    // including those stored by other nodes. Returns the number indexed.
+    std::expected<std::size_t, error_code> sync_search_index() noexcept;
+    // Rewrites the search log without expired messages and deleted rooms
+    // when it holds any. Returns the bytes reclaimed.
+    std::expected<std::size_t, error_code> compact_search_index() noexcept;
+
+    // Creates chat.messages partitions so that `ahead` of them lie past the
+    // next message id and, with retention_days > 0, detaches the expired ones.
+    std::expected<partition_report, error_code> maintain_message_partitions(
+        std::int64_t partition_rows,
+        std::int32_t ahead,
+        std::int32_t retention_days
+    ) noexcept;
+
+    // Room messages counted in memory since the last flush_unread().
+    std::size_t pending_unread() noexcept;
+    // Writes the in-memory unread counts to chat.read_state in one transaction.
+    std::expected<void, error_code> flush_unread() noexcept;
 };
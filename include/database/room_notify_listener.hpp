@@ -0,0 +1,58 @@
+#pragma once
+#include "cluster/cluster_options.hpp"
+#include "core/error_code.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <expected>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+class db_connector;
+class epoll_registry;
+class message_index;
+
+// Payload published on the cluster channel after a room message commits:
+// "<node_id>:<room_id>:<message_id>".
+struct room_notify{
+    std::string_view node_id;
+    std::int64_t room_id{};
+    std::int64_t message_id{};
+
+    static std::string make_node_id();
+    static std::string encode(std::string_view node_id, std::int64_t room_id, std::int64_t message_id);
+    static std::optional<room_notify> decode(std::string_view payload);
+};
+
+// LISTENs on a dedicated connection and relays room messages committed by
+// other nodes to this node's room members, and adds them to the search
+// index when there is one. Notifications that arrive within batch_window are
+// fetched with one query; a message id is relayed once.
+class room_notify_listener{
+    static constexpr std::size_t SEEN_WINDOW = 4096;
+
+    db_connector& connector;
+    epoll_registry& reg;
+    cluster_options opts;
+    message_index* search;
+    std::vector<std::int64_t> batch;
+    std::unordered_set<std::int64_t> seen;
+    std::deque<std::int64_t> seen_order;
+
+    void on_notify(std::string_view payload);
+    bool remember(std::int64_t message_id);
+    void flush();
+public:
+    room_notify_listener(
+        db_connector& connector, epoll_registry& reg, cluster_options opts, message_index* search = nullptr
+    );
+
+    room_notify_listener(const room_notify_listener&) = delete;
+    room_notify_listener& operator=(const room_notify_listener&) = delete;
+
+    std::expected<void, error_code> run(const std::stop_token& st);
+};
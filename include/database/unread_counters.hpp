@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Unread counts that have not reached chat.read_state yet. Every stored room
+// message adds one for all members of its room; a member who posts or reads
+// in the same window instead owes only the messages after that point. The
+// caller serializes access and clears the counters once a flush commits.
+class unread_counters{
+    struct string_hash{
+        using is_transparent = void;
+        std::size_t operator()(std::string_view sv) const noexcept{ return std::hash<std::string_view>{}(sv); }
+    };
+
+    struct room_delta{
+        std::int64_t posted = 0;
+        // Value of posted when each user last posted or read in this room.
+        std::unordered_map<std::string, std::int64_t, string_hash, std::equal_to<>> caught_up_at;
+    };
+
+    std::unordered_map<std::int64_t, room_delta> rooms;
+    std::size_t pending = 0;
+public:
+    // Postgres array literals for one flush: rooms with their message counts,
+    // then (room, user, count) rows whose stored count is replaced.
+    struct flush_batch{
+        std::string room_ids;
+        std::string posted;
+        std::string reset_room_ids;
+        std::string reset_user_ids;
+        std::string reset_counts;
+    };
+
+    void note_message(std::int64_t room_id, std::string_view sender_user_id);
+    // left: messages of the room that are still unread after the read.
+    void note_read(std::int64_t room_id, std::string_view user_id, std::int64_t left = 0);
+    // For rooms the user is not a member of, the flush ignores the entry.
+    void note_read_all(std::string_view user_id);
+    // Count shown to user_id, given the value currently stored for the room.
+    std::int64_t effective(std::int64_t room_id, std::string_view user_id, std::int64_t stored) const;
+
+    std::size_t pending_messages() const noexcept;
+    bool empty() const noexcept;
+    flush_batch make_batch() const;
+    void clear() noexcept;
+};
@@ -3,24 +3,25 @@
 #include <sys/socket.h>
 #include <netdb.h>
 #include <cerrno>
+#include <array>
+#include <cstdint>
+#include <string>
 #include "core/unique_fd.hpp"
 #include "core/error_code.hpp"
 
 std::expected<unique_fd, error_code> make_client_fd(int listen_fd);
 std::expected<unique_fd, error_code> make_server_fd(addrinfo* head);
 
+// Peer address kept in binary form; it is only formatted when logged.
 struct endpoint{
-    sockaddr_storage ss{};
-    socklen_t len = 0;
-    char ip[NI_MAXHOST]{};
-    char port[NI_MAXSERV]{};
-    
-    const sockaddr* addr() const noexcept;
-    sockaddr* addr() noexcept;
-    std::expected <void, error_code> init_string();
-    std::string get_ip();
-    std::string get_port();
+    std::array<std::uint8_t, 16> addr{};
+    std::uint16_t port = 0;
+    sa_family_t family = AF_UNSPEC;
+
+    static endpoint from_sockaddr(const sockaddr* sa) noexcept;
+    std::string get_ip() const;
+    std::string get_port() const;
 };
 
 std::string to_string(const endpoint& ep);
-std::expected<endpoint, error_code> make_peer_endpoint(int fd);
\ No newline at end of file
+std::expected<endpoint, error_code> make_peer_endpoint(int fd);
@@ -1,24 +1,44 @@
 #pragma once
+#include "core/conn_handle.hpp"
 #include "core/error_code.hpp"
+#include "core/small_vector.hpp"
 #include "core/unique_fd.hpp"
 #include "net/fd_helper.hpp"
 #include "net/tls_session.hpp"
 #include "protocol/command_codec.hpp"
+#include "protocol/response_block.hpp"
+#include <chrono>
 #include <cstdint>
+#include <limits>
+#include <span>
 #include <string_view>
 #include <string>
-#include <unordered_set>
 
 constexpr int BUF_SIZE = 4096;
-
+// Storage is a buffer_pool chunk taken on first write and handed back by
+// release_if_done(), so a connection that never sends or receives costs only
+// the pointer.
 class offset_buffer{
 protected:
-    std::string buf;
-    std::size_t offset = 0;
+    char* buf = nullptr;
+    std::uint32_t used = 0;
+    std::uint32_t cap = 0;
+    std::uint32_t offset = 0;
+
+    void reserve_extra(std::size_t n);
 public:
+    offset_buffer() noexcept = default;
+    offset_buffer(const offset_buffer&) = delete;
+    offset_buffer& operator=(const offset_buffer&) = delete;
+    offset_buffer(offset_buffer&& other) noexcept;
+    offset_buffer& operator=(offset_buffer&& other) noexcept;
+    ~offset_buffer();
+
     bool clear_if_done();
+    bool release_if_done();
     bool compact_if_needed();
     void reset_offset();
+    void clear() noexcept;
 
     bool has_pending() const;
     const char* current_data() const;
@@ -27,15 +47,26 @@ public:
     std::size_t get_offset() const;
     void set_offset(std::size_t new_offset);
 
-    std::string& raw();
-    const std::string& raw() const;
+    // Writable space after the data, at least min_free bytes; commit() makes
+    // the first n of them part of the buffer.
+    std::span<char> prepare(std::size_t min_free);
+    void commit(std::size_t n) noexcept;
+
+    std::string_view view() const noexcept;
+    std::size_t heap_bytes() const noexcept;
 };
 
 class send_buffer : public offset_buffer{
+    command_codec::wire_format format = command_codec::wire_format::text;
 public:
     bool append(std::string_view sv);
     bool append(const char* p, std::size_t n);
     bool append(const command_codec::command& cmd);
+    bool append(const command_codec::command_view& cmd);
+    bool append(const response_block& block);
+
+    void set_format(command_codec::wire_format new_format);
+    command_codec::wire_format get_format() const;
 };
 
 class recv_buffer : public offset_buffer{
@@ -45,22 +76,44 @@ public:
 };
 
 struct socket_info{
+    using clock = std::chrono::steady_clock;
+
     recv_buffer recv;
     send_buffer send;
     tls_session tls;
-    bool is_closed = false;
-    uint32_t interest = 0;
     unique_fd ufd;
+    conn_handle handle{};
+    uint32_t interest = 0;
+    uint32_t inflight_db = 0;
+    uint32_t dropped_sends = 0;
+    bool is_closed = false;
+    bool format_negotiated = false;
+    bool recv_paused = false;
+    bool recv_capped = false;
+    bool send_throttled = false;
     endpoint ep;
-    std::string user_id;
+    clock::time_point throttled_since{};
+    clock::time_point connected_at{};
+    clock::time_point last_recv_at{};
+    clock::time_point last_send_at{};
+    clock::time_point ping_sent_at{};
+    clock::time_point timer_at = clock::time_point::max();
+    // Points at the key of the registry's user index, so every connection
+    // of one user shares a single copy of the id.
+    std::string_view user_id;
     std::string nickname = "guest";
-    std::unordered_set<std::int64_t> joined_room_ids;
+    small_vector<std::int64_t, 4> joined_room_ids;
+
+    std::size_t heap_bytes() const noexcept;
 };
 
 struct recv_info{
     std::size_t byte = 0;
     bool closed = 0;
+    bool capped = false;
 };
 
 std::expected <std::size_t, error_code> flush_send(socket_info& si);
-std::expected <recv_info, error_code> drain_recv(socket_info& si);
+std::expected <recv_info, error_code> drain_recv(
+    socket_info& si, std::size_t cap = std::numeric_limits<std::size_t>::max()
+);
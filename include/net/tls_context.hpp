@@ -29,6 +29,7 @@ public:
     );
     static std::expected <tls_context, error_code> create_client(std::string_view ca_file_path = {});
 
+    void set_release_buffers(bool enable) noexcept;
     SSL_CTX* get() const noexcept;
     bool is_server() const noexcept;
 };
@@ -1,73 +1,265 @@
 #pragma once
 #include "core/error_code.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <expected>
-#include <vector>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <variant>
 
 namespace command_codec{
-    struct cmd_say{
-        std::string room_id;
-        std::string text;
-    };
-    struct cmd_nick{ std::string nick; };
-    struct cmd_response{ std::string text; };
-    struct cmd_login{ std::string id, pw; };
-    struct cmd_register{ std::string id, pw; };
-    struct cmd_friend_request{ std::string to_user_id; };
-    struct cmd_friend_accept{ std::string from_user_id; };
-    struct cmd_friend_reject{ std::string from_user_id; };
-    struct cmd_friend_remove{ std::string friend_user_id; };
-    struct cmd_list_friend{};
-    struct cmd_list_friend_request{};
-    struct cmd_create_room{ std::string room_name; };
-    struct cmd_delete_room{ std::string room_id; };
-    struct cmd_invite_room{
-        std::string room_id;
-        std::string friend_user_id;
-    };
-    struct cmd_leave_room{ std::string room_id; };
-    struct cmd_list_room{};
-    struct cmd_history{
-        std::string room_id;
-        std::string limit;
+    enum class command_route : int{
+        local = 0,
+        db,
+        pool
     };
 
+    // Each command is templated on its string type: std::string for commands
+    // that are queued or cross threads, std::string_view for commands decoded
+    // in place from a recv buffer (see materialize()). The static members are
+    // its descriptor; basic_command below is the single list the decode and
+    // dispatch tables are generated from.
+    template<class S> struct basic_cmd_say{
+        static constexpr std::string_view name = "say";
+        static constexpr command_route route = command_route::db;
+        static constexpr std::size_t arity = 2;
+        S room_id;
+        S text;
+    };
+    template<class S> struct basic_cmd_nick{
+        static constexpr std::string_view name = "nick";
+        static constexpr command_route route = command_route::db;
+        static constexpr std::size_t arity = 1;
+        S nick;
+    };
+    template<class S> struct basic_cmd_response{
+        static constexpr std::string_view name = "response";
+        static constexpr command_route route = command_route::local;
+        static constexpr std::size_t arity = 1;
+        S text;
+    };
+    template<class S> struct basic_cmd_login{
+        static constexpr std::string_view name = "login";
+        static constexpr command_route route = command_route::db;
+        static constexpr std::size_t arity = 2;
+        S id, pw;
+    };
+    template<class S> struct basic_cmd_register{
+        static constexpr std::string_view name = "register";
+        static constexpr command_route route = command_route::db;
+        static constexpr std::size_t arity = 2;
+        S id, pw;
+    };
+    template<class S> struct basic_cmd_friend_request{
+        static constexpr std::string_view name = "friend_request";
+        static constexpr command_route route = command_route::db;
+        static constexpr std::size_t arity = 1;
+        S to_user_id;
+    };
+    template<class S> struct basic_cmd_friend_accept{
+        static constexpr std::string_view name = "friend_accept";
+        static constexpr command_route route = command_route::db;
+        static constexpr std::size_t arity = 1;
+        S from_user_id;
+    };
+    template<class S> struct basic_cmd_friend_reject{
+        static constexpr std::string_view name = "friend_reject";
+        static constexpr command_route route = command_route::db;
+        static constexpr std::size_t arity = 1;
+        S from_user_id;
+    };
+    template<class S> struct basic_cmd_friend_remove{
+        static constexpr std::string_view name = "friend_remove";
+        static constexpr command_route route = command_route::db;
+        static constexpr std::size_t arity = 1;
+        S friend_user_id;
+    };
+    template<class S> struct basic_cmd_list_friend{
+        static constexpr std::string_view name = "list_friend";
+        static constexpr command_route route = command_route::db;
+        static constexpr std::size_t arity = 0;
+    };
+    template<class S> struct basic_cmd_list_friend_request{
+        static constexpr std::string_view name = "list_friend_request";
+        static constexpr command_route route = command_route::db;
+        static constexpr std::size_t arity = 0;
+    };
+    template<class S> struct basic_cmd_create_room{
+        static constexpr std::string_view name = "create_room";
+        static constexpr command_route route = command_route::db;
+        static constexpr std::size_t arity = 1;
+        S room_name;
+    };
+    template<class S> struct basic_cmd_delete_room{
+        static constexpr std::string_view name = "delete_room";
+        static constexpr command_route route = command_route::db;
+        static constexpr std::size_t arity = 1;
+        S room_id;
+    };
+    template<class S> struct basic_cmd_invite_room{
+        static constexpr std::string_view name = "invite_room";
+        static constexpr command_route route = command_route::db;
+        static constexpr std::size_t arity = 2;
+        S room_id;
+        S friend_user_id;
+    };
+    template<class S> struct basic_cmd_leave_room{
+        static constexpr std::string_view name = "leave_room";
+        static constexpr command_route route = command_route::db;
+        static constexpr std::size_t arity = 1;
+        S room_id;
+    };
+    template<class S> struct basic_cmd_list_room{
+        static constexpr std::string_view name = "list_room";
+        static constexpr command_route route = command_route::db;
+        static constexpr std::size_t arity = 0;
+    };
+    template<class S> struct basic_cmd_history{
+        static constexpr std::string_view name = "history";
+        static constexpr command_route route = command_route::db;
+        static constexpr std::size_t arity = 2;
+        S room_id;
+        S limit;
+    };
+    // One page of older history: messages with id < before_id, newest first.
+    template<class S> struct basic_cmd_history_before{
+        static constexpr std::string_view name = "history_before";
+        static constexpr command_route route = command_route::db;
+        static constexpr std::size_t arity = 3;
+        S room_id;
+        S limit;
+        S before_id;
+    };
+    // Answered on the reactor thread from the local search index.
+    template<class S> struct basic_cmd_search{
+        static constexpr std::string_view name = "search";
+        static constexpr command_route route = command_route::local;
+        static constexpr std::size_t arity = 2;
+        S room_id;
+        S terms;
+    };
+    template<class S> struct basic_cmd_ping{
+        static constexpr std::string_view name = "ping";
+        static constexpr command_route route = command_route::local;
+        static constexpr std::size_t arity = 0;
+    };
+    template<class S> struct basic_cmd_pong{
+        static constexpr std::string_view name = "pong";
+        static constexpr command_route route = command_route::local;
+        static constexpr std::size_t arity = 0;
+    };
+
+    template<class S>
+    using basic_command = std::variant<
+        basic_cmd_say<S>,
+        basic_cmd_nick<S>,
+        basic_cmd_response<S>,
+        basic_cmd_login<S>,
+        basic_cmd_register<S>,
+        basic_cmd_friend_request<S>,
+        basic_cmd_friend_accept<S>,
+        basic_cmd_friend_reject<S>,
+        basic_cmd_friend_remove<S>,
+        basic_cmd_list_friend<S>,
+        basic_cmd_list_friend_request<S>,
+        basic_cmd_create_room<S>,
+        basic_cmd_delete_room<S>,
+        basic_cmd_invite_room<S>,
+        basic_cmd_leave_room<S>,
+        basic_cmd_list_room<S>,
+        basic_cmd_history<S>,
+        basic_cmd_ping<S>,
+        basic_cmd_pong<S>,
+        basic_cmd_history_before<S>,
+        basic_cmd_search<S>
+    >;
+
+    using cmd_say = basic_cmd_say<std::string>;
+    using cmd_nick = basic_cmd_nick<std::string>;
+    using cmd_response = basic_cmd_response<std::string>;
+    using cmd_login = basic_cmd_login<std::string>;
+    using cmd_register = basic_cmd_register<std::string>;
+    using cmd_friend_request = basic_cmd_friend_request<std::string>;
+    using cmd_friend_accept = basic_cmd_friend_accept<std::string>;
+    using cmd_friend_reject = basic_cmd_friend_reject<std::string>;
+    using cmd_friend_remove = basic_cmd_friend_remove<std::string>;
+    using cmd_list_friend = basic_cmd_list_friend<std::string>;
+    using cmd_list_friend_request = basic_cmd_list_friend_request<std::string>;
+    using cmd_create_room = basic_cmd_create_room<std::string>;
+    using cmd_delete_room = basic_cmd_delete_room<std::string>;
+    using cmd_invite_room = basic_cmd_invite_room<std::string>;
+    using cmd_leave_room = basic_cmd_leave_room<std::string>;
+    using cmd_list_room = basic_cmd_list_room<std::string>;
+    using cmd_history = basic_cmd_history<std::string>;
+    using cmd_ping = basic_cmd_ping<std::string>;
+    using cmd_pong = basic_cmd_pong<std::string>;
+    using cmd_history_before = basic_cmd_history_before<std::string>;
+    using cmd_search = basic_cmd_search<std::string>;
+
+    using command = basic_command<std::string>;
+    using command_view = basic_command<std::string_view>;
+
     enum class decode_error : int{
         empty_line = 1,
         invalid_command,
-        unexpected_argument
+        unexpected_argument,
+        invalid_frame,
+        frame_too_large
     };
 
+    // Binary frames: varint payload length, then a command id byte (the
+    // variant index) and a varint length before every field. A connection
+    // opts in by sending BINARY_MAGIC, BINARY_VERSION as its first bytes.
+    enum class wire_format : std::uint8_t{
+        text = 0,
+        binary
+    };
+
+    constexpr char BINARY_MAGIC = '\0';
+    constexpr char BINARY_VERSION = 1;
+    constexpr std::size_t MAX_FRAME_SIZE = 1u << 20;
+
+    constexpr std::size_t MAX_ARGS = 3;
+
     struct decode_info{
         std::string_view cmd;
-        std::vector<std::string_view> args;
-    };
-    using command = std::variant<
-        cmd_say,
-        cmd_nick,
-        cmd_response,
-        cmd_login,
-        cmd_register,
-        cmd_friend_request,
-        cmd_friend_accept,
-        cmd_friend_reject,
-        cmd_friend_remove,
-        cmd_list_friend,
-        cmd_list_friend_request,
-        cmd_create_room,
-        cmd_delete_room,
-        cmd_invite_room,
-        cmd_leave_room,
-        cmd_list_room,
-        cmd_history
-    >;
+        std::array<std::string_view, MAX_ARGS> args{};
+        std::size_t arg_count = 0;
+    };
+
+    struct descriptor{
+        std::string_view name;
+        std::size_t arity;
+        command_route route;
+        std::size_t index;
+        std::expected <command_view, error_code> (*decode)(const decode_info& info);
+    };
+
+    const descriptor* find_descriptor(std::string_view name) noexcept;
+    const descriptor& descriptor_of(const command& cmd) noexcept;
+    const descriptor& descriptor_of(const command_view& cmd) noexcept;
 
     decode_info decode_line(std::string_view line);
     std::string_view erase_delimeter(std::string_view line);
+    // Numeric arguments (room ids, message ids, limits): digits only, above zero.
+    std::optional<std::int64_t> parse_positive(std::string_view arg) noexcept;
 
     std::string encode(const command& cmd);
-    std::expected <command, error_code> decode(std::string_view line);
+    std::string encode(const command& cmd, wire_format format);
+    // Writes exactly encoded_size() bytes at out and returns the end.
+    std::size_t encoded_size(const command_view& cmd, wire_format format);
+    char* encode_to(char* out, const command_view& cmd, wire_format format);
+    std::string_view binary_preamble() noexcept;
+    std::expected <std::optional<wire_format>, error_code> detect_wire_format(std::string_view data);
+    std::expected <std::size_t, error_code> read_binary_frame(
+        std::string_view data, std::string_view& payload, std::size_t max_size = MAX_FRAME_SIZE
+    );
+    std::expected <command_view, error_code> decode_binary(std::string_view payload);
+    std::expected <command_view, error_code> decode(std::string_view line);
+    std::expected <command_view, error_code> decode(const decode_info& info);
+    command materialize(const command_view& cmd);
+    command_view view(const command& cmd);
     std::string decode_strerror(int code);
 }
@@ -0,0 +1,28 @@
+#pragma once
+#include "protocol/command_codec.hpp"
+#include <cstddef>
+#include <span>
+#include <string_view>
+
+namespace frame_scanner{
+    enum class scan_isa : int{
+        scalar = 0,
+        sse2,
+        avx2
+    };
+
+    struct frame{
+        std::string_view line;
+        command_codec::decode_info info;
+    };
+
+    scan_isa active_isa() noexcept;
+    bool isa_supported(scan_isa isa) noexcept;
+    std::string_view isa_name(scan_isa isa) noexcept;
+
+    // Splits up to out.size() complete '\n'-terminated frames from data in a
+    // single pass, recording '\r'-separated tokens in each frame's info.
+    // consumed is set to the byte count up to the end of the last frame.
+    std::size_t scan(std::string_view data, std::span<frame> out, std::size_t& consumed);
+    std::size_t scan(std::string_view data, std::span<frame> out, std::size_t& consumed, scan_isa isa);
+}
@@ -1,6 +1,10 @@
 #pragma once
+#include "core/error_code.hpp"
+#include "protocol/frame_scanner.hpp"
+#include <cstddef>
+#include <expected>
 #include <optional>
-#include <string>
+#include <span>
 #include <string_view>
 
 class offset_buffer;
@@ -9,5 +13,12 @@ namespace line_parser {
     bool has_line(std::string_view recv_buf);
     bool has_line(const offset_buffer& recv_buf);
 
-    std::optional<std::string> parse_line(offset_buffer& recv_buf);
+    // Returned views point into recv_buf and stay valid until the next
+    // parse_line(), parse_frames(), parse_binary_frame() or
+    // append() on the same buffer.
+    std::optional<std::string_view> parse_line(offset_buffer& recv_buf);
+    std::size_t parse_frames(offset_buffer& recv_buf, std::span<frame_scanner::frame> out);
+    std::expected <std::optional<std::string_view>, error_code> parse_binary_frame(
+        offset_buffer& recv_buf, std::size_t max_size = command_codec::MAX_FRAME_SIZE
+    );
 }
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Text of many response lines for one connection, kept in a single string
+// so a page of replies costs two allocations and is queued to the reactor
+// as one command. send_buffer encodes every line as a response.
+class response_block{
+    std::string text;
+    std::vector<std::uint32_t> ends;
+public:
+    // Appends one line made of parts.
+    void push(std::initializer_list<std::string_view> parts);
+
+    std::size_t size() const noexcept;
+    std::size_t text_bytes() const noexcept;
+    bool empty() const noexcept;
+    std::string_view line(std::size_t i) const noexcept;
+    void clear() noexcept;
+};
@@ -0,0 +1,57 @@
+#pragma once
+#include "core/conn_handle.hpp"
+#include "net/io_helper.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+// Connections indexed directly by fd. Slots live in fixed-size chunks that
+// are never moved, so a socket_info reference stays valid until erase().
+class connection_table{
+    static constexpr std::size_t CHUNK_BITS = 8;
+    static constexpr std::size_t CHUNK_SIZE = std::size_t{1} << CHUNK_BITS;
+
+    struct slot{
+        std::uint32_t gen = 0;
+        std::optional<socket_info> si;
+    };
+    using chunk = std::array<slot, CHUNK_SIZE>;
+
+    std::vector<std::unique_ptr<chunk>> chunks;
+    std::size_t count = 0;
+
+    slot* slot_at(int fd) noexcept;
+    const slot* slot_at(int fd) const noexcept;
+public:
+    socket_info& insert(int fd, socket_info si);
+    void erase(int fd) noexcept;
+
+    socket_info* find(int fd) noexcept;
+    socket_info* find(conn_handle handle) noexcept;
+    bool contains(int fd) const noexcept;
+    std::size_t size() const noexcept;
+    std::size_t capacity_bytes() const noexcept;
+
+    template<class F>
+    void for_each(F&& f){
+        for(auto& c : chunks){
+            if(c == nullptr) continue;
+            for(slot& s : *c){
+                if(s.si) f(*s.si);
+            }
+        }
+    }
+
+    template<class F>
+    void for_each(F&& f) const{
+        for(const auto& c : chunks){
+            if(c == nullptr) continue;
+            for(const slot& s : *c){
+                if(s.si) f(*s.si);
+            }
+        }
+    }
+};
@@ -3,49 +3,80 @@
 #include "reactor/epoll_wakeup.hpp"
 #include "net/io_helper.hpp"
 #include "core/unique_fd.hpp"
+#include "reactor/connection_table.hpp"
+#include "reactor/flow_limits.hpp"
+#include "reactor/room_members.hpp"
+#include "reactor/timer_wheel.hpp"
 #include <cstdint>
 #include <unordered_map>
 #include <unordered_set>
-#include <queue>
+#include <array>
+#include <memory_resource>
 #include <mutex>
 #include <variant>
 #include <cstddef>
+#include <functional>
+#include <string_view>
 #include <vector>
 
 class tls_context;
+class node_bus;
+
+// Bytes the registry holds for connections, excluding OpenSSL state.
+struct conn_memory_report{
+    std::size_t connections = 0;
+    std::size_t table_bytes = 0;
+    std::size_t buffer_bytes = 0;
+    std::size_t user_id_bytes = 0;
+    std::size_t index_bytes = 0;
+
+    std::size_t total() const noexcept;
+    std::size_t per_connection() const noexcept;
+};
 
 class epoll_registry : public epoll_wakeup{
+    struct string_hash{
+        using is_transparent = void;
+        std::size_t operator()(std::string_view sv) const noexcept{ return std::hash<std::string_view>{}(sv); }
+    };
+
     struct register_command{
         unique_fd fd;
         uint32_t interest;
     };
 
     struct unregister_command{
-        int fd;
+        conn_handle conn;
     };
 
     struct send_one_command{
-        int fd;
+        conn_handle conn;
         command_codec::command cmd;
     };
 
+    // Several replies for one connection, appended in a single pass.
+    struct send_block_command{
+        conn_handle conn;
+        response_block block;
+    };
+
     struct broadcast_command{
-        int fd;
+        conn_handle sender;
         command_codec::command cmd;
     };
 
     struct change_nickname_command{
-        int fd;
+        conn_handle conn;
         std::string nick;
     };
 
     struct set_user_id_command{
-        int fd;
+        conn_handle conn;
         std::string user_id;
     };
 
     struct set_joined_rooms_command{
-        int fd;
+        conn_handle conn;
         std::vector<std::int64_t> room_ids;
     };
 
@@ -55,45 +86,114 @@ class epoll_registry : public epoll_wakeup{
     };
 
     struct send_friend_list_command{
-        int fd;
+        conn_handle conn;
         std::vector<std::string> friend_ids;
     };
 
     struct room_broadcast_command{
-        int sender_fd;
+        conn_handle sender;
+        std::int64_t room_id;
+        command_codec::command cmd;
+    };
+
+    // A room message that arrived from another node, sent as "nickname: text".
+    struct room_relay_command{
         std::int64_t room_id;
+        std::string nickname;
         command_codec::command cmd;
     };
 
+    struct db_done_command{
+        conn_handle conn;
+    };
+
+    struct set_friends_command{
+        std::string user_id;
+        std::vector<std::string> friend_ids;
+    };
+
+    struct friend_link_command{
+        std::string user_a;
+        std::string user_b;
+        bool linked;
+    };
+
     using command = std::variant<
         register_command,
         unregister_command,
         send_one_command,
+        send_block_command,
         broadcast_command,
         change_nickname_command,
         set_user_id_command,
         set_joined_rooms_command,
         set_joined_rooms_for_user_command,
         send_friend_list_command,
-        room_broadcast_command
+        room_broadcast_command,
+        room_relay_command,
+        db_done_command,
+        set_friends_command,
+        friend_link_command
     >;
 
-    std::queue<command> cmd_q;
+    // Producers append to cmd_q; work() swaps it with cmd_batch, so both
+    // vectors keep their capacity and queueing does not allocate once warm.
+    std::vector<command> cmd_q;
+    std::vector<command> cmd_batch;
     std::mutex cmd_mtx;
-    std::unordered_map <int, socket_info> infos;
-    std::unordered_map<std::int64_t, std::unordered_set<int>> room_online_fds;
-    std::unordered_map<std::string, std::unordered_set<int>> user_online_fds;
+    // Scratch for payloads that only live while work() handles one batch.
+    std::array<std::byte, 16 * 1024> frame_arena_buf;
+    std::pmr::monotonic_buffer_resource frame_arena{frame_arena_buf.data(), frame_arena_buf.size()};
+    connection_table infos;
+    std::unordered_map<std::int64_t, room_members> room_online_fds;
+    std::unordered_map<std::string, std::unordered_set<int>, string_hash, std::equal_to<>> user_online_fds;
     std::size_t connected_client_count = 0;
     tls_context& tls_ctx;
+    send_limits send_lim;
+    recv_limits recv_lim;
+    conn_timeouts timeouts;
+    presence_options presence_opts;
+    timer_wheel timers;
+    std::size_t pending_send_total = 0;
+    std::size_t dropped_send_total = 0;
+    std::vector<int> ready_fds;
+    node_bus* bus = nullptr;
+    std::function<void(std::string_view)> user_offline_handler;
+    // Friends of each locally online user, loaded at login.
+    std::unordered_map<std::string, std::unordered_set<std::string>, string_hash, std::equal_to<>> friends_by_user;
+    // Users whose online state changed since the last presence flush, mapped
+    // to the state their friends last saw.
+    std::unordered_map<std::string, bool, string_hash, std::equal_to<>> presence_pending;
+    timer_wheel::clock::time_point presence_flush_at = timer_wheel::clock::time_point::max();
 
     std::expected <int, error_code> register_fd(unique_fd fd, uint32_t interest);
     std::expected <void, error_code> unregister_fd(int fd);
     std::expected <void, error_code> sync_interest(socket_info& si);
-    std::expected <void, error_code> append_send(socket_info& si, const command_codec::command& cmd);
+    bool drop_send(socket_info& si, bool droppable);
+    std::expected <void, error_code> append_send(
+        socket_info& si, const command_codec::command& cmd, bool droppable = false
+    );
+    std::expected <void, error_code> append_wire(socket_info& si, std::string_view wire, bool droppable);
+    std::expected <void, error_code> finish_append(socket_info& si, std::size_t before, bool became_pending);
+    std::string_view sender_nickname(conn_handle sender);
+    command_codec::command_view fanout_view(std::string_view nickname, const command_codec::command& cmd);
+    void fanout_room(std::int64_t room_id, const command_codec::command_view& cmd);
+    void note_room_interest(std::int64_t room_id, bool has_members);
+    bool user_online(std::string_view user_id) const;
+    void note_presence(std::string_view user_id, bool was_online);
+    void flush_presence();
+    void push_presence(std::string_view user_id, bool online);
+    void throttle_send(socket_info& si);
+    void arm_timer(socket_info& si);
+    timer_wheel::clock::time_point next_deadline(const socket_info& si) const;
+    const char* expired_timeout(const socket_info& si, timer_wheel::clock::time_point now) const;
+    bool heartbeat_due(const socket_info& si, timer_wheel::clock::time_point now) const;
+    void send_heartbeats(const std::vector<int>& fds);
 
     void handle_command(register_command&& cmd);
     void handle_command(const unregister_command& cmd);
     void handle_command(send_one_command&& cmd);
+    void handle_command(send_block_command&& cmd);
     void handle_command(broadcast_command&& cmd);
     void handle_command(change_nickname_command&& cmd);
     void handle_command(set_user_id_command&& cmd);
@@ -101,39 +201,74 @@ class epoll_registry : public epoll_wakeup{
     void handle_command(set_joined_rooms_for_user_command&& cmd);
     void handle_command(send_friend_list_command&& cmd);
     void handle_command(room_broadcast_command&& cmd);
+    void handle_command(room_relay_command&& cmd);
+    void handle_command(const db_done_command& cmd);
+    void handle_command(set_friends_command&& cmd);
+    void handle_command(friend_link_command&& cmd);
     void remove_fd_from_room_index(socket_info& si);
     void remove_fd_from_user_index(socket_info& si);
     void set_fd_joined_rooms(socket_info& si, std::vector<std::int64_t>&& room_ids);
 public:
-    using socket_info_it = std::unordered_map<int, socket_info>::iterator;
     epoll_registry(const epoll_registry&) = delete;
     epoll_registry& operator=(const epoll_registry&) = delete;
 
     epoll_registry(epoll_registry&& other) noexcept = delete;
     epoll_registry& operator=(epoll_registry&& other) noexcept = delete;
 
-    epoll_registry(epoll_wakeup wakeup, tls_context& tls_ctx);
+    epoll_registry(
+        epoll_wakeup wakeup, tls_context& tls_ctx,
+        send_limits send_lim = {}, recv_limits recv_lim = {}, conn_timeouts timeouts = {},
+        presence_options presence_opts = {}
+    );
 
     void request_register(unique_fd fd, uint32_t interest);
-    void request_unregister(int fd);
+    void request_unregister(conn_handle conn);
     void request_unregister(socket_info& si);
-    void request_send(int fd, command_codec::command cmd);
+    void request_send(conn_handle conn, command_codec::command cmd);
     void request_send(socket_info& si, command_codec::command cmd);
-    void request_broadcast(int send_fd, command_codec::command cmd);
+    void request_send_block(conn_handle conn, response_block block);
+    void request_broadcast(conn_handle sender, command_codec::command cmd);
     void request_broadcast(socket_info& si, command_codec::command cmd);
-    void request_change_nickname(int send_fd, std::string nick);
+    void request_change_nickname(conn_handle conn, std::string nick);
     void request_change_nickname(socket_info& si, std::string nick);
-    void request_set_user_id(int fd, std::string user_id);
+    void request_set_user_id(conn_handle conn, std::string user_id);
     void request_set_user_id(socket_info& si, std::string user_id);
-    void request_set_joined_rooms(int fd, std::vector<std::int64_t> room_ids);
+    void request_set_joined_rooms(conn_handle conn, std::vector<std::int64_t> room_ids);
     void request_set_joined_rooms(socket_info& si, std::vector<std::int64_t> room_ids);
     void request_set_joined_rooms_for_user(std::string user_id, std::vector<std::int64_t> room_ids);
-    void request_send_friend_list(int fd, std::vector<std::string> friend_ids);
-    void request_room_broadcast(int sender_fd, std::int64_t room_id, command_codec::command cmd);
+    void request_send_friend_list(conn_handle conn, std::vector<std::string> friend_ids);
+    void request_room_broadcast(conn_handle sender, std::int64_t room_id, command_codec::command cmd);
     void request_room_broadcast(socket_info& si, std::int64_t room_id, command_codec::command cmd);
+    void request_room_relay(std::int64_t room_id, std::string nickname, command_codec::command cmd);
+    void request_db_done(conn_handle conn);
+    void request_set_friends(std::string user_id, std::vector<std::string> friend_ids);
+    void request_friend_link(std::string user_a, std::string user_b, bool linked);
+    // Room messages are also published to the bus, and it is told when a
+    // room gains its first or loses its last local member, and when a user
+    // comes online or goes offline here. Friend lists also count users the
+    // bus reports online on other nodes.
+    void set_node_bus(node_bus* new_bus);
+    // Runs on the reactor thread when a user's last local connection goes away.
+    void set_user_offline_handler(std::function<void(std::string_view)> handler);
+
+    void note_flushed(socket_info& si, std::size_t byte);
+    void note_recv(socket_info& si);
+    void note_handshake_done(socket_info& si);
+    void reply(socket_info& si, const command_codec::command& cmd);
+    void reply(socket_info& si, const response_block& block);
+    int next_timeout_ms() const;
+    void expire_timers();
+    std::size_t pending_send_bytes() const noexcept;
+    std::size_t dropped_send_count() const noexcept;
+    conn_memory_report memory_report() const;
+    const recv_limits& get_recv_limits() const noexcept;
+    const presence_options& get_presence_options() const noexcept;
+    void update_recv_interest(socket_info& si);
+    bool has_ready_fds() const noexcept;
+    std::vector<int> take_ready_fds();
 
     void work();
 
-    socket_info_it find(int fd);
-    socket_info_it end();
+    socket_info* find(int fd);
+    socket_info* find(conn_handle conn);
 };
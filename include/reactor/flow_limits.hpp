@@ -0,0 +1,33 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+
+struct send_limits{
+    std::size_t high_watermark = 1024 * 1024;
+    std::size_t low_watermark = 256 * 1024;
+    std::chrono::milliseconds stall_timeout{10000};
+    std::size_t global_budget = 256 * 1024 * 1024;
+    bool release_drained = true;
+};
+
+struct recv_limits{
+    std::size_t buffer_cap = 256 * 1024;
+    std::size_t max_line = 64 * 1024;
+    std::size_t max_inflight_db = 32;
+    bool release_drained = true;
+};
+
+// A zero duration disables that timeout.
+struct conn_timeouts{
+    std::chrono::milliseconds handshake{10000};
+    std::chrono::milliseconds idle{90000};
+    std::chrono::milliseconds write_stall{30000};
+    std::chrono::milliseconds heartbeat{30000};
+};
+
+// Friend online/offline pushes. Changes within one coalesce window are merged,
+// so a user who reconnects inside it causes no event at all.
+struct presence_options{
+    bool push = true;
+    std::chrono::milliseconds coalesce{1000};
+};
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Online fds of one room, kept contiguous so a fan-out is a linear scan.
+// erase() during for_each() leaves a tombstone instead of moving entries;
+// the scan compacts them once it ends, so members can leave mid-broadcast.
+class room_members{
+    static constexpr int TOMBSTONE = -1;
+
+    std::vector<int> fds;
+    std::uint32_t tombstones = 0;
+    std::uint32_t scans = 0;
+
+    void compact() noexcept;
+public:
+    // The caller keeps fds unique; socket_info::joined_room_ids already does.
+    void insert(int fd);
+    void erase(int fd) noexcept;
+
+    std::size_t size() const noexcept;
+    bool empty() const noexcept;
+    bool scanning() const noexcept;
+    std::size_t heap_bytes() const noexcept;
+
+    // Members that join during the scan are not visited.
+    template<class F>
+    void for_each(F&& f){
+        ++scans;
+        const std::size_t n = fds.size();
+        for(std::size_t i = 0; i < n; ++i){
+            const int fd = fds[i];
+            if(fd != TOMBSTONE) f(fd);
+        }
+        if(--scans == 0 && tombstones > 0) compact();
+    }
+};
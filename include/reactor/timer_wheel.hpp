@@ -0,0 +1,48 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Hierarchical timing wheel keyed by fd. Entries are never cancelled: the
+// owner re-checks the real deadline when an entry fires and schedules again
+// if it moved, so arming costs one push_back.
+class timer_wheel{
+public:
+    using clock = std::chrono::steady_clock;
+
+    static constexpr std::size_t SLOT_BITS = 6;
+    static constexpr std::size_t SLOTS = std::size_t{1} << SLOT_BITS;
+    static constexpr std::size_t LEVELS = 4;
+
+private:
+    struct entry{
+        int fd;
+        std::uint64_t expire_tick;
+    };
+
+    struct level{
+        std::array<std::vector<entry>, SLOTS> slots;
+        std::uint64_t occupied = 0;
+    };
+
+    std::array<level, LEVELS> levels;
+    clock::duration tick;
+    clock::time_point origin;
+    std::uint64_t current_tick = 0;
+    std::size_t entry_count = 0;
+
+    std::uint64_t tick_of(clock::time_point when) const noexcept;
+    void insert(entry e);
+    void cascade(std::size_t lv);
+public:
+    explicit timer_wheel(
+        clock::duration tick = std::chrono::milliseconds(100), clock::time_point now = clock::now()
+    );
+
+    void schedule(int fd, clock::time_point when);
+    void advance(clock::time_point now, std::vector<int>& expired);
+    int timeout_ms(clock::time_point now) const noexcept;
+    std::size_t size() const noexcept;
+};
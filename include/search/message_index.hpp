@@ -0,0 +1,118 @@
+#pragma once
+#include "core/error_code.hpp"
+#include "core/unique_fd.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <functional>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// An empty index_path turns /search off. Every sync_interval the index
+// catches up on messages it missed, such as those stored by other nodes.
+struct search_options{
+    std::string index_path = "data/search.idx";
+    std::size_t max_results = 20;
+    std::chrono::milliseconds sync_interval{60'000};
+};
+
+// Inverted index of room messages behind /search. Message text lives in an
+// append-only log mapped from the index file; each room maps a term to the
+// log offsets of the messages containing it, stored as varint deltas.
+// open() replays the log. Every message up to the sync mark is indexed, and
+// the ids indexed past it are remembered so a message added both live and by
+// a later catch-up is logged once. Queries share the lock; updates take it
+// exclusively.
+class message_index{
+public:
+    struct match{
+        std::int64_t id{};
+        std::string sender_user_id;
+        std::string body;
+    };
+
+private:
+    struct string_hash{
+        using is_transparent = void;
+        std::size_t operator()(std::string_view sv) const noexcept{ return std::hash<std::string_view>{}(sv); }
+    };
+
+    struct posting_list{
+        std::string deltas;
+        std::uint64_t last = 0;
+        std::uint32_t count = 0;
+    };
+    using term_map = std::unordered_map<std::string, posting_list, string_hash, std::equal_to<>>;
+
+    mutable std::shared_mutex mtx;
+    std::string log_path;
+    unique_fd fd;
+    char* base = nullptr;
+    std::size_t mapped = 0;
+    std::size_t used = 0;
+    std::int64_t synced_id = 0;
+    std::int64_t first_id = 0;
+    std::int64_t lowest_id = 0;
+    bool dropped = false;
+    std::unordered_map<std::int64_t, term_map> rooms;
+    std::unordered_set<std::int64_t> recent_ids;
+
+    std::expected<void, error_code> reserve(std::size_t extra);
+    std::expected<void, error_code> append_drop(std::int64_t room_id);
+    void index_message(std::int64_t room_id, std::uint64_t offset, std::string_view body);
+    void mark_synced(std::int64_t id);
+    void take_log(message_index& other) noexcept;
+    void replay();
+    void unmap() noexcept;
+
+public:
+    message_index() = default;
+    ~message_index();
+
+    message_index(const message_index&) = delete;
+    message_index& operator=(const message_index&) = delete;
+    message_index(message_index&&) = delete;
+    message_index& operator=(message_index&&) = delete;
+
+    // Lowercased runs of ASCII letters and digits; bytes >= 0x80 count as
+    // letters so UTF-8 words stay whole. Overlong runs are skipped.
+    static void tokenize(std::string_view text, const std::function<void(std::string_view)>& on_term);
+
+    // Creates the file if it is missing and indexes what it already holds.
+    std::expected<void, error_code> open(const std::string& path);
+    bool is_open() const noexcept;
+
+    // False when the message is already indexed.
+    std::expected<bool, error_code> add(
+        std::int64_t room_id, std::int64_t message_id, std::string_view sender_user_id, std::string_view body
+    );
+    std::expected<void, error_code> drop_room(std::int64_t room_id);
+    // Drops every indexed room that is not in room_ids.
+    std::expected<std::size_t, error_code> retain_rooms(std::span<const std::int64_t> room_ids);
+
+    // Messages below id are no longer in the database (detached partitions)
+    // and are left out of results.
+    void set_first_message_id(std::int64_t id);
+    // Records that every message up to id is indexed; a catch-up starts past it.
+    std::expected<void, error_code> set_synced_message_id(std::int64_t id);
+    std::int64_t synced_message_id() const;
+
+    // True when the log holds messages below the first message id or rooms
+    // that were dropped.
+    bool reclaimable() const;
+    // Rewrites the log with only the live messages and swaps it in. Searches
+    // continue while it is copied; adds wait only for the final swap. Returns
+    // the bytes reclaimed. One caller at a time.
+    std::expected<std::size_t, error_code> compact();
+    std::size_t room_count() const;
+    std::size_t log_bytes() const;
+
+    // Newest first: up to limit messages of the room that contain every term.
+    std::vector<match> search(std::int64_t room_id, std::string_view terms, std::size_t limit) const;
+};
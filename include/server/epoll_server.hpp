@@ -1,4 +1,5 @@
 #pragma once
+#include "cluster/node_bus.hpp"
 #include "core/error_code.hpp"
 #include "net/io_helper.hpp"
 #include "reactor/epoll_registry.hpp"
@@ -9,9 +10,13 @@
 #include "core/thread_pool.hpp"
 #include "database/db_executor.hpp"
 #include "net/tls_context.hpp"
+#include "server/server_options.hpp"
+#include <optional>
 #include <stop_token>
 
+class db_connector;
 class db_service;
+class message_index;
 
 class epoll_server{
     tls_context tls_ctx;
@@ -20,6 +25,11 @@ class epoll_server{
     thread_pool pool{};
     db_executor db_pool;
     std::string port;
+    cluster_options cluster;
+    db_connector* notify_db;
+    std::optional<node_bus> bus;
+    message_index* search;
+    std::size_t search_max_results;
 
     std::expected <void, error_code> sync_tls_interest(socket_info& si);
     std::expected <void, error_code> progress_tls_handshake(socket_info& si);
@@ -28,8 +38,15 @@ class epoll_server{
     void handle_send(socket_info& si);
     bool handle_recv(socket_info& si, uint32_t event);
     void handle_close(socket_info& si);
-    void handle_client_error(int fd, uint32_t event);
+    void handle_client_error(conn_handle conn, uint32_t event);
+    bool negotiate_format(socket_info& si);
     bool handle_execute(socket_info& si);
+    bool execute_batch(socket_info& si);
+    bool execute_binary(socket_info& si, std::size_t batch);
+    void reject_oversized(socket_info& si, std::size_t byte);
+    void reject_unqueued(socket_info& si);
+    bool execute_frame(socket_info& si, const std::expected<command_codec::command_view, error_code>& dec_exp);
+    void execute_search(socket_info& si, std::string_view room_id, std::string_view terms);
 public:
     epoll_server(const epoll_server&) = delete;
     epoll_server& operator=(const epoll_server&) = delete;
@@ -37,11 +54,17 @@ public:
     epoll_server(epoll_server&& other) noexcept = delete;
     epoll_server& operator=(epoll_server&& other) noexcept = delete;
 
+    // notify_db is the dedicated LISTEN connection; it is only used when opts.cluster.enabled
+    // with the notify transport. The bus transport opens its own listener in create().
+    // Without search_index, /search replies that search is disabled.
     static std::expected <epoll_server, error_code> create(
-        const char* port, db_service& db, tls_context tls_ctx
+        const char* port, db_service& db, tls_context tls_ctx, const server_options& opts = {},
+        db_connector* notify_db = nullptr, message_index* search_index = nullptr
     );
     epoll_server(
-        epoll_wakeup wakeup, epoll_listener listener, tls_context tls_ctx, db_service& db, const char* port
+        epoll_wakeup wakeup, epoll_listener listener, tls_context tls_ctx, db_service& db, const char* port,
+        const server_options& opts = {}, db_connector* notify_db = nullptr,
+        std::optional<epoll_listener> bus_listener = std::nullopt, message_index* search_index = nullptr
     );
     std::expected <void, error_code> run();
     std::expected <void, error_code> run(const std::stop_token& stop_token);
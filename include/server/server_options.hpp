@@ -0,0 +1,22 @@
+#pragma once
+#include "core/config_loader.hpp"
+#include "core/error_code.hpp"
+#include "database/db_executor.hpp"
+#include "database/room_notify_listener.hpp"
+#include "reactor/flow_limits.hpp"
+#include "search/message_index.hpp"
+#include <expected>
+
+struct server_options{
+    send_limits send;
+    recv_limits recv;
+    conn_timeouts timeouts;
+    presence_options presence;
+    catchup_limits catchup;
+    unread_flush_limits unread;
+    message_partition_options partitions;
+    search_options search;
+    cluster_options cluster;
+
+    static std::expected <server_options, error_code> from_config(const config_loader::config_map& cfg);
+};
@@ -63,7 +63,12 @@ if [[ -z "${MIGRATE_DB_PASSWORD}" ]]; then
     MIGRATE_DB_PASSWORD="${APP_DB_PASSWORD}"
 fi
 
+PARTITION_ROWS="$(cfg_get_from_file "messages.partition_rows" "10000000" "${SERVER_CONFIG}")"
+PARTITIONS_AHEAD="$(cfg_get_from_file "messages.partitions_ahead" "2" "${SERVER_CONFIG}")"
+
 [[ -n "${DB_NAME}" ]] || fail "db.name is missing in ${SERVER_CONFIG}"
+[[ "${PARTITION_ROWS}" =~ ^[1-9][0-9]*$ ]] || fail "messages.partition_rows must be a positive integer"
+[[ "${PARTITIONS_AHEAD}" =~ ^[1-9][0-9]*$ ]] || fail "messages.partitions_ahead must be a positive integer"
 [[ -n "${DB_SSLMODE}" ]] || DB_SSLMODE="disable"
 [[ -n "${APP_DB_USER}" ]] || fail "db.user is missing in ${ENV_FILE}"
 [[ -n "${APP_DB_PASSWORD}" ]] || fail "db.password is missing in ${ENV_FILE}"
@@ -278,19 +283,154 @@ CREATE TABLE IF NOT EXISTS chat.room_members (
     CONSTRAINT room_members_role_check CHECK (role IN ('owner', 'admin', 'member'))
 );
 
+-- chat.messages is range-partitioned by id: every read filters on room and id,
+-- so bounds on id prune partitions. An existing unpartitioned table becomes the
+-- first partition, chat.messages_legacy, covering the ids it already holds.
+DO $$
+BEGIN
+    IF to_regclass('chat.messages') IS NOT NULL
+       AND (SELECT relkind FROM pg_class WHERE oid = 'chat.messages'::regclass) = 'r' THEN
+        LOCK TABLE chat.messages IN ACCESS EXCLUSIVE MODE;
+        ALTER TABLE chat.messages ALTER COLUMN id DROP IDENTITY IF EXISTS;
+        ALTER TABLE chat.messages RENAME TO messages_legacy;
+        ALTER TABLE chat.messages_legacy RENAME CONSTRAINT messages_pkey TO messages_legacy_pkey;
+        ALTER INDEX IF EXISTS chat.idx_messages_room_created_at RENAME TO idx_messages_legacy_room_created_at;
+        ALTER INDEX IF EXISTS chat.idx_messages_sender_created_at RENAME TO idx_messages_legacy_sender_created_at;
+        ALTER INDEX IF EXISTS chat.idx_messages_room_id_id RENAME TO idx_messages_legacy_room_id_id;
+    END IF;
+END $$;
+
+CREATE SEQUENCE IF NOT EXISTS chat.message_ids AS BIGINT;
+
 CREATE TABLE IF NOT EXISTS chat.messages (
-    id             BIGINT GENERATED ALWAYS AS IDENTITY PRIMARY KEY,
+    id             BIGINT NOT NULL DEFAULT nextval('chat.message_ids'),
     room_id        BIGINT NOT NULL REFERENCES chat.rooms(id) ON DELETE CASCADE,
     sender_user_id TEXT NOT NULL REFERENCES auth.users(id) ON DELETE CASCADE,
     body           TEXT NOT NULL,
-    created_at     TIMESTAMPTZ NOT NULL DEFAULT now()
+    created_at     TIMESTAMPTZ NOT NULL DEFAULT now(),
+    CONSTRAINT messages_pkey PRIMARY KEY (id)
+) PARTITION BY RANGE (id);
+
+ALTER SEQUENCE chat.message_ids OWNED BY chat.messages.id;
+
+-- One row per partition ever created; detached partitions keep their row.
+CREATE TABLE IF NOT EXISTS chat.message_partitions (
+    table_name  TEXT PRIMARY KEY,
+    from_id     BIGINT NOT NULL,
+    to_id       BIGINT NOT NULL,
+    created_at  TIMESTAMPTZ NOT NULL DEFAULT now(),
+    detached_at TIMESTAMPTZ
+);
+
+DO $$
+DECLARE
+    legacy_end BIGINT;
+BEGIN
+    IF to_regclass('chat.messages_legacy') IS NOT NULL
+       AND NOT (SELECT relispartition FROM pg_class WHERE oid = 'chat.messages_legacy'::regclass)
+       AND NOT EXISTS (SELECT 1 FROM chat.message_partitions WHERE table_name = 'messages_legacy') THEN
+        SELECT COALESCE(MAX(id), 0) + 1 INTO legacy_end FROM chat.messages_legacy;
+        PERFORM setval('chat.message_ids', legacy_end, false);
+        EXECUTE format(
+            'ALTER TABLE chat.messages ATTACH PARTITION chat.messages_legacy FOR VALUES FROM (MINVALUE) TO (%s)',
+            legacy_end
+        );
+        INSERT INTO chat.message_partitions (table_name, from_id, to_id)
+        VALUES ('messages_legacy', 1, legacy_end)
+        ON CONFLICT (table_name) DO NOTHING;
+    END IF;
+END $$;
+
+-- Keeps partitions of partition_rows ids ready for at least `ahead` partitions
+-- past the next id. Runs as the schema owner so the server role can call it.
+CREATE OR REPLACE FUNCTION chat.ensure_message_partitions(partition_rows BIGINT, ahead INT)
+RETURNS INT
+LANGUAGE plpgsql
+SECURITY DEFINER
+SET search_path = pg_catalog, chat, pg_temp
+AS $$
+DECLARE
+    next_id BIGINT;
+    top BIGINT;
+    part TEXT;
+    created INT := 0;
+BEGIN
+    IF partition_rows <= 0 OR ahead <= 0 THEN
+        RAISE EXCEPTION 'invalid partition settings: rows=% ahead=%', partition_rows, ahead;
+    END IF;
+    PERFORM pg_advisory_xact_lock(hashtext('chat.message_partitions'));
+
+    SELECT CASE WHEN is_called THEN last_value + 1 ELSE last_value END INTO next_id FROM chat.message_ids;
+    SELECT COALESCE(MAX(to_id), 1) INTO top FROM chat.message_partitions;
+    WHILE top < next_id + partition_rows * ahead LOOP
+        part := 'messages_p' || top;
+        EXECUTE format(
+            'CREATE TABLE chat.%I PARTITION OF chat.messages FOR VALUES FROM (%s) TO (%s)',
+            part, top, top + partition_rows
+        );
+        INSERT INTO chat.message_partitions (table_name, from_id, to_id) VALUES (part, top, top + partition_rows);
+        top := top + partition_rows;
+        created := created + 1;
+    END LOOP;
+    RETURN created;
+END $$;
+
+-- Detaches, oldest first, every fully used partition whose newest message is
+-- older than retention_days. Detached tables stay in the chat schema until
+-- they are archived and dropped by hand.
+CREATE OR REPLACE FUNCTION chat.detach_expired_message_partitions(retention_days INT)
+RETURNS INT
+LANGUAGE plpgsql
+SECURITY DEFINER
+SET search_path = pg_catalog, chat, pg_temp
+AS $$
+DECLARE
+    next_id BIGINT;
+    part RECORD;
+    newest TIMESTAMPTZ;
+    detached INT := 0;
+BEGIN
+    IF retention_days <= 0 THEN
+        RETURN 0;
+    END IF;
+    PERFORM pg_advisory_xact_lock(hashtext('chat.message_partitions'));
+
+    SELECT CASE WHEN is_called THEN last_value + 1 ELSE last_value END INTO next_id FROM chat.message_ids;
+    FOR part IN
+        SELECT table_name FROM chat.message_partitions
+        WHERE detached_at IS NULL AND to_id <= next_id
+        ORDER BY from_id
+    LOOP
+        EXECUTE format('SELECT created_at FROM chat.%I ORDER BY id DESC LIMIT 1', part.table_name) INTO newest;
+        EXIT WHEN newest IS NOT NULL AND newest >= now() - make_interval(days => retention_days);
+
+        EXECUTE format('ALTER TABLE chat.messages DETACH PARTITION chat.%I', part.table_name);
+        UPDATE chat.message_partitions SET detached_at = now() WHERE table_name = part.table_name;
+        detached := detached + 1;
+    END LOOP;
+    RETURN detached;
+END $$;
+
+ALTER TABLE chat.room_members ADD COLUMN IF NOT EXISTS last_read_message_id BIGINT NOT NULL DEFAULT 0;
+
+CREATE TABLE IF NOT EXISTS chat.read_state (
+    room_id      BIGINT NOT NULL,
+    user_id      TEXT NOT NULL,
+    unread_count BIGINT NOT NULL DEFAULT 0,
+    CONSTRAINT read_state_pk PRIMARY KEY (room_id, user_id),
+    CONSTRAINT read_state_member_fk FOREIGN KEY (room_id, user_id)
+        REFERENCES chat.room_members (room_id, user_id) ON DELETE CASCADE
 );
 
 CREATE INDEX IF NOT EXISTS idx_room_members_user_id ON chat.room_members (user_id);
 CREATE INDEX IF NOT EXISTS idx_messages_room_created_at ON chat.messages (room_id, created_at);
 CREATE INDEX IF NOT EXISTS idx_messages_sender_created_at ON chat.messages (sender_user_id, created_at);
+CREATE INDEX IF NOT EXISTS idx_messages_room_id_id ON chat.messages (room_id, id);
 SQL
 
+info "creating message partitions: ${PARTITION_ROWS} ids each, ${PARTITIONS_AHEAD} ahead"
+psql_exec "${DB_NAME}" -tA -c "SELECT chat.ensure_message_partitions(${PARTITION_ROWS}, ${PARTITIONS_AHEAD});" >/dev/null
+
 info "schema migration finished"
 info "verifying required tables"
 
@@ -300,6 +440,9 @@ friend_requests_exists="$(psql_exec "${DB_NAME}" -tA -c "SELECT to_regclass('soc
 chat_rooms_exists="$(psql_exec "${DB_NAME}" -tA -c "SELECT to_regclass('chat.rooms') IS NOT NULL;")"
 chat_room_members_exists="$(psql_exec "${DB_NAME}" -tA -c "SELECT to_regclass('chat.room_members') IS NOT NULL;")"
 chat_messages_exists="$(psql_exec "${DB_NAME}" -tA -c "SELECT to_regclass('chat.messages') IS NOT NULL;")"
+chat_read_state_exists="$(psql_exec "${DB_NAME}" -tA -c "SELECT to_regclass('chat.read_state') IS NOT NULL;")"
+chat_messages_partitioned="$(psql_exec "${DB_NAME}" -tA -c "SELECT relkind = 'p' FROM pg_class WHERE oid = 'chat.messages'::regclass;")"
+chat_message_partitions_exists="$(psql_exec "${DB_NAME}" -tA -c "SELECT to_regclass('chat.message_partitions') IS NOT NULL;")"
 
 [[ "${users_exists}" == "t" ]] || fail "auth.users missing after migration"
 [[ "${friendships_exists}" == "t" ]] || fail "social.friendships missing after migration"
@@ -307,6 +450,9 @@ chat_messages_exists="$(psql_exec "${DB_NAME}" -tA -c "SELECT to_regclass('chat.
 [[ "${chat_rooms_exists}" == "t" ]] || fail "chat.rooms missing after migration"
 [[ "${chat_room_members_exists}" == "t" ]] || fail "chat.room_members missing after migration"
 [[ "${chat_messages_exists}" == "t" ]] || fail "chat.messages missing after migration"
+[[ "${chat_read_state_exists}" == "t" ]] || fail "chat.read_state missing after migration"
+[[ "${chat_messages_partitioned}" == "t" ]] || fail "chat.messages is not partitioned after migration"
+[[ "${chat_message_partitions_exists}" == "t" ]] || fail "chat.message_partitions missing after migration"
 
 echo "[PASS] db schema migration applied successfully"
 echo "[INFO] config: ${SERVER_CONFIG}"
@@ -0,0 +1,63 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+source "${ROOT_DIR}/scripts/lib/common.sh"
+
+BUILD_DIR_RAW="${BUILD_DIR:-build-bench}"
+BUILD_TYPE="${BUILD_TYPE:-Release}"
+BUILD_JOBS="${BUILD_JOBS:-}"
+BENCH_OUT_DIR_RAW="${BENCH_OUT_DIR:-bench_log}"
+BENCH_FILTER="${BENCH_FILTER:-}"
+BENCH_REPETITIONS="${BENCH_REPETITIONS:-1}"
+
+BUILD_DIR="$(resolve_path_from_root "${BUILD_DIR_RAW}")"
+BENCH_OUT_DIR="$(resolve_path_from_root "${BENCH_OUT_DIR_RAW}")"
+
+fail() {
+    echo "[FAIL] $1"
+    exit 1
+}
+
+info() {
+    echo "[INFO] $1"
+}
+
+command -v cmake >/dev/null 2>&1 || fail "cmake command not found"
+
+if [[ -z "${BUILD_JOBS}" ]]; then
+    if command -v nproc >/dev/null 2>&1; then
+        BUILD_JOBS="$(nproc)"
+    else
+        BUILD_JOBS="4"
+    fi
+fi
+
+mkdir -p "${BUILD_DIR}" "${BENCH_OUT_DIR}"
+
+info "configuring benchmarks (build_dir=${BUILD_DIR_RAW}, build_type=${BUILD_TYPE})"
+cmake -S "${ROOT_DIR}" -B "${BUILD_DIR}" \
+    "-DCMAKE_BUILD_TYPE=${BUILD_TYPE}" \
+    -DSOCKET_PRAC_BUILD_BENCHMARKS=ON
+
+info "building socket_prac_bench (jobs=${BUILD_JOBS})"
+cmake --build "${BUILD_DIR}" --target socket_prac_bench -j "${BUILD_JOBS}"
+
+BENCH_BIN="${BUILD_DIR}/benchmarks/socket_prac_bench"
+[[ -x "${BENCH_BIN}" ]] || fail "benchmark binary not found: ${BENCH_BIN}"
+
+BENCH_JSON="$(make_timestamped_path "${BENCH_OUT_DIR}" "bench" "json")"
+bench_args=(
+    "--benchmark_out=${BENCH_JSON}"
+    "--benchmark_out_format=json"
+    "--benchmark_repetitions=${BENCH_REPETITIONS}"
+)
+if [[ -n "${BENCH_FILTER}" ]]; then
+    bench_args+=("--benchmark_filter=${BENCH_FILTER}")
+fi
+
+info "running benchmarks"
+"${BENCH_BIN}" "${bench_args[@]}"
+
+echo "[PASS] benchmarks finished"
+echo "[INFO] json results: ${BENCH_JSON}"
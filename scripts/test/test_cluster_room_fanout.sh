@@ -0,0 +1,223 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/../.." && pwd)"
+CONFIG_FILE="${TEST_CONFIG:-${ROOT_DIR}/config/test_tls.conf}"
+source "${ROOT_DIR}/scripts/lib/common.sh"
+
+SERVER_BIN="$(resolve_path_from_root "$(cfg_get "test.server_bin" "build/server")")"
+CLIENT_BIN="$(resolve_path_from_root "$(cfg_get "test.client_bin" "build/client")")"
+LOG_DIR="$(resolve_path_from_root "$(cfg_get "test.log_dir" "test_log")")"
+CLIENT_IP="$(cfg_get "test.client_ip" "127.0.0.1")"
+PORT_A="$(cfg_get "test.client_port" "8080")"
+PORT_B="$(cfg_get "test.cluster.second_port" "8081")"
+SERVER_BOOT_WAIT_SEC="$(cfg_get "test.server_boot_wait_sec" "1")"
+CLIENT_TIMEOUT_SEC="$(cfg_get "test.cluster.client_timeout_sec" "15")"
+DELIVER_WAIT_SEC="$(cfg_get "test.cluster.deliver_wait_sec" "2")"
+CA_PATH="$(resolve_path_from_root "$(cfg_get "test.binary.ca_path" "certs/ca.crt.pem")")"
+SERVER_CONFIG="$(resolve_path_from_root "$(cfg_get "test.cluster.server_config" "config/server.conf")")"
+BUS_PORT_A="$(cfg_get "test.cluster.bus_port_a" "9100")"
+BUS_PORT_B="$(cfg_get "test.cluster.bus_port_b" "9101")"
+# notify: LISTEN/NOTIFY through the database, bus: direct node-to-node links.
+TRANSPORT="${CLUSTER_TRANSPORT:-notify}"
+ENV_FILE="$(resolve_path_from_root "$(cfg_get "test.env_file" ".env")")"
+load_env_file "${ENV_FILE}"
+
+mkdir -p "${LOG_DIR}"
+SERVER_A_LOG="$(make_timestamped_path "${LOG_DIR}" "cluster-server-a" "log")"
+SERVER_B_LOG="$(make_timestamped_path "${LOG_DIR}" "cluster-server-b" "log")"
+CLIENT_A_LOG="$(make_timestamped_path "${LOG_DIR}" "cluster-client-a" "log")"
+CLIENT_B_LOG="$(make_timestamped_path "${LOG_DIR}" "cluster-client-b" "log")"
+SETUP_LOG="$(make_timestamped_path "${LOG_DIR}" "cluster-setup" "log")"
+WORK_DIR="$(mktemp -d "${LOG_DIR}/cluster-root-XXXX")"
+
+SERVER_A_PID=""
+SERVER_B_PID=""
+CLIENT_B_PID=""
+USER_A=""
+USER_B=""
+
+cleanup() {
+    for pid in "${CLIENT_B_PID}" "${SERVER_A_PID}" "${SERVER_B_PID}"; do
+        if [[ -n "${pid}" ]] && kill -0 "${pid}" 2>/dev/null; then
+            kill "${pid}" 2>/dev/null || true
+            wait "${pid}" 2>/dev/null || true
+        fi
+    done
+
+    if [[ -n "${USER_A}" ]]; then
+        psql_exec "DELETE FROM social.friendships WHERE user_a_id IN ('${USER_A}', '${USER_B}') OR user_b_id IN ('${USER_A}', '${USER_B}');" >/dev/null 2>&1 || true
+        psql_exec "DELETE FROM auth.users WHERE id IN ('${USER_A}', '${USER_B}');" >/dev/null 2>&1 || true
+    fi
+    rm -rf "${WORK_DIR}" 2>/dev/null || true
+}
+trap cleanup EXIT
+
+fail() {
+    local msg="$1"
+    echo "[FAIL] ${msg}"
+    for f in "${SERVER_A_LOG}" "${SERVER_B_LOG}" "${SETUP_LOG}" "${CLIENT_A_LOG}" "${CLIENT_B_LOG}"; do
+        echo "--- ${f} ---"
+        cat "${f}" 2>/dev/null || true
+    done
+    exit 1
+}
+
+psql_exec() {
+    local sql="$1"
+    PGPASSWORD="${DB_PASSWORD}" \
+    PGSSLMODE="${DB_SSLMODE}" \
+    PGCONNECT_TIMEOUT=5 \
+    psql \
+        --host="${DB_HOST}" \
+        --port="${DB_PORT}" \
+        --username="${DB_USER}" \
+        --dbname="${DB_NAME}" \
+        --no-psqlrc -v ON_ERROR_STOP=1 -q -tA -c "${sql}"
+}
+
+start_node() {
+    local root="$1"
+    local port="$2"
+    local log="$3"
+    (
+        cd "${root}"
+        if command -v stdbuf >/dev/null 2>&1; then
+            exec stdbuf -oL -eL "${SERVER_BIN}" "${port}" >"${log}" 2>&1
+        else
+            exec "${SERVER_BIN}" "${port}" >"${log}" 2>&1
+        fi
+    ) &
+    echo $!
+}
+
+wait_for_log() {
+    local pattern="$1"
+    local log="$2"
+    for _ in $(seq 1 50); do
+        grep -q "${pattern}" "${log}" 2>/dev/null && return 0
+        sleep 0.1
+    done
+    return 1
+}
+
+run_client() {
+    local port="$1"
+    timeout "${CLIENT_TIMEOUT_SEC}s" "${CLIENT_BIN}" "${CLIENT_IP}" "${port}" "${CA_PATH}"
+}
+
+[[ -x "${SERVER_BIN}" ]] || fail "server binary not found: ${SERVER_BIN}"
+[[ -x "${CLIENT_BIN}" ]] || fail "client binary not found: ${CLIENT_BIN}"
+[[ -f "${SERVER_CONFIG}" ]] || fail "server config not found: ${SERVER_CONFIG}"
+[[ "${TRANSPORT}" == "notify" || "${TRANSPORT}" == "bus" ]] || fail "unknown CLUSTER_TRANSPORT: ${TRANSPORT}"
+command -v psql >/dev/null 2>&1 || fail "psql command not found"
+
+DB_HOST="$(cfg_get_from_file "db.host" "127.0.0.1" "${SERVER_CONFIG}")"
+DB_PORT="$(cfg_get_from_file "db.port" "5432" "${SERVER_CONFIG}")"
+DB_NAME="$(cfg_get_from_file "db.name" "" "${SERVER_CONFIG}")"
+DB_SSLMODE="$(cfg_get_from_file "db.sslmode" "disable" "${SERVER_CONFIG}")"
+DB_USER="$(trim_wrapping_quotes "$(cfg_get_from_file "db.user" "" "${ENV_FILE}")")"
+DB_PASSWORD="$(trim_wrapping_quotes "$(cfg_get_from_file "db.password" "" "${ENV_FILE}")")"
+
+# Each node gets a runtime root whose config turns cluster fan-out on; the
+# client port is passed on the command line, the bus address in the config.
+make_root() {
+    local root="$1"
+    local bus_port="$2"
+    mkdir -p "${root}/config"
+    grep -v '^[[:space:]]*cluster\.\(enabled\|transport\|bus_listen\|bus_peers\)' "${SERVER_CONFIG}" \
+        > "${root}/config/server.conf"
+    {
+        echo "cluster.enabled=1"
+        echo "cluster.transport=${TRANSPORT}"
+        echo "cluster.bus_listen=127.0.0.1:${bus_port}"
+        echo "cluster.bus_peers=127.0.0.1:${BUS_PORT_A},127.0.0.1:${BUS_PORT_B}"
+    } >> "${root}/config/server.conf"
+    cp "${ENV_FILE}" "${root}/.env"
+    ln -s "${ROOT_DIR}/certs" "${root}/certs"
+}
+
+make_root "${WORK_DIR}/a" "${BUS_PORT_A}"
+make_root "${WORK_DIR}/b" "${BUS_PORT_B}"
+
+SERVER_A_PID="$(start_node "${WORK_DIR}/a" "${PORT_A}" "${SERVER_A_LOG}")"
+SERVER_B_PID="$(start_node "${WORK_DIR}/b" "${PORT_B}" "${SERVER_B_LOG}")"
+sleep "${SERVER_BOOT_WAIT_SEC}"
+kill -0 "${SERVER_A_PID}" 2>/dev/null || fail "node a exited immediately"
+kill -0 "${SERVER_B_PID}" 2>/dev/null || fail "node b exited immediately"
+if [[ "${TRANSPORT}" == "bus" ]]; then
+    # A node that starts first redials its peer after cluster.bus_reconnect_ms.
+    wait_for_log "node bus connected to 127.0.0.1:${BUS_PORT_B}" "${SERVER_A_LOG}" || fail "node a did not connect to node b"
+    wait_for_log "node bus connected to 127.0.0.1:${BUS_PORT_A}" "${SERVER_B_LOG}" || fail "node b did not connect to node a"
+else
+    grep -q "cluster fan-out listening" "${SERVER_A_LOG}" || fail "node a is not listening for room notifications"
+    grep -q "cluster fan-out listening" "${SERVER_B_LOG}" || fail "node b is not listening for room notifications"
+fi
+
+TS="$(date +%s)_$$"
+USER_A="cluster_a_${TS}"
+USER_B="cluster_b_${TS}"
+ROOM_NAME="cluster_room_${TS}"
+MESSAGE="cluster-fanout-${TS}"
+
+echo "[INFO] registering users and room on node a"
+{
+    sleep 0.5
+    echo "/register ${USER_A} pw"
+    echo "/register ${USER_B} pw"
+    sleep 0.5
+    echo "/login ${USER_A} pw"
+    sleep 0.5
+    echo "/create_room ${ROOM_NAME}"
+    sleep 1
+    echo "/quit"
+} | run_client "${PORT_A}" >"${SETUP_LOG}" 2>&1 || true
+
+ROOM_ID="$(psql_exec "SELECT id FROM chat.rooms WHERE name = '${ROOM_NAME}' AND owner_user_id = '${USER_A}' LIMIT 1;")"
+[[ -n "${ROOM_ID}" ]] || fail "room was not created"
+psql_exec "INSERT INTO chat.room_members (room_id, user_id, role) VALUES (${ROOM_ID}, '${USER_B}', 'member');" >/dev/null
+psql_exec "INSERT INTO social.friendships (user_a_id, user_b_id) VALUES (LEAST('${USER_A}', '${USER_B}'), GREATEST('${USER_A}', '${USER_B}'));" >/dev/null
+
+echo "[INFO] member on node b joins room ${ROOM_ID}"
+{
+    sleep 0.5
+    echo "/login ${USER_B} pw"
+    sleep $((DELIVER_WAIT_SEC + 4))
+    echo "/quit"
+} | run_client "${PORT_B}" >"${CLIENT_B_LOG}" 2>&1 &
+CLIENT_B_PID=$!
+sleep 2
+
+echo "[INFO] sender on node a says into room ${ROOM_ID}"
+{
+    sleep 0.5
+    echo "/login ${USER_A} pw"
+    sleep 0.5
+    echo "/select_room ${ROOM_ID}"
+    sleep 0.3
+    echo "${MESSAGE}"
+    sleep "${DELIVER_WAIT_SEC}"
+    echo "/list_friend"
+    sleep 0.5
+    echo "/quit"
+} | run_client "${PORT_A}" >"${CLIENT_A_LOG}" 2>&1 || true
+
+wait "${CLIENT_B_PID}" 2>/dev/null || true
+CLIENT_B_PID=""
+
+grep -q "${MESSAGE}" "${CLIENT_B_LOG}" || fail "member on node b did not receive the room message"
+
+sender_copies="$(grep -c "${MESSAGE}" "${CLIENT_A_LOG}" || true)"
+[[ "${sender_copies}" == "1" ]] || fail "sender on node a should see its message once (got ${sender_copies})"
+
+receiver_copies="$(grep -c "${MESSAGE}" "${CLIENT_B_LOG}" || true)"
+[[ "${receiver_copies}" == "1" ]] || fail "member on node b should see the message once (got ${receiver_copies})"
+
+# Presence is replicated over the bus only; with LISTEN/NOTIFY a friend on
+# another node still shows as offline.
+if [[ "${TRANSPORT}" == "bus" ]]; then
+    grep -q "friend: ${USER_B} (online)" "${CLIENT_A_LOG}" || fail "friend on node b should show as online on node a"
+fi
+
+echo "[PASS] cluster room fan-out test passed (${TRANSPORT})"
+echo "[INFO] node logs: ${SERVER_A_LOG} ${SERVER_B_LOG}"
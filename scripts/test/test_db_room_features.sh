@@ -167,6 +167,7 @@ expect_eq "$(psql_exec "SELECT to_regclass('chat.rooms') IS NOT NULL;")" "t" "ch
 expect_eq "$(psql_exec "SELECT to_regclass('chat.room_members') IS NOT NULL;")" "t" "chat.room_members table not found"
 expect_eq "$(psql_exec "SELECT to_regclass('chat.messages') IS NOT NULL;")" "t" "chat.messages table not found"
 expect_eq "$(psql_exec "SELECT to_regclass('social.friendships') IS NOT NULL;")" "t" "social.friendships table not found"
+expect_eq "$(psql_exec "SELECT relkind FROM pg_class WHERE oid = 'chat.messages'::regclass;")" "p" "chat.messages is not partitioned"
 
 psql_exec "INSERT INTO auth.users (id, pw, nickname) VALUES ('${OWNER_USER}', 'pw', 'guest') ON CONFLICT (id) DO NOTHING;" >/dev/null
 psql_exec "INSERT INTO auth.users (id, pw, nickname) VALUES ('${FRIEND_USER}', 'pw', 'guest') ON CONFLICT (id) DO NOTHING;" >/dev/null
@@ -245,6 +246,20 @@ expect_eq "${friend_msg_count}" "1" "friend message insert expected 1"
 room_message_total="$(psql_exec "SELECT count(*) FROM chat.messages WHERE room_id=${ROOM_ID};")"
 expect_eq "${room_message_total}" "2" "room message total mismatch"
 
+# every message lands in a partition listed in chat.message_partitions
+unlisted_partitions="$(psql_exec "SELECT count(*) FROM chat.messages m
+    WHERE m.room_id=${ROOM_ID}
+      AND NOT EXISTS (
+          SELECT 1 FROM chat.message_partitions p
+          WHERE p.detached_at IS NULL AND 'chat.' || p.table_name = m.tableoid::regclass::TEXT
+      );")"
+expect_eq "${unlisted_partitions}" "0" "message stored outside the tracked partitions"
+
+# a keyset page bounded by id is planned against one partition only
+pruned_plan="$(psql_exec "EXPLAIN (COSTS OFF) SELECT id FROM chat.messages WHERE room_id=${ROOM_ID} AND id < 2 ORDER BY id DESC LIMIT 10;")"
+scanned_partitions="$(grep -oE " on messages_[a-z0-9_]+" <<<"${pruned_plan}" | sort -u | wc -l | tr -d ' ')"
+expect_eq "${scanned_partitions}" "1" "id-bounded query was not pruned to one partition"
+
 owner_leave="$(leave_result "${OWNER_USER}")"
 expect_eq "${owner_leave}" "owner_cannot_leave" "owner leave policy mismatch"
 
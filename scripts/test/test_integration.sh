@@ -15,6 +15,7 @@ ENV_FILE="$(resolve_path_from_root "$(cfg_get_from_file "test.env_file" ".env" "
 SERVER_CONFIG="$(resolve_path_from_root "$(cfg_get_from_file "test.db.server_config" "config/server.conf" "${DB_CONFIG}")")"
 
 RUN_NORMAL_RAW="$(cfg_get "suite.run.normal" "1")"
+RUN_BINARY_RAW="$(cfg_get "suite.run.binary" "1")"
 RUN_FORCED_RAW="$(cfg_get "suite.run.forced" "1")"
 RUN_MISMATCH_RAW="$(cfg_get "suite.run.mismatch" "1")"
 RUN_EXPIRED_RAW="$(cfg_get "suite.run.expired" "1")"
@@ -25,6 +26,9 @@ RUN_LONGRUN_RAW="$(cfg_get "suite.run.longrun" "0")"
 RUN_DB_RAW="$(cfg_get "suite.run.db" "1")"
 RUN_DB_FRIEND_RAW="$(cfg_get "suite.run.db_friend" "1")"
 RUN_DB_ROOM_RAW="$(cfg_get "suite.run.db_room" "1")"
+RUN_CLUSTER_RAW="$(cfg_get "suite.run.cluster" "1")"
+RUN_PRESENCE_RAW="$(cfg_get "suite.run.presence" "1")"
+RUN_CATCHUP_RAW="$(cfg_get "suite.run.catchup" "1")"
 
 mkdir -p "${LOG_DIR}"
 SUITE_TS="$(timestamp_now)"
@@ -149,7 +153,8 @@ check_db_ready() {
 }
 
 check_suite_prerequisites() {
-    if ! need_tls_tests && ! is_enabled "${RUN_DB_RAW}" && ! is_enabled "${RUN_DB_FRIEND_RAW}" && ! is_enabled "${RUN_DB_ROOM_RAW}"; then
+    if ! need_tls_tests && ! is_enabled "${RUN_DB_RAW}" && ! is_enabled "${RUN_DB_FRIEND_RAW}" && ! is_enabled "${RUN_DB_ROOM_RAW}" \
+        && ! is_enabled "${RUN_CLUSTER_RAW}" && ! is_enabled "${RUN_PRESENCE_RAW}" && ! is_enabled "${RUN_CATCHUP_RAW}"; then
         return 0
     fi
 
@@ -252,6 +257,10 @@ run_test() {
     echo "[FAIL] missing executable: scripts/test/test_tls_normal_connection.sh"
     exit 1
 }
+[[ -x "${ROOT_DIR}/scripts/test/test_tls_binary_protocol.sh" ]] || {
+    echo "[FAIL] missing executable: scripts/test/test_tls_binary_protocol.sh"
+    exit 1
+}
 [[ -x "${ROOT_DIR}/scripts/test/test_tls_forced_termination.sh" ]] || {
     echo "[FAIL] missing executable: scripts/test/test_tls_forced_termination.sh"
     exit 1
@@ -292,6 +301,18 @@ run_test() {
     echo "[FAIL] missing executable: scripts/test/test_db_room_features.sh"
     exit 1
 }
+[[ -x "${ROOT_DIR}/scripts/test/test_cluster_room_fanout.sh" ]] || {
+    echo "[FAIL] missing executable: scripts/test/test_cluster_room_fanout.sh"
+    exit 1
+}
+[[ -x "${ROOT_DIR}/scripts/test/test_presence_push.sh" ]] || {
+    echo "[FAIL] missing executable: scripts/test/test_presence_push.sh"
+    exit 1
+}
+[[ -x "${ROOT_DIR}/scripts/test/test_offline_catchup.sh" ]] || {
+    echo "[FAIL] missing executable: scripts/test/test_offline_catchup.sh"
+    exit 1
+}
 
 echo "[INFO] integration suite start ${SUITE_TS}" | tee -a "${SUITE_LOG}"
 echo "[INFO] suite config: ${CONFIG_FILE}" | tee -a "${SUITE_LOG}"
@@ -312,6 +333,15 @@ else
 fi
 if [[ "${FAIL_FAST}" == "1" && "${FAIL_COUNT}" -gt 0 ]]; then goto_end=1; else goto_end=0; fi
 
+if [[ "${goto_end}" -eq 0 ]]; then
+    if is_enabled "${RUN_BINARY_RAW}"; then
+        run_test "tls-binary" "${ROOT_DIR}/scripts/test/test_tls_binary_protocol.sh" "${TLS_CONFIG}" || true
+    else
+        skip_test "tls-binary"
+    fi
+fi
+if [[ "${FAIL_FAST}" == "1" && "${FAIL_COUNT}" -gt 0 ]]; then goto_end=1; fi
+
 if [[ "${goto_end}" -eq 0 ]]; then
     if is_enabled "${RUN_FORCED_RAW}"; then
         run_test "tls-forced" "${ROOT_DIR}/scripts/test/test_tls_forced_termination.sh" "${TLS_CONFIG}" || true
@@ -400,6 +430,36 @@ if [[ "${goto_end}" -eq 0 ]]; then
         skip_test "db-room"
     fi
 fi
+if [[ "${FAIL_FAST}" == "1" && "${FAIL_COUNT}" -gt 0 ]]; then goto_end=1; fi
+
+if [[ "${goto_end}" -eq 0 ]]; then
+    if is_enabled "${RUN_CLUSTER_RAW}"; then
+        run_test "cluster-fanout" "${ROOT_DIR}/scripts/test/test_cluster_room_fanout.sh" "${TLS_CONFIG}" || true
+        CLUSTER_TRANSPORT=bus \
+            run_test "cluster-bus" "${ROOT_DIR}/scripts/test/test_cluster_room_fanout.sh" "${TLS_CONFIG}" || true
+    else
+        skip_test "cluster-fanout"
+        skip_test "cluster-bus"
+    fi
+fi
+if [[ "${FAIL_FAST}" == "1" && "${FAIL_COUNT}" -gt 0 ]]; then goto_end=1; fi
+
+if [[ "${goto_end}" -eq 0 ]]; then
+    if is_enabled "${RUN_PRESENCE_RAW}"; then
+        run_test "presence-push" "${ROOT_DIR}/scripts/test/test_presence_push.sh" "${TLS_CONFIG}" || true
+    else
+        skip_test "presence-push"
+    fi
+fi
+if [[ "${FAIL_FAST}" == "1" && "${FAIL_COUNT}" -gt 0 ]]; then goto_end=1; fi
+
+if [[ "${goto_end}" -eq 0 ]]; then
+    if is_enabled "${RUN_CATCHUP_RAW}"; then
+        run_test "offline-catchup" "${ROOT_DIR}/scripts/test/test_offline_catchup.sh" "${TLS_CONFIG}" || true
+    else
+        skip_test "offline-catchup"
+    fi
+fi
 
 echo "[INFO] summary total=${TOTAL_COUNT} pass=${PASS_COUNT} fail=${FAIL_COUNT} skip=${SKIP_COUNT}" | tee -a "${SUITE_LOG}"
 if [[ "${#FAILED_TESTS[@]}" -gt 0 ]]; then
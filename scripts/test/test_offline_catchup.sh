@@ -0,0 +1,202 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/../.." && pwd)"
+CONFIG_FILE="${TEST_CONFIG:-${ROOT_DIR}/config/test_tls.conf}"
+source "${ROOT_DIR}/scripts/lib/common.sh"
+
+SERVER_BIN="$(resolve_path_from_root "$(cfg_get "test.server_bin" "build/server")")"
+CLIENT_BIN="$(resolve_path_from_root "$(cfg_get "test.client_bin" "build/client")")"
+LOG_DIR="$(resolve_path_from_root "$(cfg_get "test.log_dir" "test_log")")"
+CLIENT_IP="$(cfg_get "test.client_ip" "127.0.0.1")"
+CLIENT_PORT="$(cfg_get "test.client_port" "8080")"
+SERVER_BOOT_WAIT_SEC="$(cfg_get "test.server_boot_wait_sec" "1")"
+CLIENT_TIMEOUT_SEC="$(cfg_get "test.catchup.client_timeout_sec" "20")"
+CA_PATH="$(resolve_path_from_root "$(cfg_get "test.binary.ca_path" "certs/ca.crt.pem")")"
+SERVER_CONFIG="$(resolve_path_from_root "$(cfg_get "test.catchup.server_config" "config/server.conf")")"
+ENV_FILE="$(resolve_path_from_root "$(cfg_get "test.env_file" ".env")")"
+load_env_file "${ENV_FILE}"
+
+mkdir -p "${LOG_DIR}"
+SERVER_LOG="$(make_timestamped_path "${LOG_DIR}" "catchup-server" "log")"
+SETUP_LOG="$(make_timestamped_path "${LOG_DIR}" "catchup-setup" "log")"
+FIRST_LOG="$(make_timestamped_path "${LOG_DIR}" "catchup-client-first" "log")"
+SECOND_LOG="$(make_timestamped_path "${LOG_DIR}" "catchup-client-second" "log")"
+LIVE_LOG="$(make_timestamped_path "${LOG_DIR}" "catchup-client-live" "log")"
+THIRD_LOG="$(make_timestamped_path "${LOG_DIR}" "catchup-client-third" "log")"
+
+SERVER_PID=""
+READER_PID=""
+USER_A=""
+USER_B=""
+
+cleanup() {
+    for pid in "${READER_PID}" "${SERVER_PID}"; do
+        if [[ -n "${pid}" ]] && kill -0 "${pid}" 2>/dev/null; then
+            kill "${pid}" 2>/dev/null || true
+            wait "${pid}" 2>/dev/null || true
+        fi
+    done
+
+    if [[ -n "${USER_A}" ]]; then
+        psql_exec "DELETE FROM chat.rooms WHERE owner_user_id = '${USER_A}';" >/dev/null 2>&1 || true
+        psql_exec "DELETE FROM auth.users WHERE id IN ('${USER_A}', '${USER_B}');" >/dev/null 2>&1 || true
+    fi
+}
+trap cleanup EXIT
+
+fail() {
+    local msg="$1"
+    echo "[FAIL] ${msg}"
+    for f in "${SERVER_LOG}" "${SETUP_LOG}" "${FIRST_LOG}" "${SECOND_LOG}" "${LIVE_LOG}" "${THIRD_LOG}"; do
+        echo "--- ${f} ---"
+        cat "${f}" 2>/dev/null || true
+    done
+    exit 1
+}
+
+psql_exec() {
+    local sql="$1"
+    PGPASSWORD="${DB_PASSWORD}" \
+    PGSSLMODE="${DB_SSLMODE}" \
+    PGCONNECT_TIMEOUT=5 \
+    psql \
+        --host="${DB_HOST}" \
+        --port="${DB_PORT}" \
+        --username="${DB_USER}" \
+        --dbname="${DB_NAME}" \
+        --no-psqlrc -v ON_ERROR_STOP=1 -q -tA -c "${sql}"
+}
+
+run_client() {
+    timeout "${CLIENT_TIMEOUT_SEC}s" "${CLIENT_BIN}" "${CLIENT_IP}" "${CLIENT_PORT}" "${CA_PATH}"
+}
+
+login_and_quit() {
+    local user="$1"
+    {
+        sleep 0.5
+        echo "/login ${user} pw"
+        sleep 1.5
+        echo "/quit"
+    } | run_client || true
+}
+
+[[ -x "${SERVER_BIN}" ]] || fail "server binary not found: ${SERVER_BIN}"
+[[ -x "${CLIENT_BIN}" ]] || fail "client binary not found: ${CLIENT_BIN}"
+[[ -f "${SERVER_CONFIG}" ]] || fail "server config not found: ${SERVER_CONFIG}"
+command -v psql >/dev/null 2>&1 || fail "psql command not found"
+
+DB_HOST="$(cfg_get_from_file "db.host" "127.0.0.1" "${SERVER_CONFIG}")"
+DB_PORT="$(cfg_get_from_file "db.port" "5432" "${SERVER_CONFIG}")"
+DB_NAME="$(cfg_get_from_file "db.name" "" "${SERVER_CONFIG}")"
+DB_SSLMODE="$(cfg_get_from_file "db.sslmode" "disable" "${SERVER_CONFIG}")"
+DB_USER="$(trim_wrapping_quotes "$(cfg_get_from_file "db.user" "" "${ENV_FILE}")")"
+DB_PASSWORD="$(trim_wrapping_quotes "$(cfg_get_from_file "db.password" "" "${ENV_FILE}")")"
+PER_ROOM="$(cfg_get_from_file "catchup.per_room" "50" "${SERVER_CONFIG}")"
+(( PER_ROOM >= 3 )) || fail "catchup.per_room must be at least 3 in ${SERVER_CONFIG}"
+FLUSH_MS="$(cfg_get_from_file "unread.flush_ms" "1000" "${SERVER_CONFIG}")"
+FLUSH_SEC="$(( FLUSH_MS / 1000 + 1 ))"
+
+echo "[INFO] starting server: ${SERVER_BIN}"
+if command -v stdbuf >/dev/null 2>&1; then
+    stdbuf -oL -eL "${SERVER_BIN}" >"${SERVER_LOG}" 2>&1 &
+else
+    "${SERVER_BIN}" >"${SERVER_LOG}" 2>&1 &
+fi
+SERVER_PID=$!
+sleep "${SERVER_BOOT_WAIT_SEC}"
+kill -0 "${SERVER_PID}" 2>/dev/null || fail "server exited immediately"
+
+TS="$(date +%s)_$$"
+USER_A="catchup_a_${TS}"
+USER_B="catchup_b_${TS}"
+
+echo "[INFO] registering ${USER_A} and ${USER_B}"
+{
+    sleep 0.5
+    echo "/register ${USER_A} pw"
+    echo "/register ${USER_B} pw"
+    sleep 1
+    echo "/quit"
+} | run_client >"${SETUP_LOG}" 2>&1 || true
+
+ROOM_ID="$(psql_exec "INSERT INTO chat.rooms (name, owner_user_id) VALUES ('catchup_${TS}', '${USER_A}') RETURNING id;" | head -n1)"
+[[ -n "${ROOM_ID}" ]] || fail "room insert failed"
+psql_exec "INSERT INTO chat.room_members (room_id, user_id, role) VALUES (${ROOM_ID}, '${USER_A}', 'owner'), (${ROOM_ID}, '${USER_B}', 'member');" >/dev/null \
+    || fail "room member insert failed"
+psql_exec "INSERT INTO chat.messages (room_id, sender_user_id, body) SELECT ${ROOM_ID}, '${USER_A}', 'offline_' || g FROM generate_series(1, 3) g;" >/dev/null \
+    || fail "message insert failed"
+
+echo "[INFO] ${USER_B} logs in with three unread messages"
+login_and_quit "${USER_B}" >"${FIRST_LOG}" 2>&1
+grep -q "unread: room=${ROOM_ID} count=3" "${FIRST_LOG}" || fail "missing unread header for room ${ROOM_ID}"
+for i in 1 2 3; do
+    grep -q "from=${USER_A} text=offline_${i}" "${FIRST_LOG}" || fail "missing unread message offline_${i}"
+done
+
+echo "[INFO] ${USER_B} logs in again with nothing unread"
+login_and_quit "${USER_B}" >"${SECOND_LOG}" 2>&1
+grep -q "login success" "${SECOND_LOG}" || fail "second login failed"
+if grep -q "unread:" "${SECOND_LOG}"; then fail "messages replayed after catch-up"; fi
+
+echo "[INFO] ${USER_B} reads a live message, then reconnects"
+{
+    sleep 0.5
+    echo "/login ${USER_B} pw"
+    sleep "$(( 3 + FLUSH_SEC ))"
+    echo "/list_room"
+    sleep 0.5
+    echo "/history ${ROOM_ID} 10"
+    sleep 0.5
+    echo "/list_room"
+    sleep 0.5
+    echo "/quit"
+} | run_client >"${LIVE_LOG}" 2>&1 &
+READER_PID=$!
+sleep 1.5
+{
+    sleep 0.5
+    echo "/login ${USER_A} pw"
+    echo "/select_room ${ROOM_ID}"
+    echo "live_${TS}"
+    sleep 1
+    echo "/quit"
+} | run_client >>"${SETUP_LOG}" 2>&1 || true
+wait "${READER_PID}" 2>/dev/null || true
+READER_PID=""
+grep -q "live_${TS}" "${LIVE_LOG}" || fail "live message not delivered"
+unread_lines="$(grep "room: id=${ROOM_ID} " "${LIVE_LOG}" | grep -o "unread=[0-9]*" | tr '\n' ' ' || true)"
+[[ "${unread_lines}" == "unread=1 unread=0 " ]] || fail "unexpected unread counts before/after history: ${unread_lines}"
+sleep 1
+
+ids="$(psql_exec "SELECT string_agg(id::TEXT, ' ' ORDER BY id DESC) FROM chat.messages WHERE room_id = ${ROOM_ID};")"
+read -r NEWEST SECOND THIRD OLDEST <<<"${ids}"
+[[ -n "${OLDEST}" ]] || fail "expected four messages in room ${ROOM_ID}: ${ids}"
+
+echo "[INFO] ${USER_B} reconnects and pages back through history"
+{
+    sleep 0.5
+    echo "/login ${USER_B} pw"
+    sleep 0.5
+    echo "/history ${ROOM_ID} 2 $(( NEWEST + 1 ))"
+    sleep 0.5
+    echo "/history ${ROOM_ID} 10 ${SECOND}"
+    sleep 0.5
+    echo "/search ${ROOM_ID} LIVE_${TS}"
+    sleep 0.5
+    echo "/search ${ROOM_ID} nomatch_${TS}"
+    sleep 0.5
+    echo "/quit"
+} | run_client >"${THIRD_LOG}" 2>&1 || true
+grep -q "login success" "${THIRD_LOG}" || fail "third login failed"
+if grep -q "unread:" "${THIRD_LOG}"; then fail "live message replayed after logout"; fi
+grep -q "history: end count=2 next_before=${SECOND}" "${THIRD_LOG}" || fail "first history page mismatch"
+grep -q "history: end count=2 next_before=0" "${THIRD_LOG}" || fail "second history page mismatch"
+page_ids="$(grep -o "history: id=[0-9]*" "${THIRD_LOG}" | cut -d= -f2 | tr '\n' ' ')"
+[[ "${page_ids}" == "${NEWEST} ${SECOND} ${THIRD} ${OLDEST} " ]] || fail "history pages out of order: ${page_ids}"
+grep -q "search: id=${NEWEST} from=${USER_A} text=live_${TS}" "${THIRD_LOG}" || fail "live message not found by search"
+[[ "$(grep -c "search: room=${ROOM_ID} count=" "${THIRD_LOG}")" == "2" ]] || fail "missing search replies"
+grep -q "search: room=${ROOM_ID} count=0" "${THIRD_LOG}" || fail "search matched a missing term"
+
+echo "[PASS] offline catch-up test passed"
@@ -0,0 +1,150 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/../.." && pwd)"
+CONFIG_FILE="${TEST_CONFIG:-${ROOT_DIR}/config/test_tls.conf}"
+source "${ROOT_DIR}/scripts/lib/common.sh"
+
+SERVER_BIN="$(resolve_path_from_root "$(cfg_get "test.server_bin" "build/server")")"
+CLIENT_BIN="$(resolve_path_from_root "$(cfg_get "test.client_bin" "build/client")")"
+LOG_DIR="$(resolve_path_from_root "$(cfg_get "test.log_dir" "test_log")")"
+CLIENT_IP="$(cfg_get "test.client_ip" "127.0.0.1")"
+CLIENT_PORT="$(cfg_get "test.client_port" "8080")"
+SERVER_BOOT_WAIT_SEC="$(cfg_get "test.server_boot_wait_sec" "1")"
+CLIENT_TIMEOUT_SEC="$(cfg_get "test.presence.client_timeout_sec" "20")"
+CA_PATH="$(resolve_path_from_root "$(cfg_get "test.binary.ca_path" "certs/ca.crt.pem")")"
+SERVER_CONFIG="$(resolve_path_from_root "$(cfg_get "test.presence.server_config" "config/server.conf")")"
+ENV_FILE="$(resolve_path_from_root "$(cfg_get "test.env_file" ".env")")"
+load_env_file "${ENV_FILE}"
+
+mkdir -p "${LOG_DIR}"
+SERVER_LOG="$(make_timestamped_path "${LOG_DIR}" "presence-server" "log")"
+WATCHER_LOG="$(make_timestamped_path "${LOG_DIR}" "presence-client-watcher" "log")"
+FRIEND_LOG="$(make_timestamped_path "${LOG_DIR}" "presence-client-friend" "log")"
+SETUP_LOG="$(make_timestamped_path "${LOG_DIR}" "presence-setup" "log")"
+
+SERVER_PID=""
+WATCHER_PID=""
+USER_A=""
+USER_B=""
+
+cleanup() {
+    for pid in "${WATCHER_PID}" "${SERVER_PID}"; do
+        if [[ -n "${pid}" ]] && kill -0 "${pid}" 2>/dev/null; then
+            kill "${pid}" 2>/dev/null || true
+            wait "${pid}" 2>/dev/null || true
+        fi
+    done
+
+    if [[ -n "${USER_A}" ]]; then
+        psql_exec "DELETE FROM social.friendships WHERE user_a_id IN ('${USER_A}', '${USER_B}') OR user_b_id IN ('${USER_A}', '${USER_B}');" >/dev/null 2>&1 || true
+        psql_exec "DELETE FROM auth.users WHERE id IN ('${USER_A}', '${USER_B}');" >/dev/null 2>&1 || true
+    fi
+}
+trap cleanup EXIT
+
+fail() {
+    local msg="$1"
+    echo "[FAIL] ${msg}"
+    for f in "${SERVER_LOG}" "${SETUP_LOG}" "${WATCHER_LOG}" "${FRIEND_LOG}"; do
+        echo "--- ${f} ---"
+        cat "${f}" 2>/dev/null || true
+    done
+    exit 1
+}
+
+psql_exec() {
+    local sql="$1"
+    PGPASSWORD="${DB_PASSWORD}" \
+    PGSSLMODE="${DB_SSLMODE}" \
+    PGCONNECT_TIMEOUT=5 \
+    psql \
+        --host="${DB_HOST}" \
+        --port="${DB_PORT}" \
+        --username="${DB_USER}" \
+        --dbname="${DB_NAME}" \
+        --no-psqlrc -v ON_ERROR_STOP=1 -q -tA -c "${sql}"
+}
+
+run_client() {
+    timeout "${CLIENT_TIMEOUT_SEC}s" "${CLIENT_BIN}" "${CLIENT_IP}" "${CLIENT_PORT}" "${CA_PATH}"
+}
+
+[[ -x "${SERVER_BIN}" ]] || fail "server binary not found: ${SERVER_BIN}"
+[[ -x "${CLIENT_BIN}" ]] || fail "client binary not found: ${CLIENT_BIN}"
+[[ -f "${SERVER_CONFIG}" ]] || fail "server config not found: ${SERVER_CONFIG}"
+command -v psql >/dev/null 2>&1 || fail "psql command not found"
+
+DB_HOST="$(cfg_get_from_file "db.host" "127.0.0.1" "${SERVER_CONFIG}")"
+DB_PORT="$(cfg_get_from_file "db.port" "5432" "${SERVER_CONFIG}")"
+DB_NAME="$(cfg_get_from_file "db.name" "" "${SERVER_CONFIG}")"
+DB_SSLMODE="$(cfg_get_from_file "db.sslmode" "disable" "${SERVER_CONFIG}")"
+DB_USER="$(trim_wrapping_quotes "$(cfg_get_from_file "db.user" "" "${ENV_FILE}")")"
+DB_PASSWORD="$(trim_wrapping_quotes "$(cfg_get_from_file "db.password" "" "${ENV_FILE}")")"
+COALESCE_MS="$(cfg_get_from_file "presence.coalesce_ms" "1000" "${SERVER_CONFIG}")"
+[[ "$(cfg_get_from_file "presence.push" "1" "${SERVER_CONFIG}")" == "1" ]] || fail "presence.push is off in ${SERVER_CONFIG}"
+
+# Long enough for one coalesce window to close.
+SETTLE_SEC="$(( COALESCE_MS / 1000 + 2 ))"
+
+echo "[INFO] starting server: ${SERVER_BIN}"
+if command -v stdbuf >/dev/null 2>&1; then
+    stdbuf -oL -eL "${SERVER_BIN}" >"${SERVER_LOG}" 2>&1 &
+else
+    "${SERVER_BIN}" >"${SERVER_LOG}" 2>&1 &
+fi
+SERVER_PID=$!
+sleep "${SERVER_BOOT_WAIT_SEC}"
+kill -0 "${SERVER_PID}" 2>/dev/null || fail "server exited immediately"
+
+TS="$(date +%s)_$$"
+USER_A="presence_a_${TS}"
+USER_B="presence_b_${TS}"
+
+echo "[INFO] registering ${USER_A} and ${USER_B}"
+{
+    sleep 0.5
+    echo "/register ${USER_A} pw"
+    echo "/register ${USER_B} pw"
+    sleep 1
+    echo "/quit"
+} | run_client >"${SETUP_LOG}" 2>&1 || true
+psql_exec "INSERT INTO social.friendships (user_a_id, user_b_id) VALUES (LEAST('${USER_A}', '${USER_B}'), GREATEST('${USER_A}', '${USER_B}'));" >/dev/null \
+    || fail "friendship insert failed"
+
+echo "[INFO] ${USER_A} watches presence events"
+{
+    sleep 0.5
+    echo "/login ${USER_A} pw"
+    sleep $(( SETTLE_SEC * 3 + 3 ))
+    echo "/quit"
+} | run_client >"${WATCHER_LOG}" 2>&1 &
+WATCHER_PID=$!
+sleep 1.5
+
+echo "[INFO] ${USER_B} stays online past the coalesce window"
+{
+    sleep 0.5
+    echo "/login ${USER_B} pw"
+    sleep "${SETTLE_SEC}"
+    echo "/quit"
+} | run_client >"${FRIEND_LOG}" 2>&1 || true
+sleep "${SETTLE_SEC}"
+
+echo "[INFO] ${USER_B} logs in and out inside one window"
+{
+    sleep 0.5
+    echo "/login ${USER_B} pw"
+    sleep 0.1
+    echo "/quit"
+} | run_client >>"${FRIEND_LOG}" 2>&1 || true
+
+wait "${WATCHER_PID}" 2>/dev/null || true
+WATCHER_PID=""
+
+online_count="$(grep -c "presence: ${USER_B} online" "${WATCHER_LOG}" || true)"
+offline_count="$(grep -c "presence: ${USER_B} offline" "${WATCHER_LOG}" || true)"
+[[ "${online_count}" == "1" ]] || fail "expected one online event for ${USER_B} (got ${online_count})"
+[[ "${offline_count}" == "1" ]] || fail "expected one offline event for ${USER_B} (got ${offline_count})"
+
+echo "[PASS] presence push test passed"
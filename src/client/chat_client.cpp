@@ -15,7 +15,7 @@ chat_client::chat_client(socket_info si, unique_fd server_fd, tls_context tls_ct
     logged_in(false){}
 
 std::expected <chat_client, error_code> chat_client::create(
-    const char* ip, const char* port, std::string_view ca_file_path
+    const char* ip, const char* port, std::string_view ca_file_path, command_codec::wire_format format
 ){
     auto addr_exp = get_addr_client(ip, port);
     if(!addr_exp){
@@ -45,6 +45,11 @@ std::expected <chat_client, error_code> chat_client::create(
 
     socket_info si{};
     si.tls = std::move(*tls_exp);
+    if(format == command_codec::wire_format::binary){
+        si.send.append(command_codec::binary_preamble());
+        si.send.set_format(format);
+    }
+    si.format_negotiated = true;
 
     return std::expected<chat_client, error_code>(
         std::in_place, std::move(si), std::move(*server_fd_exp), std::move(tls_ctx)
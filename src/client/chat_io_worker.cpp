@@ -15,7 +15,7 @@ chat_io_worker::chat_io_worker(
     socket_info& si, unique_fd& server_fd, chat_executor& executor, std::atomic_bool& logged_in
 ) : si(si), server_fd(server_fd), executor(executor), logged_in(logged_in){}
 
-chat_io_worker::parsed_command chat_io_worker::parse(const std::string& line){
+chat_io_worker::parsed_command chat_io_worker::parse(std::string_view line){
     parsed_command parsed{};
 
     std::size_t idx = 0;
@@ -26,7 +26,7 @@ chat_io_worker::parsed_command chat_io_worker::parse(const std::string& line){
         const std::size_t start = idx;
         while(idx < n && line[idx] != ' ') ++idx;
 
-        std::string token = line.substr(start, idx - start);
+        std::string token(line.substr(start, idx - start));
         if(parsed.cmd.empty()) parsed.cmd = std::move(token);
         else parsed.args.push_back(std::move(token));
 
@@ -137,15 +137,8 @@ std::expected<void, error_code> chat_io_worker::run(std::stop_token stop_token){
             auto recv_exp = recv_socket();
             if(!recv_exp) return std::unexpected(recv_exp.error());
 
-            while(auto line = line_parser::parse_line(si.recv)){
-                auto dec_exp = command_codec::decode(*line);
-                if(!dec_exp){
-                    logger::log_warn("command_codec/decode failed", "chat_io_worker::run()", si, dec_exp);
-                    continue;
-                }
-
-                executor.request_execute(std::move(*dec_exp));
-            }
+            auto exec_exp = execute_received();
+            if(!exec_exp) return std::unexpected(exec_exp.error());
 
             if(*recv_exp) break;
         }
@@ -166,6 +159,35 @@ std::expected<void, error_code> chat_io_worker::run(std::stop_token stop_token){
     return {};
 }
 
+std::expected<void, error_code> chat_io_worker::execute_received(){
+    if(si.send.get_format() == command_codec::wire_format::binary){
+        while(true){
+            auto frame_exp = line_parser::parse_binary_frame(si.recv);
+            if(!frame_exp) return std::unexpected(frame_exp.error());
+            if(!*frame_exp) return {};
+            execute_decoded(command_codec::decode_binary(**frame_exp));
+        }
+    }
+
+    while(auto line = line_parser::parse_line(si.recv)){
+        execute_decoded(command_codec::decode(*line));
+    }
+    return {};
+}
+
+void chat_io_worker::execute_decoded(const std::expected<command_codec::command_view, error_code>& dec_exp){
+    if(!dec_exp){
+        logger::log_warn("command_codec/decode failed", "chat_io_worker::execute_decoded()", si, dec_exp);
+        return;
+    }
+    if(std::holds_alternative<command_codec::basic_cmd_ping<std::string_view>>(*dec_exp)){
+        si.send.append(command_codec::cmd_pong{});
+        return;
+    }
+    if(std::holds_alternative<command_codec::basic_cmd_pong<std::string_view>>(*dec_exp)) return;
+    executor.request_execute(command_codec::materialize(*dec_exp));
+}
+
 std::expected<bool, error_code> chat_io_worker::recv_socket(){
     auto dr_exp = drain_recv(si);
     if(!dr_exp) return std::unexpected(dr_exp.error());
@@ -200,7 +222,7 @@ std::expected<bool, error_code> chat_io_worker::send_stdin(){
     return false;
 }
 
-void chat_io_worker::execute(const std::string& line){
+void chat_io_worker::execute(std::string_view line){
     if(line.empty()) return;
     parsed_command parsed = parse(line);
     if(parsed.cmd.empty()) return;
@@ -355,14 +377,29 @@ void chat_io_worker::execute(const std::string& line){
     }
 
     if(parsed.cmd == "/history"){
+        if(parsed.args.size() == 3){
+            history_before(parsed.args[0], parsed.args[1], parsed.args[2]);
+            return;
+        }
         if(parsed.args.size() != 2){
-            client_console::print_line("/history <room_id> <limit>");
+            client_console::print_line("/history <room_id> <limit> [before_id]");
             return;
         }
         history(parsed.args[0], parsed.args[1]);
         return;
     }
 
+    if(parsed.cmd == "/search"){
+        if(parsed.args.size() < 2){
+            client_console::print_line("/search <room_id> <terms>");
+            return;
+        }
+        std::string terms = parsed.args[1];
+        for(std::size_t i = 2; i < parsed.args.size(); ++i) terms += " " + parsed.args[i];
+        search(parsed.args[0], terms);
+        return;
+    }
+
     if(parsed.cmd == "/help"){
         if(parsed.args.size() != 0){
             client_console::print_line("/help");
@@ -377,13 +414,13 @@ void chat_io_worker::execute(const std::string& line){
     }
 }
 
-void chat_io_worker::say(const std::string& line){
+void chat_io_worker::say(std::string_view line){
     if(!selected_room_id){
         client_console::print_line("select room first: /select_room <room_id>");
         return;
     }
 
-    si.send.append(command_codec::cmd_say{std::to_string(*selected_room_id), line});
+    si.send.append(command_codec::cmd_say{std::to_string(*selected_room_id), std::string(line)});
 }
 
 void chat_io_worker::change_nickname(const std::string& nick){
@@ -464,6 +501,14 @@ void chat_io_worker::history(const std::string& room_id, const std::string& limi
     si.send.append(command_codec::cmd_history{room_id, limit});
 }
 
+void chat_io_worker::history_before(const std::string& room_id, const std::string& limit, const std::string& before_id){
+    si.send.append(command_codec::cmd_history_before{room_id, limit, before_id});
+}
+
+void chat_io_worker::search(const std::string& room_id, const std::string& terms){
+    si.send.append(command_codec::cmd_search{room_id, terms});
+}
+
 void chat_io_worker::help(){
     std::lock_guard<std::mutex> lock(client_console::output_mutex());
     std::cout << "commands:\n"
@@ -481,7 +526,8 @@ void chat_io_worker::help(){
               << "  /leave_room <room_id>\n"
               << "  /select_room <room_id>\n"
               << "  /list_room\n"
-              << "  /history <room_id> <limit>\n"
+              << "  /history <room_id> <limit> [before_id]\n"
+              << "  /search <room_id> <terms>\n"
               << "  /nick <nickname>\n"
               << "  /help\n"
               << "  <text> (send chat message, room must be selected)\n";
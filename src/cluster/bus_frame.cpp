@@ -0,0 +1,142 @@
+#include "cluster/bus_frame.hpp"
+#include "protocol/command_codec.hpp"
+
+namespace{
+    constexpr std::size_t MAX_VARINT = 10;
+
+    void put_varint(std::string& out, std::uint64_t v){
+        while(v >= 0x80){
+            out.push_back(static_cast<char>((v & 0x7f) | 0x80));
+            v >>= 7;
+        }
+        out.push_back(static_cast<char>(v));
+    }
+
+    std::size_t varint_size(std::uint64_t v){
+        std::size_t n = 1;
+        while(v >= 0x80){
+            v >>= 7;
+            ++n;
+        }
+        return n;
+    }
+
+    // Returns the bytes read, 0 if data ends mid-varint.
+    std::expected<std::size_t, error_code> get_varint(std::string_view data, std::uint64_t& v){
+        v = 0;
+        for(std::size_t i = 0; i < data.size(); ++i){
+            if(i == MAX_VARINT) return std::unexpected(error_code::from_decode(command_codec::decode_error::invalid_frame));
+            const auto byte = static_cast<unsigned char>(data[i]);
+            v |= static_cast<std::uint64_t>(byte & 0x7f) << (7 * i);
+            if((byte & 0x80) == 0) return i + 1;
+        }
+        return 0;
+    }
+
+    // Body fields are complete once the length prefix is, so running out is malformed.
+    bool take_varint(std::string_view& body, std::uint64_t& v){
+        auto n_exp = get_varint(body, v);
+        if(!n_exp || *n_exp == 0) return false;
+        body.remove_prefix(*n_exp);
+        return true;
+    }
+
+    bool take_string(std::string_view& body, std::string_view& out){
+        std::uint64_t len = 0;
+        if(!take_varint(body, len) || len > body.size()) return false;
+        out = body.substr(0, len);
+        body.remove_prefix(len);
+        return true;
+    }
+}
+
+void bus_frame::append_message(
+    std::string& out, std::int64_t room_id, std::string_view nickname, std::string_view text
+){
+    const auto room = static_cast<std::uint64_t>(room_id);
+    const std::size_t body = 1 + varint_size(room)
+        + varint_size(nickname.size()) + nickname.size()
+        + varint_size(text.size()) + text.size();
+
+    out.reserve(out.size() + varint_size(body) + body);
+    put_varint(out, body);
+    out.push_back(static_cast<char>(frame_type::message));
+    put_varint(out, room);
+    put_varint(out, nickname.size());
+    out.append(nickname);
+    put_varint(out, text.size());
+    out.append(text);
+}
+
+void bus_frame::append_interest(std::string& out, frame_type type, std::int64_t room_id){
+    const auto room = static_cast<std::uint64_t>(room_id);
+    put_varint(out, 1 + varint_size(room));
+    out.push_back(static_cast<char>(type));
+    put_varint(out, room);
+}
+
+void bus_frame::append_presence(std::string& out, frame_type type, std::string_view user_id){
+    put_varint(out, 1 + varint_size(user_id.size()) + user_id.size());
+    out.push_back(static_cast<char>(type));
+    put_varint(out, user_id.size());
+    out.append(user_id);
+}
+
+void bus_frame::append_digest(std::string& out, std::uint64_t count, std::uint64_t digest){
+    put_varint(out, 1 + varint_size(count) + varint_size(digest));
+    out.push_back(static_cast<char>(frame_type::presence_digest));
+    put_varint(out, count);
+    put_varint(out, digest);
+}
+
+void bus_frame::append_control(std::string& out, frame_type type){
+    put_varint(out, 1);
+    out.push_back(static_cast<char>(type));
+}
+
+std::expected<std::size_t, error_code> bus_frame::decode(std::string_view data, frame& out){
+    std::uint64_t body_len = 0;
+    auto hdr_exp = get_varint(data, body_len);
+    if(!hdr_exp) return std::unexpected(hdr_exp.error());
+    if(*hdr_exp == 0) return 0;
+    if(body_len == 0) return std::unexpected(error_code::from_decode(command_codec::decode_error::invalid_frame));
+    if(body_len > MAX_BODY) return std::unexpected(error_code::from_decode(command_codec::decode_error::frame_too_large));
+    if(data.size() - *hdr_exp < body_len) return 0;
+
+    std::string_view body = data.substr(*hdr_exp, body_len);
+    const auto type = static_cast<frame_type>(body.front());
+    body.remove_prefix(1);
+
+    out = frame{};
+    out.type = type;
+    std::uint64_t room = 0;
+    bool ok = false;
+    switch(type){
+    case frame_type::message:
+        ok = take_varint(body, room) && take_string(body, out.nickname) && take_string(body, out.text);
+        break;
+    case frame_type::interest_add:
+    case frame_type::interest_remove:
+        ok = take_varint(body, room);
+        break;
+    case frame_type::presence_online:
+    case frame_type::presence_offline:
+        ok = take_string(body, out.user_id) && !out.user_id.empty();
+        break;
+    case frame_type::presence_digest:
+        ok = take_varint(body, out.count) && take_varint(body, out.digest);
+        break;
+    case frame_type::presence_reset:
+    case frame_type::presence_resync:
+        ok = true;
+        break;
+    }
+
+    out.room_id = static_cast<std::int64_t>(room);
+    const bool needs_room = type == frame_type::message
+        || type == frame_type::interest_add || type == frame_type::interest_remove;
+    if(!ok || !body.empty() || (needs_room && out.room_id <= 0)){
+        return std::unexpected(error_code::from_decode(command_codec::decode_error::invalid_frame));
+    }
+    return *hdr_exp + body_len;
+}
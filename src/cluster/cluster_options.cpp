@@ -0,0 +1,16 @@
+#include "cluster/cluster_options.hpp"
+
+std::optional<host_port> host_port::parse(std::string_view sv){
+    const std::size_t colon = sv.rfind(':');
+    if(colon == std::string_view::npos || colon == 0 || colon + 1 == sv.size()) return std::nullopt;
+
+    host_port out{std::string(sv.substr(0, colon)), std::string(sv.substr(colon + 1))};
+    for(char ch : out.port){
+        if(ch < '0' || ch > '9') return std::nullopt;
+    }
+    return out;
+}
+
+std::string host_port::to_string() const{
+    return host + ":" + port;
+}
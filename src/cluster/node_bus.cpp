@@ -0,0 +1,525 @@
+#include "cluster/node_bus.hpp"
+#include "core/logger.hpp"
+#include "net/addr.hpp"
+#include "reactor/epoll_registry.hpp"
+#include "reactor/epoll_utility.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+namespace{
+    constexpr std::size_t READ_SIZE = 16 * 1024;
+
+    void set_nodelay(int fd){
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    std::expected<void, error_code> socket_error(int fd){
+        int ec = 0;
+        socklen_t len = sizeof(ec);
+        if(::getsockopt(fd, SOL_SOCKET, SO_ERROR, &ec, &len) == -1) ec = errno;
+        if(ec != 0) return std::unexpected(error_code::from_errno(ec));
+        return {};
+    }
+}
+
+std::expected<epoll_listener, error_code> node_bus::listen(const cluster_options& opts){
+    addr_option opt{};
+    opt.flags = AI_PASSIVE;
+    auto addr_exp = get_addr_client(opts.bus_listen.host, opts.bus_listen.port, opt);
+    if(!addr_exp){
+        logger::log_error("get_addr_client failed", "node_bus::listen()", addr_exp);
+        return std::unexpected(addr_exp.error());
+    }
+    return epoll_listener::create(addr_exp->get());
+}
+
+node_bus::node_bus(epoll_listener listener, epoll_registry& reg, cluster_options opts) :
+    listener(std::move(listener)), reg(reg), opts(std::move(opts)){
+    // Every node can share one peer list; its own address is skipped.
+    for(const host_port& peer : this->opts.bus_peers){
+        if(peer == this->opts.bus_listen) continue;
+        if(std::find(peers.begin(), peers.end(), peer) != peers.end()) continue;
+        peers.push_back(peer);
+    }
+    peer_fds.assign(peers.size(), -1);
+    retry_at.assign(peers.size(), clock::time_point::min());
+    dial_warned.assign(peers.size(), false);
+}
+
+bool node_bus::queue_idle() const{
+    return msg_q.empty() && interest_q.empty() && presence_q.empty();
+}
+
+void node_bus::publish(std::int64_t room_id, std::string_view nickname, std::string_view text){
+    bool was_idle = false;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        was_idle = queue_idle();
+        msg_q.push_back(pending_message{room_id, std::string(nickname), std::string(text)});
+    }
+    if(was_idle) listener.request_wakeup();
+}
+
+void node_bus::set_room_interest(std::int64_t room_id, bool has_members){
+    bool was_idle = false;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        was_idle = queue_idle();
+        interest_q.emplace_back(room_id, has_members);
+    }
+    if(was_idle) listener.request_wakeup();
+}
+
+void node_bus::set_user_presence(std::string_view user_id, bool online){
+    bool was_idle = false;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        was_idle = queue_idle();
+        presence_q.emplace_back(std::string(user_id), online);
+    }
+    if(was_idle) listener.request_wakeup();
+}
+
+bool node_bus::remote_online(std::string_view user_id) const{
+    return remote_presence.online(user_id);
+}
+
+std::size_t node_bus::dropped_count() const noexcept{
+    return dropped.load(std::memory_order_relaxed);
+}
+
+void node_bus::drain_requests(){
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::swap(msg_q, msg_batch);
+        std::swap(interest_q, interest_batch);
+        std::swap(presence_q, presence_batch);
+    }
+
+    const clock::time_point now = clock::now();
+    std::vector<int> broken;
+
+    // Interest first, so a room that just got a member is announced before
+    // any reply traffic it triggers.
+    for(const auto& [room_id, has_members] : interest_batch){
+        const bool changed = has_members ? local_rooms.insert(room_id).second : local_rooms.erase(room_id) == 1;
+        if(!changed) continue;
+
+        frame_buf.clear();
+        bus_frame::append_interest(
+            frame_buf,
+            has_members ? bus_frame::frame_type::interest_add : bus_frame::frame_type::interest_remove,
+            room_id
+        );
+        for(auto& [fd, l] : links){
+            if(l.outbound) continue;
+            if(!queue(l, frame_buf, now)) broken.push_back(fd);
+        }
+    }
+    interest_batch.clear();
+
+    // A lost presence frame is repaired by the next digest, so a full link just skips it.
+    for(auto& [user_id, online] : presence_batch){
+        if(online){
+            if(!local_users.insert(user_id).second) continue;
+            local_digest.add(user_id);
+        } else {
+            if(local_users.erase(user_id) == 0) continue;
+            local_digest.remove(user_id);
+        }
+
+        frame_buf.clear();
+        bus_frame::append_presence(
+            frame_buf,
+            online ? bus_frame::frame_type::presence_online : bus_frame::frame_type::presence_offline,
+            user_id
+        );
+        for(auto& [fd, l] : links){
+            if(l.outbound) queue(l, frame_buf, now);
+        }
+    }
+    presence_batch.clear();
+
+    for(const pending_message& msg : msg_batch){
+        frame_buf.clear();
+        for(auto& [fd, l] : links){
+            if(!l.outbound || !l.interest.contains(msg.room_id)) continue;
+            if(frame_buf.empty()) bus_frame::append_message(frame_buf, msg.room_id, msg.nickname, msg.text);
+            if(!queue(l, frame_buf, now)) dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    msg_batch.clear();
+
+    // A peer that cannot keep up with interest updates reconnects and gets a fresh snapshot.
+    for(int fd : broken){
+        close_link(fd, error_code::from_errno(ENOBUFS));
+    }
+}
+
+bool node_bus::queue(link& l, std::string_view bytes, clock::time_point now){
+    if(l.connecting || l.send.remaining() + bytes.size() > MAX_PENDING) return false;
+
+    l.send.append(bytes);
+    const clock::time_point due = l.send.remaining() >= opts.bus_flush_bytes ? now : now + opts.bus_flush_delay;
+    l.flush_at = std::min(l.flush_at, due);
+    return true;
+}
+
+void node_bus::on_connected(link& l, clock::time_point now){
+    dial_warned[l.peer] = false;
+    logger::log_info("node bus connected to " + peers[l.peer].to_string());
+    send_presence_snapshot(l, now);
+}
+
+void node_bus::send_presence_snapshot(link& l, clock::time_point now){
+    frame_buf.clear();
+    bus_frame::append_control(frame_buf, bus_frame::frame_type::presence_reset);
+    for(const std::string& user_id : local_users){
+        bus_frame::append_presence(frame_buf, bus_frame::frame_type::presence_online, user_id);
+    }
+    queue(l, frame_buf, now);
+}
+
+void node_bus::send_digests(clock::time_point now){
+    next_digest_at = now + opts.presence_digest_interval;
+
+    frame_buf.clear();
+    bus_frame::append_digest(frame_buf, local_digest.count, local_digest.hash);
+    for(auto& [fd, l] : links){
+        if(l.outbound) queue(l, frame_buf, now);
+    }
+}
+
+void node_bus::drop_link_users(link& l){
+    for(const std::string& user_id : l.users){
+        remote_presence.remove(user_id);
+    }
+    l.users.clear();
+    l.users_digest = {};
+}
+
+std::expected<void, error_code> node_bus::flush(link& l){
+    l.flush_at = clock::time_point::max();
+    while(l.send.has_pending()){
+        ssize_t n = ::send(l.fd.get(), l.send.current_data(), l.send.remaining(), MSG_NOSIGNAL);
+        if(n >= 0){
+            l.send.advance(static_cast<std::size_t>(n));
+            continue;
+        }
+
+        int ec = errno;
+        if(ec == EINTR) continue;
+        if(ec == EAGAIN || ec == EWOULDBLOCK){
+            l.send.compact_if_needed();
+            set_want_write(l, true);
+            return {};
+        }
+        return std::unexpected(error_code::from_errno(ec));
+    }
+
+    l.send.clear_if_done();
+    set_want_write(l, false);
+    return {};
+}
+
+void node_bus::set_want_write(link& l, bool want){
+    if(l.want_write == want) return;
+    l.want_write = want;
+
+    const uint32_t interest = EPOLLIN | EPOLLRDHUP | ((want || l.connecting) ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    auto mod_exp = epoll_utility::modify_fd(listener.get_epfd(), l.fd.get(), interest);
+    if(!mod_exp) logger::log_warn("modify_fd failed", "node_bus::set_want_write()", mod_exp);
+}
+
+void node_bus::dial(std::size_t peer, clock::time_point now){
+    retry_at[peer] = now + opts.bus_reconnect;
+
+    auto addr_exp = get_addr_client(peers[peer].host, peers[peer].port);
+    if(!addr_exp){
+        if(!dial_warned[peer]) logger::log_warn("resolve failed for " + peers[peer].to_string(), "node_bus::dial()", addr_exp);
+        dial_warned[peer] = true;
+        return;
+    }
+
+    int ec = EINVAL;
+    for(addrinfo* p = addr_exp->get(); p; p = p->ai_next){
+        unique_fd fd(::socket(p->ai_family, p->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, p->ai_protocol));
+        if(!fd){ ec = errno; continue; }
+
+        bool connecting = false;
+        if(::connect(fd.get(), p->ai_addr, p->ai_addrlen) == -1){
+            ec = errno;
+            if(ec != EINPROGRESS) continue;
+            connecting = true;
+        }
+
+        set_nodelay(fd.get());
+        const uint32_t interest = EPOLLIN | EPOLLRDHUP | (connecting ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+        auto add_exp = epoll_utility::add_fd(listener.get_epfd(), fd.get(), interest);
+        if(!add_exp){
+            logger::log_warn("add_fd failed", "node_bus::dial()", add_exp);
+            return;
+        }
+
+        const int raw = fd.get();
+        link& l = links[raw];
+        l.fd = std::move(fd);
+        l.outbound = true;
+        l.connecting = connecting;
+        l.peer = peer;
+        peer_fds[peer] = raw;
+        if(!connecting) on_connected(l, now);
+        return;
+    }
+
+    if(!dial_warned[peer]){
+        logger::log_warn("connect failed for " + peers[peer].to_string(), "node_bus::dial()", error_code::from_errno(ec));
+    }
+    dial_warned[peer] = true;
+}
+
+void node_bus::accept_links(){
+    const clock::time_point now = clock::now();
+    while(true){
+        int raw = ::accept4(listener.get_fd(), nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(raw == -1){
+            int ec = errno;
+            if(ec == EINTR) continue;
+            if(ec != EAGAIN && ec != EWOULDBLOCK){
+                logger::log_warn("accept failed", "node_bus::accept_links()", error_code::from_errno(ec));
+            }
+            return;
+        }
+
+        unique_fd fd(raw);
+        set_nodelay(raw);
+        auto add_exp = epoll_utility::add_fd(listener.get_epfd(), raw, EPOLLIN | EPOLLRDHUP);
+        if(!add_exp){
+            logger::log_warn("add_fd failed", "node_bus::accept_links()", add_exp);
+            continue;
+        }
+
+        link& l = links[raw];
+        l.fd = std::move(fd);
+
+        // The dialing peer only forwards rooms it has heard about, so start with the full set.
+        frame_buf.clear();
+        for(std::int64_t room_id : local_rooms){
+            bus_frame::append_interest(frame_buf, bus_frame::frame_type::interest_add, room_id);
+        }
+        if(!frame_buf.empty()) queue(l, frame_buf, now);
+        l.flush_at = now;
+    }
+}
+
+std::expected<void, error_code> node_bus::read_link(link& l){
+    std::span<char> dst = l.recv.prepare(READ_SIZE);
+    ssize_t n = ::recv(l.fd.get(), dst.data(), dst.size(), 0);
+    if(n == 0) return std::unexpected(error_code::from_errno(ECONNRESET));
+    if(n < 0){
+        int ec = errno;
+        if(ec == EINTR || ec == EAGAIN || ec == EWOULDBLOCK) return {};
+        return std::unexpected(error_code::from_errno(ec));
+    }
+    l.recv.commit(static_cast<std::size_t>(n));
+
+    while(l.recv.has_pending()){
+        bus_frame::frame f;
+        auto n_exp = bus_frame::decode(std::string_view(l.recv.current_data(), l.recv.remaining()), f);
+        if(!n_exp) return std::unexpected(n_exp.error());
+        if(*n_exp == 0) break;
+
+        auto frame_exp = handle_frame(l, f);
+        if(!frame_exp) return frame_exp;
+        l.recv.advance(*n_exp);
+    }
+
+    if(!l.recv.clear_if_done()) l.recv.compact_if_needed();
+    return {};
+}
+
+std::expected<void, error_code> node_bus::handle_frame(link& l, const bus_frame::frame& f){
+    using bus_frame::frame_type;
+
+    // Messages and presence only flow from the dialing side, interest and
+    // resync requests only from the accepting side.
+    if(l.outbound){
+        switch(f.type){
+        case frame_type::interest_add:
+            l.interest.insert(f.room_id);
+            return {};
+        case frame_type::interest_remove:
+            l.interest.erase(f.room_id);
+            return {};
+        case frame_type::presence_resync:
+            send_presence_snapshot(l, clock::now());
+            return {};
+        default:
+            break;
+        }
+        return std::unexpected(error_code::from_decode(command_codec::decode_error::invalid_frame));
+    }
+
+    switch(f.type){
+    case frame_type::message:
+        reg.request_room_relay(f.room_id, std::string(f.nickname), command_codec::cmd_response{std::string(f.text)});
+        return {};
+    case frame_type::presence_online:
+        if(l.users.emplace(f.user_id).second){
+            l.users_digest.add(f.user_id);
+            remote_presence.add(f.user_id);
+        }
+        return {};
+    case frame_type::presence_offline:
+        if(auto it = l.users.find(std::string(f.user_id)); it != l.users.end()){
+            l.users_digest.remove(f.user_id);
+            remote_presence.remove(f.user_id);
+            l.users.erase(it);
+        }
+        return {};
+    case frame_type::presence_reset:
+        drop_link_users(l);
+        l.resync_pending = false;
+        return {};
+    case frame_type::presence_digest:{
+        const presence_digest theirs{f.count, f.digest};
+        if(theirs == l.users_digest || l.resync_pending) return {};
+
+        frame_buf.clear();
+        bus_frame::append_control(frame_buf, frame_type::presence_resync);
+        l.resync_pending = queue(l, frame_buf, clock::now());
+        return {};
+    }
+    default:
+        break;
+    }
+    return std::unexpected(error_code::from_decode(command_codec::decode_error::invalid_frame));
+}
+
+void node_bus::handle_event(int fd, uint32_t event){
+    auto it = links.find(fd);
+    if(it == links.end()) return;
+    link& l = it->second;
+
+    if(l.connecting){
+        if((event & (EPOLLOUT | EPOLLERR | EPOLLHUP)) == 0) return;
+
+        auto connect_exp = socket_error(fd);
+        if(!connect_exp){
+            close_link(fd, connect_exp.error());
+            return;
+        }
+
+        l.connecting = false;
+        l.want_write = true;
+        set_want_write(l, false);
+        on_connected(l, clock::now());
+    }
+
+    if(event & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)){
+        auto read_exp = read_link(l);
+        if(!read_exp){
+            close_link(fd, read_exp.error());
+            return;
+        }
+    }
+
+    if((event & EPOLLOUT) && l.want_write){
+        auto flush_exp = flush(l);
+        if(!flush_exp) close_link(fd, flush_exp.error());
+    }
+}
+
+void node_bus::close_link(int fd, const error_code& ec){
+    auto it = links.find(fd);
+    if(it == links.end()) return;
+
+    if(it->second.outbound){
+        const std::size_t peer = it->second.peer;
+        // A peer that is still down is only reported once.
+        if(!it->second.connecting || !dial_warned[peer]){
+            logger::log_warn("node bus link to " + peers[peer].to_string() + " closed", "node_bus::close_link()", ec);
+        }
+        if(it->second.connecting) dial_warned[peer] = true;
+        peer_fds[peer] = -1;
+        retry_at[peer] = clock::now() + opts.bus_reconnect;
+    } else {
+        logger::log_warn("inbound node bus link closed", "node_bus::close_link()", ec);
+        drop_link_users(it->second);
+    }
+
+    auto del_exp = epoll_utility::del_fd(listener.get_epfd(), fd);
+    links.erase(it);
+}
+
+int node_bus::next_timeout_ms(clock::time_point now) const{
+    clock::time_point next = clock::time_point::max();
+    for(const auto& [fd, l] : links){
+        if(!l.want_write) next = std::min(next, l.flush_at);
+    }
+    for(std::size_t i = 0; i < peers.size(); ++i){
+        if(peer_fds[i] == -1) next = std::min(next, retry_at[i]);
+    }
+    if(!peers.empty()) next = std::min(next, next_digest_at);
+
+    if(next == clock::time_point::max()) return -1;
+    if(next <= now) return 0;
+    // Round up so a 1 ms flush delay does not spin on a 0 ms wait.
+    auto left = std::chrono::ceil<std::chrono::milliseconds>(next - now);
+    return static_cast<int>(std::min<std::int64_t>(left.count(), 60 * 1000));
+}
+
+std::expected<void, error_code> node_bus::run(const std::stop_token& st){
+    std::stop_callback on_stop(st, [this](){ listener.request_wakeup(); });
+    logger::log_info(
+        "node bus listening on " + opts.bus_listen.to_string() + " with " + std::to_string(peers.size()) + " peers"
+    );
+
+    std::vector<std::pair<int, error_code>> broken;
+    while(!st.stop_requested()){
+        clock::time_point now = clock::now();
+        for(std::size_t i = 0; i < peers.size(); ++i){
+            if(peer_fds[i] == -1 && retry_at[i] <= now) dial(i, now);
+        }
+
+        int event_sz = ::epoll_wait(listener.get_epfd(), events.data(), events.size(), next_timeout_ms(now));
+        if(event_sz == -1){
+            int ec = errno;
+            if(ec == EINTR) continue;
+            return std::unexpected(error_code::from_errno(ec));
+        }
+
+        for(int i = 0; i < event_sz; ++i){
+            int fd = events[i].data.fd;
+            if(fd == listener.get_wake_fd()){
+                listener.consume_wakeup();
+                drain_requests();
+            } else if(fd == listener.get_fd()){
+                accept_links();
+            } else {
+                handle_event(fd, events[i].events);
+            }
+        }
+
+        now = clock::now();
+        if(!peers.empty() && next_digest_at <= now) send_digests(now);
+        for(auto& [fd, l] : links){
+            if(l.want_write || l.flush_at > now) continue;
+            auto flush_exp = flush(l);
+            if(!flush_exp) broken.emplace_back(fd, flush_exp.error());
+        }
+        for(const auto& [fd, ec] : broken){
+            close_link(fd, ec);
+        }
+        broken.clear();
+    }
+
+    if(dropped_count() > 0){
+        logger::log_info("node bus dropped " + std::to_string(dropped_count()) + " messages");
+    }
+    return {};
+}
@@ -0,0 +1,47 @@
+#include "cluster/presence_directory.hpp"
+
+namespace{
+    // FNV-1a, so every build of the server agrees on the digest.
+    std::uint64_t user_hash(std::string_view user_id) noexcept{
+        std::uint64_t h = 14695981039346656037ull;
+        for(char ch : user_id){
+            h ^= static_cast<unsigned char>(ch);
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+}
+
+void presence_digest::add(std::string_view user_id) noexcept{
+    ++count;
+    hash ^= user_hash(user_id);
+}
+
+void presence_digest::remove(std::string_view user_id) noexcept{
+    --count;
+    hash ^= user_hash(user_id);
+}
+
+void presence_directory::add(std::string_view user_id){
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = nodes_by_user.find(user_id);
+    if(it == nodes_by_user.end()) it = nodes_by_user.emplace(std::string(user_id), 0).first;
+    ++it->second;
+}
+
+void presence_directory::remove(std::string_view user_id){
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = nodes_by_user.find(user_id);
+    if(it == nodes_by_user.end()) return;
+    if(--it->second == 0) nodes_by_user.erase(it);
+}
+
+bool presence_directory::online(std::string_view user_id) const{
+    std::lock_guard<std::mutex> lock(mtx);
+    return nodes_by_user.contains(user_id);
+}
+
+std::size_t presence_directory::size() const{
+    std::lock_guard<std::mutex> lock(mtx);
+    return nodes_by_user.size();
+}
@@ -0,0 +1,94 @@
+#include "core/buffer_pool.hpp"
+#include <new>
+#include <sys/mman.h>
+
+namespace{
+    thread_local buffer_pool* current = nullptr;
+}
+
+buffer_pool& buffer_pool::local(){
+    if(current == nullptr) current = new buffer_pool();
+    return *current;
+}
+
+buffer_pool::header* buffer_pool::take(std::size_t cls){
+    size_class_state& st = classes[cls];
+    if(st.free == nullptr){
+        st.free = st.remote.exchange(nullptr, std::memory_order_acquire);
+        for(header* h = st.free; h != nullptr; h = h->next) --st.in_use;
+    }
+    if(st.free != nullptr){
+        header* h = st.free;
+        st.free = h->next;
+        return h;
+    }
+
+    const std::size_t chunk = CLASS_SIZES[cls];
+    if(st.bump == st.bump_end){
+        void* slab = ::mmap(nullptr, SLAB_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(slab == MAP_FAILED) throw std::bad_alloc();
+        slabs.push_back(slab);
+        st.bump = static_cast<char*>(slab);
+        st.bump_end = st.bump + SLAB_SIZE / chunk * chunk;
+    }
+
+    header* h = reinterpret_cast<header*>(st.bump);
+    st.bump += chunk;
+    h->owner = this;
+    h->size_class = static_cast<std::uint32_t>(cls);
+    h->capacity = static_cast<std::uint32_t>(chunk - sizeof(header));
+    return h;
+}
+
+buffer_pool::block buffer_pool::allocate(std::size_t min_size){
+    for(std::size_t cls = 0; cls < CLASS_SIZES.size(); ++cls){
+        if(CLASS_SIZES[cls] - sizeof(header) < min_size) continue;
+
+        header* h = take(cls);
+        ++classes[cls].in_use;
+        return block{reinterpret_cast<char*>(h + 1), h->capacity};
+    }
+
+    header* h = static_cast<header*>(::operator new(sizeof(header) + min_size, std::align_val_t{alignof(header)}));
+    h->owner = this;
+    h->size_class = LARGE_CLASS;
+    h->capacity = static_cast<std::uint32_t>(min_size);
+    large_in_use.fetch_add(1, std::memory_order_relaxed);
+    return block{reinterpret_cast<char*>(h + 1), min_size};
+}
+
+void buffer_pool::give_back(header* h) noexcept{
+    size_class_state& st = classes[h->size_class];
+    --st.in_use;
+    h->next = st.free;
+    st.free = h;
+}
+
+void buffer_pool::release(char* data) noexcept{
+    if(data == nullptr) return;
+
+    header* h = reinterpret_cast<header*>(data) - 1;
+    if(h->size_class == LARGE_CLASS){
+        h->owner->large_in_use.fetch_sub(1, std::memory_order_relaxed);
+        ::operator delete(h, std::align_val_t{alignof(header)});
+        return;
+    }
+
+    if(h->owner == current){
+        h->owner->give_back(h);
+        return;
+    }
+
+    // The owner adjusts in_use when it drains this list.
+    std::atomic<header*>& remote = h->owner->classes[h->size_class].remote;
+    h->next = remote.load(std::memory_order_relaxed);
+    while(!remote.compare_exchange_weak(h->next, h, std::memory_order_release, std::memory_order_relaxed)){}
+}
+
+buffer_pool::stats buffer_pool::get_stats() const noexcept{
+    stats out;
+    out.slab_bytes = slabs.size() * SLAB_SIZE;
+    for(std::size_t cls = 0; cls < CLASS_SIZES.size(); ++cls) out.in_use[cls] = classes[cls].in_use;
+    out.large_in_use = large_in_use.load(std::memory_order_relaxed);
+    return out;
+}
@@ -1,5 +1,6 @@
 #include "core/config_loader.hpp"
 #include <cctype>
+#include <charconv>
 #include <fstream>
 
 std::string config_loader::config_strerror(int code){
@@ -16,6 +17,8 @@ std::string config_loader::config_strerror(int code){
             return "config read failed";
         case config_error::missing_required_key:
             return "config missing required key";
+        case config_error::invalid_value:
+            return "config invalid value";
     }
     return "unknown config error";
 }
@@ -104,6 +107,21 @@ std::string config_loader::get_or(
     return it->second;
 }
 
+std::expected <std::size_t, error_code> config_loader::get_size_or(
+    const config_map& cfg, std::string_view key, std::size_t fallback
+){
+    auto it = cfg.find(std::string(key));
+    if(it == cfg.end()) return fallback;
+
+    const std::string& value = it->second;
+    std::size_t out = 0;
+    auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), out);
+    if(ec != std::errc{} || ptr != value.data() + value.size() || value.empty()){
+        return std::unexpected(error_code::from_config(config_error::invalid_value));
+    }
+    return out;
+}
+
 std::expected <void, error_code> config_loader::check_server_require(
     const config_loader::config_map& cfg, const config_loader::config_map& env
 ){
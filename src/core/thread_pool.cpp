@@ -12,7 +12,11 @@ thread_pool::thread_pool(std::size_t sz){
 }
 
 bool thread_pool::is_pool_command(const command_codec::command& cmd) noexcept{
-    return false;
+    return command_codec::descriptor_of(cmd).route == command_codec::command_route::pool;
+}
+
+bool thread_pool::is_pool_command(const command_codec::command_view& cmd) noexcept{
+    return command_codec::descriptor_of(cmd).route == command_codec::command_route::pool;
 }
 
 void thread_pool::stop(){
@@ -29,18 +33,18 @@ void thread_pool::stop(){
     workers.clear();
 }
     
-bool thread_pool::enqueue(command_codec::command cmd, epoll_registry& reg, int fd){
+bool thread_pool::enqueue(command_codec::command cmd, epoll_registry& reg, conn_handle conn){
     {
         std::lock_guard<std::mutex> lock(mtx);
         if(!run) return false;
-        tasks.emplace(task{std::move(cmd), reg, fd});
+        tasks.emplace(task{std::move(cmd), reg, conn});
     }
     cv.notify_one();
     return true;
 }
 
 bool thread_pool::enqueue(command_codec::command cmd, epoll_registry& reg, socket_info& si){
-    return enqueue(std::move(cmd), reg, si.ufd.get());
+    return enqueue(std::move(cmd), reg, si.handle);
 }
 
 void thread_pool::worker_loop(std::stop_token st){
@@ -63,15 +67,15 @@ void thread_pool::worker_loop(std::stop_token st){
 }
 
 void thread_pool::execute(const task& t){
-    auto& [cmd, reg, fd] = t;
+    auto& [cmd, reg, conn] = t;
     std::visit([&](const auto& c){
         using T = std::decay_t<decltype(c)>;
         if constexpr (std::is_same_v<T, command_codec::cmd_say>){
-            reg.request_broadcast(fd, command_codec::cmd_response{c.text});
+            reg.request_broadcast(conn, command_codec::cmd_response{c.text});
         }
 
         if constexpr (std::is_same_v<T, command_codec::cmd_nick>){
-            reg.request_change_nickname(fd, c.nick);
+            reg.request_change_nickname(conn, c.nick);
         }
 
         if constexpr (std::is_same_v<T, command_codec::cmd_response>){
@@ -5,9 +5,24 @@
 #include <type_traits>
 #include <vector>
 
+namespace{
+void push_message(response_block& block, std::string_view prefix, const db_service::message_info& msg){
+    block.push({
+        prefix, "id=", std::to_string(msg.id), " at=", msg.created_at,
+        " from=", msg.sender_user_id, " text=", msg.body
+    });
+}
+}
+
 db_executor::~db_executor(){ stop(); }
 
-db_executor::db_executor(db_service& db, std::size_t sz) : db(db){
+db_executor::db_executor(
+    db_service& db, std::size_t sz, catchup_limits catchup, unread_flush_limits unread_flush,
+    message_partition_options partitions, const search_options& search
+) : db(db), catchup(catchup), unread_flush(unread_flush),
+    unread_flushed_at(clock::now().time_since_epoch().count()), partitions(partitions),
+    partitions_checked_at(clock::now().time_since_epoch().count()), search_sync(search.sync_interval),
+    search_synced_at(clock::now().time_since_epoch().count()){
     if(sz == 0) sz = 1;
     workers.reserve(sz);
     for(std::size_t i = 0; i < sz; ++i){
@@ -16,22 +31,11 @@ db_executor::db_executor(db_service& db, std::size_t sz) : db(db){
 }
 
 bool db_executor::is_db_command(const command_codec::command& cmd) noexcept{
-    return std::holds_alternative<command_codec::cmd_login>(cmd)
-        || std::holds_alternative<command_codec::cmd_register>(cmd)
-        || std::holds_alternative<command_codec::cmd_say>(cmd)
-        || std::holds_alternative<command_codec::cmd_nick>(cmd)
-        || std::holds_alternative<command_codec::cmd_friend_request>(cmd)
-        || std::holds_alternative<command_codec::cmd_friend_accept>(cmd)
-        || std::holds_alternative<command_codec::cmd_friend_reject>(cmd)
-        || std::holds_alternative<command_codec::cmd_friend_remove>(cmd)
-        || std::holds_alternative<command_codec::cmd_list_friend>(cmd)
-        || std::holds_alternative<command_codec::cmd_list_friend_request>(cmd)
-        || std::holds_alternative<command_codec::cmd_create_room>(cmd)
-        || std::holds_alternative<command_codec::cmd_delete_room>(cmd)
-        || std::holds_alternative<command_codec::cmd_invite_room>(cmd)
-        || std::holds_alternative<command_codec::cmd_leave_room>(cmd)
-        || std::holds_alternative<command_codec::cmd_list_room>(cmd)
-        || std::holds_alternative<command_codec::cmd_history>(cmd);
+    return command_codec::descriptor_of(cmd).route == command_codec::command_route::db;
+}
+
+bool db_executor::is_db_command(const command_codec::command_view& cmd) noexcept{
+    return command_codec::descriptor_of(cmd).route == command_codec::command_route::db;
 }
 
 void db_executor::stop(){
@@ -46,15 +50,19 @@ void db_executor::stop(){
         if(w.joinable()) w.join();
     }
     workers.clear();
+    if(compactor.joinable()) compactor.join();
+
+    auto flush_exp = db.flush_unread();
+    if(!flush_exp) logger::log_error("unread flush failed", "db_executor::stop()", flush_exp);
 }
 
-bool db_executor::enqueue(command_codec::command cmd, epoll_registry& reg, int fd){
+bool db_executor::enqueue(command_codec::command cmd, epoll_registry& reg, conn_handle conn){
     if(!is_db_command(cmd)) return false;
 
     {
         std::lock_guard<std::mutex> lock(mtx);
         if(!run) return false;
-        tasks.emplace(task{std::move(cmd), reg, fd, ""});
+        tasks.emplace(task{std::move(cmd), reg, conn, ""});
     }
     cv.notify_one();
     return true;
@@ -66,7 +74,19 @@ bool db_executor::enqueue(command_codec::command cmd, epoll_registry& reg, socke
     {
         std::lock_guard<std::mutex> lock(mtx);
         if(!run) return false;
-        tasks.emplace(task{std::move(cmd), reg, si.ufd.get(), si.user_id});
+        tasks.emplace(task{std::move(cmd), reg, si.handle, std::string(si.user_id)});
+    }
+    cv.notify_one();
+    return true;
+}
+
+bool db_executor::enqueue_mark_read(std::string user_id){
+    if(catchup.per_room == 0) return false;
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if(!run) return false;
+        read_marks.push(std::move(user_id));
     }
     cv.notify_one();
     return true;
@@ -75,47 +95,154 @@ bool db_executor::enqueue(command_codec::command cmd, epoll_registry& reg, socke
 void db_executor::worker_loop(std::stop_token st){
     while(true){
         std::optional<task> task_opt;
+        std::optional<std::string> mark_opt;
         {
             std::unique_lock<std::mutex> lock(mtx);
-            cv.wait(lock, [&](){
-                return !run || st.stop_requested() || !tasks.empty();
+            cv.wait_for(lock, unread_flush.interval, [&](){
+                return !run || st.stop_requested() || !tasks.empty() || !read_marks.empty();
             });
 
-            if((!run || st.stop_requested()) && tasks.empty()) return;
-            task_opt.emplace(std::move(tasks.front()));
-            tasks.pop();
+            if((!run || st.stop_requested()) && tasks.empty() && read_marks.empty()) return;
+            if(!tasks.empty()){
+                task_opt.emplace(std::move(tasks.front()));
+                tasks.pop();
+            }
+            else if(!read_marks.empty()){
+                mark_opt.emplace(std::move(read_marks.front()));
+                read_marks.pop();
+            }
+        }
+
+        if(task_opt) execute(*task_opt);
+        else if(mark_opt) mark_read(*mark_opt);
+        flush_unread_if_due();
+        maintain_partitions_if_due();
+        sync_search_if_due();
+    }
+}
+
+void db_executor::flush_unread_if_due(){
+    const auto now = clock::now();
+    const std::size_t pending = db.pending_unread();
+    if(pending == 0){
+        // The interval counts from the first message of the next batch.
+        unread_flushed_at.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+        return;
+    }
+
+    const clock::time_point last{clock::duration{unread_flushed_at.load(std::memory_order_relaxed)}};
+    if(pending < unread_flush.max_messages && now - last < unread_flush.interval) return;
+
+    unread_flushed_at.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+    auto flush_exp = db.flush_unread();
+    if(!flush_exp) logger::log_error("unread flush failed", "db_executor::flush_unread_if_due()", flush_exp);
+}
+
+void db_executor::maintain_partitions_if_due(){
+    const auto now = clock::now();
+    clock::rep checked = partitions_checked_at.load(std::memory_order_relaxed);
+    if(now - clock::time_point{clock::duration{checked}} < partitions.interval) return;
+    // With several workers, only the one that moves the timestamp runs it.
+    if(!partitions_checked_at.compare_exchange_strong(
+        checked, now.time_since_epoch().count(), std::memory_order_relaxed
+    )) return;
+
+    auto report_exp = db.maintain_message_partitions(
+        partitions.partition_rows, partitions.partitions_ahead, partitions.retention_days
+    );
+    if(!report_exp){
+        logger::log_error("message partition maintenance failed", "db_executor::maintain_partitions_if_due()", report_exp);
+        return;
+    }
+    if(report_exp->created != 0 || report_exp->detached != 0){
+        logger::log_info(
+            "message partitions created " + std::to_string(report_exp->created)
+            + " / detached " + std::to_string(report_exp->detached)
+        );
+    }
+
+    // Detached partitions and deleted rooms leave dead text in the search log.
+    start_search_compaction();
+}
+
+void db_executor::start_search_compaction(){
+    if(compacting.exchange(true)) return;
+    if(compactor.joinable()) compactor.join();
+
+    compactor = std::jthread([this](){
+        auto compact_exp = db.compact_search_index();
+        if(!compact_exp){
+            logger::log_error("search index compaction failed", "db_executor::start_search_compaction()", compact_exp);
+        }
+        else if(*compact_exp != 0){
+            logger::log_info("search index compacted / reclaimed " + std::to_string(*compact_exp) + " bytes");
         }
+        compacting.store(false);
+    });
+}
+
+void db_executor::sync_search_if_due(){
+    const auto now = clock::now();
+    clock::rep synced = search_synced_at.load(std::memory_order_relaxed);
+    if(now - clock::time_point{clock::duration{synced}} < search_sync) return;
+    if(!search_synced_at.compare_exchange_strong(
+        synced, now.time_since_epoch().count(), std::memory_order_relaxed
+    )) return;
+
+    auto sync_exp = db.sync_search_index();
+    if(!sync_exp){
+        logger::log_error("search index sync failed", "db_executor::sync_search_if_due()", sync_exp);
+        return;
+    }
+    if(*sync_exp == 0) return;
+    logger::log_info("search index caught up " + std::to_string(*sync_exp) + " messages");
+}
+
+void db_executor::mark_read(const std::string& user_id){
+    auto mark_exp = db.mark_rooms_read(user_id);
+    if(!mark_exp) logger::log_error("mark rooms read failed", "db_executor::mark_read()", mark_exp);
+}
+
+void db_executor::send_unread(epoll_registry& reg, conn_handle conn, std::string_view user_id){
+    if(catchup.per_room == 0) return;
+
+    auto unread_exp = db.take_unread_messages(user_id, catchup.per_room, catchup.max_messages);
+    if(!unread_exp){
+        logger::log_error("unread query failed", "db_executor::send_unread()", unread_exp);
+        return;
+    }
+    if(unread_exp->empty()) return;
 
-        execute(*task_opt);
+    const auto& unread = *unread_exp;
+    response_block out;
+    for(std::size_t i = 0; i < unread.size();){
+        const std::int64_t room_id = unread[i].room_id;
+        std::size_t end = i;
+        while(end < unread.size() && unread[end].room_id == room_id) ++end;
+
+        out.push({"unread: room=", std::to_string(room_id), " count=", std::to_string(end - i)});
+        for(; i < end; ++i) push_message(out, "unread: ", unread[i]);
     }
+    reg.request_send_block(conn, std::move(out));
+
+    logger::log_info(std::string(user_id) + " caught up " + std::to_string(unread.size()) + " unread messages");
 }
 
 void db_executor::execute(const task& t){
-    auto& [cmd, reg, fd, user_id] = t;
-    std::visit([this, &reg, fd, &user_id](const auto& c){
-        using T = std::decay_t<decltype(c)>;
-        if constexpr (
-            std::is_same_v<T, command_codec::cmd_say>
-            || std::is_same_v<T, command_codec::cmd_nick>
-            || std::is_same_v<T, command_codec::cmd_friend_request>
-            || std::is_same_v<T, command_codec::cmd_friend_accept>
-            || std::is_same_v<T, command_codec::cmd_friend_reject>
-            || std::is_same_v<T, command_codec::cmd_friend_remove>
-            || std::is_same_v<T, command_codec::cmd_list_friend>
-            || std::is_same_v<T, command_codec::cmd_list_friend_request>
-            || std::is_same_v<T, command_codec::cmd_create_room>
-            || std::is_same_v<T, command_codec::cmd_delete_room>
-            || std::is_same_v<T, command_codec::cmd_invite_room>
-            || std::is_same_v<T, command_codec::cmd_leave_room>
-            || std::is_same_v<T, command_codec::cmd_list_room>
-            || std::is_same_v<T, command_codec::cmd_history>
-        ){
-            execute_command(c, reg, fd, user_id);
+    auto& [cmd, reg, conn, user_id] = t;
+    std::visit([this, &reg, conn, &user_id](const auto& c){
+        if constexpr (requires{ this->execute_command(c, reg, conn, user_id); }){
+            execute_command(c, reg, conn, user_id);
+        }
+        else if constexpr (requires{ this->execute_command(c, reg, conn); }){
+            execute_command(c, reg, conn);
         }
         else{
-            execute_command(c, reg, fd);
+            using T = std::decay_t<decltype(c)>;
+            static_assert(T::route != command_codec::command_route::db, "db command without handler");
         }
     }, cmd);
+    reg.request_db_done(conn);
 }
 
 std::expected<std::vector<std::int64_t>, error_code> db_executor::load_joined_room_ids(std::string_view user_id){
@@ -133,15 +260,15 @@ std::expected<std::vector<std::int64_t>, error_code> db_executor::load_joined_ro
 }
 
 void db_executor::execute_command(
-    const command_codec::cmd_login& cmd, epoll_registry& reg, int fd
+    const command_codec::cmd_login& cmd, epoll_registry& reg, conn_handle conn
 ){
     auto login_exp = db.login(cmd.id, cmd.pw);
     if(!login_exp){
         logger::log_error("login failed", "db_executor::execute_command()", login_exp.error());
-        reg.request_send(fd, command_codec::cmd_response{"login failed"});
-        reg.request_set_user_id(fd, "");
-        reg.request_set_joined_rooms(fd, {});
-        reg.request_change_nickname(fd, "guest");
+        reg.request_send(conn, command_codec::cmd_response{"login failed"});
+        reg.request_set_user_id(conn, "");
+        reg.request_set_joined_rooms(conn, {});
+        reg.request_change_nickname(conn, "guest");
         return;
     }
 
@@ -153,280 +280,282 @@ void db_executor::execute_command(
                 "db_executor::execute_command()",
                 joined_room_ids_exp.error()
             );
-            reg.request_send(fd, command_codec::cmd_response{"login failed"});
-            reg.request_set_user_id(fd, "");
-            reg.request_set_joined_rooms(fd, {});
-            reg.request_change_nickname(fd, "guest");
+            reg.request_send(conn, command_codec::cmd_response{"login failed"});
+            reg.request_set_user_id(conn, "");
+            reg.request_set_joined_rooms(conn, {});
+            reg.request_change_nickname(conn, "guest");
             return;
         }
 
-        reg.request_set_user_id(fd, cmd.id);
-        reg.request_set_joined_rooms(fd, std::move(*joined_room_ids_exp));
-        reg.request_change_nickname(fd, **login_exp);
-        reg.request_send(fd, command_codec::cmd_response{"login success"});
+        reg.request_set_user_id(conn, cmd.id);
+        reg.request_set_joined_rooms(conn, std::move(*joined_room_ids_exp));
+        if(reg.get_presence_options().push){
+            // Presence pushes go to this list, so a failure only costs the events.
+            auto friends_exp = db.list_friends(cmd.id);
+            if(friends_exp) reg.request_set_friends(std::string(cmd.id), std::move(*friends_exp));
+            else logger::log_error("load friends failed", "db_executor::execute_command()", friends_exp.error());
+        }
+        reg.request_change_nickname(conn, **login_exp);
+        reg.request_send(conn, command_codec::cmd_response{"login success"});
+        send_unread(reg, conn, cmd.id);
     }
     else{
-        reg.request_set_user_id(fd, "");
-        reg.request_set_joined_rooms(fd, {});
-        reg.request_change_nickname(fd, "guest");
-        reg.request_send(fd, command_codec::cmd_response{"login failed"});
+        reg.request_set_user_id(conn, "");
+        reg.request_set_joined_rooms(conn, {});
+        reg.request_change_nickname(conn, "guest");
+        reg.request_send(conn, command_codec::cmd_response{"login failed"});
     }
 }
 
 void db_executor::execute_command(
-    const command_codec::cmd_register& cmd, epoll_registry& reg, int fd
+    const command_codec::cmd_register& cmd, epoll_registry& reg, conn_handle conn
 ){
     auto signup_exp = db.signup(cmd.id, cmd.pw);
     if(!signup_exp){
         logger::log_error("register failed", "db_executor::execute_command", signup_exp.error());
-        reg.request_send(fd, command_codec::cmd_response{"register failed"});
+        reg.request_send(conn, command_codec::cmd_response{"register failed"});
         return;
         
     }
 
     reg.request_send(
-        fd, command_codec::cmd_response{*signup_exp ? "register success" : "id already exists"}
+        conn, command_codec::cmd_response{*signup_exp ? "register success" : "id already exists"}
     );
 }
 
 void db_executor::execute_command(
-    const command_codec::cmd_say& cmd, epoll_registry& reg, int fd, std::string_view user_id
+    const command_codec::cmd_say& cmd, epoll_registry& reg, conn_handle conn, std::string_view user_id
 ){
     if(user_id.empty()){
-        reg.request_send(fd, command_codec::cmd_response{"login first"});
+        reg.request_send(conn, command_codec::cmd_response{"login first"});
         return;
     }
 
-    std::int64_t room_id = 0;
-    try{
-        std::size_t pos = 0;
-        room_id = std::stoll(cmd.room_id, &pos);
-        if(pos != cmd.room_id.size() || room_id <= 0){
-            reg.request_send(fd, command_codec::cmd_response{"invalid room id"});
-            return;
-        }
-    } catch(...){
-        reg.request_send(fd, command_codec::cmd_response{"invalid room id"});
+    const auto room_id = command_codec::parse_positive(cmd.room_id);
+    if(!room_id){
+        reg.request_send(conn, command_codec::cmd_response{"invalid room id"});
         return;
     }
 
-    auto msg_exp = db.create_room_message(room_id, user_id, cmd.text);
+    auto msg_exp = db.create_room_message(*room_id, user_id, cmd.text);
     if(!msg_exp){
         logger::log_error("create room message failed", "db_executor::execute_command()", msg_exp.error());
-        reg.request_send(fd, command_codec::cmd_response{"send failed"});
+        reg.request_send(conn, command_codec::cmd_response{"send failed"});
         return;
     }
 
     if(!*msg_exp){
-        reg.request_send(fd, command_codec::cmd_response{"room not found or no permission"});
+        reg.request_send(conn, command_codec::cmd_response{"room not found or no permission"});
         return;
     }
 
-    reg.request_room_broadcast(fd, room_id, command_codec::cmd_response{cmd.text});
+    reg.request_room_broadcast(conn, *room_id, command_codec::cmd_response{cmd.text});
 }
 
 void db_executor::execute_command(
-    const command_codec::cmd_nick& cmd, epoll_registry& reg, int fd, std::string_view user_id
+    const command_codec::cmd_nick& cmd, epoll_registry& reg, conn_handle conn, std::string_view user_id
 ){
     if(user_id.empty()){
-        reg.request_send(fd, command_codec::cmd_response{"login first"});
+        reg.request_send(conn, command_codec::cmd_response{"login first"});
         return;
     }
 
     auto nick_exp = db.change_nickname(user_id, cmd.nick);
     if(!nick_exp){
         logger::log_error("change nickname failed", "db_executor::execute_command()", nick_exp.error());
-        reg.request_send(fd, command_codec::cmd_response{"nick change failed"});
+        reg.request_send(conn, command_codec::cmd_response{"nick change failed"});
         return;
     }
 
     if(!*nick_exp){
-        reg.request_send(fd, command_codec::cmd_response{"nick change failed"});
+        reg.request_send(conn, command_codec::cmd_response{"nick change failed"});
         return;
     }
 
-    reg.request_change_nickname(fd, cmd.nick);
-    reg.request_send(fd, command_codec::cmd_response{"nick change success"});
+    reg.request_change_nickname(conn, cmd.nick);
+    reg.request_send(conn, command_codec::cmd_response{"nick change success"});
 }
 
 void db_executor::execute_command(
-    const command_codec::cmd_response&, epoll_registry&, int
+    const command_codec::cmd_response&, epoll_registry&, conn_handle
 ){}
 
 void db_executor::execute_command(
     const command_codec::cmd_friend_request& cmd,
     epoll_registry& reg,
-    int fd,
+    conn_handle conn,
     std::string_view user_id
 ){
     if(user_id.empty()){
-        reg.request_send(fd, command_codec::cmd_response{"login first"});
+        reg.request_send(conn, command_codec::cmd_response{"login first"});
         return;
     }
 
     if(user_id == cmd.to_user_id){
-        reg.request_send(fd, command_codec::cmd_response{"cannot request yourself"});
+        reg.request_send(conn, command_codec::cmd_response{"cannot request yourself"});
         return;
     }
 
     auto request_exp = db.request_friend(user_id, cmd.to_user_id);
     if(!request_exp){
         logger::log_error("friend request failed", "db_executor::execute_command()", request_exp.error());
-        reg.request_send(fd, command_codec::cmd_response{"friend request failed"});
+        reg.request_send(conn, command_codec::cmd_response{"friend request failed"});
         return;
     }
 
     if(!*request_exp){
-        reg.request_send(fd, command_codec::cmd_response{"friend request already exists or already friends"});
+        reg.request_send(conn, command_codec::cmd_response{"friend request already exists or already friends"});
         return;
     }
 
-    reg.request_send(fd, command_codec::cmd_response{"friend request sent"});
+    reg.request_send(conn, command_codec::cmd_response{"friend request sent"});
     logger::log_info(std::string(user_id) + " sent friend request to " + std::string(cmd.to_user_id));
 }
 
 void db_executor::execute_command(
     const command_codec::cmd_friend_accept& cmd,
     epoll_registry& reg,
-    int fd,
+    conn_handle conn,
     std::string_view user_id
 ){
     if(user_id.empty()){
-        reg.request_send(fd, command_codec::cmd_response{"login first"});
+        reg.request_send(conn, command_codec::cmd_response{"login first"});
         return;
     }
 
     auto accept_exp = db.accept_friend_request(cmd.from_user_id, user_id);
     if(!accept_exp){
         logger::log_error("friend request accept failed", "db_executor::execute_command()", accept_exp.error());
-        reg.request_send(fd, command_codec::cmd_response{"friend request accept failed"});
+        reg.request_send(conn, command_codec::cmd_response{"friend request accept failed"});
         return;
     }
 
     if(!*accept_exp){
-        reg.request_send(fd, command_codec::cmd_response{"no pending friend request"});
+        reg.request_send(conn, command_codec::cmd_response{"no pending friend request"});
         return;
     }
 
-    reg.request_send(fd, command_codec::cmd_response{"friend request accepted"});
+    reg.request_friend_link(std::string(user_id), std::string(cmd.from_user_id), true);
+    reg.request_send(conn, command_codec::cmd_response{"friend request accepted"});
     logger::log_info(std::string(user_id) + " accepet friend request to " + std::string(cmd.from_user_id));
 }
 
 void db_executor::execute_command(
     const command_codec::cmd_friend_reject& cmd,
     epoll_registry& reg,
-    int fd,
+    conn_handle conn,
     std::string_view user_id
 ){
     if(user_id.empty()){
-        reg.request_send(fd, command_codec::cmd_response{"login first"});
+        reg.request_send(conn, command_codec::cmd_response{"login first"});
         return;
     }
 
     auto reject_exp = db.reject_friend_request(cmd.from_user_id, user_id);
     if(!reject_exp){
         logger::log_error("friend request reject failed", "db_executor::execute_command()", reject_exp.error());
-        reg.request_send(fd, command_codec::cmd_response{"friend request reject failed"});
+        reg.request_send(conn, command_codec::cmd_response{"friend request reject failed"});
         return;
     }
 
     if(!*reject_exp){
-        reg.request_send(fd, command_codec::cmd_response{"no pending friend request"});
+        reg.request_send(conn, command_codec::cmd_response{"no pending friend request"});
         return;
     }
 
-    reg.request_send(fd, command_codec::cmd_response{"friend request rejected"});
+    reg.request_send(conn, command_codec::cmd_response{"friend request rejected"});
     logger::log_info(std::string(user_id) + " reject friend request to " + std::string(cmd.from_user_id));
 }
 
 void db_executor::execute_command(
     const command_codec::cmd_friend_remove& cmd,
     epoll_registry& reg,
-    int fd,
+    conn_handle conn,
     std::string_view user_id
 ){
     if(user_id.empty()){
-        reg.request_send(fd, command_codec::cmd_response{"login first"});
+        reg.request_send(conn, command_codec::cmd_response{"login first"});
         return;
     }
 
     if(user_id == cmd.friend_user_id){
-        reg.request_send(fd, command_codec::cmd_response{"cannot remove yourself"});
+        reg.request_send(conn, command_codec::cmd_response{"cannot remove yourself"});
         return;
     }
 
     auto remove_exp = db.remove_friend(user_id, cmd.friend_user_id);
     if(!remove_exp){
         logger::log_error("friend remove failed", "db_executor::execute_command()", remove_exp.error());
-        reg.request_send(fd, command_codec::cmd_response{"friend remove failed"});
+        reg.request_send(conn, command_codec::cmd_response{"friend remove failed"});
         return;
     }
 
     if(!*remove_exp){
-        reg.request_send(fd, command_codec::cmd_response{"friend not found"});
+        reg.request_send(conn, command_codec::cmd_response{"friend not found"});
         return;
     }
 
-    reg.request_send(fd, command_codec::cmd_response{"friend removed"});
+    reg.request_friend_link(std::string(user_id), std::string(cmd.friend_user_id), false);
+    reg.request_send(conn, command_codec::cmd_response{"friend removed"});
     logger::log_info(std::string(user_id) + " removed friend " + std::string(cmd.friend_user_id));
 }
 
 void db_executor::execute_command(
     const command_codec::cmd_list_friend&,
     epoll_registry& reg,
-    int fd,
+    conn_handle conn,
     std::string_view user_id
 ){
     if(user_id.empty()){
-        reg.request_send(fd, command_codec::cmd_response{"login first"});
+        reg.request_send(conn, command_codec::cmd_response{"login first"});
         return;
     }
 
     auto list_exp = db.list_friends(user_id);
     if(!list_exp){
         logger::log_error("friend list failed", "db_executor::execute_command()", list_exp.error());
-        reg.request_send(fd, command_codec::cmd_response{"friend list failed"});
+        reg.request_send(conn, command_codec::cmd_response{"friend list failed"});
         return;
     }
 
     if(list_exp->empty()){
-        reg.request_send(fd, command_codec::cmd_response{"no friends"});
+        reg.request_send(conn, command_codec::cmd_response{"no friends"});
         return;
     }
 
-    reg.request_send_friend_list(fd, *list_exp);
+    reg.request_send_friend_list(conn, *list_exp);
     logger::log_info(std::string(user_id) + " request list_friend");
 }
 
 void db_executor::execute_command(
     const command_codec::cmd_list_friend_request&,
     epoll_registry& reg,
-    int fd,
+    conn_handle conn,
     std::string_view user_id
 ){
     if(user_id.empty()){
-        reg.request_send(fd, command_codec::cmd_response{"login first"});
+        reg.request_send(conn, command_codec::cmd_response{"login first"});
         return;
     }
 
     auto list_exp = db.list_friend_requests(user_id);
     if(!list_exp){
         logger::log_error("friend requests list failed", "db_executor::execute_command()", list_exp.error());
-        reg.request_send(fd, command_codec::cmd_response{"friend requests list failed"});
+        reg.request_send(conn, command_codec::cmd_response{"friend requests list failed"});
         return;
     }
 
     if(list_exp->empty()){
-        reg.request_send(fd, command_codec::cmd_response{"no pending friend requests"});
+        reg.request_send(conn, command_codec::cmd_response{"no pending friend requests"});
         return;
     }
 
     reg.request_send(
-        fd, command_codec::cmd_response{"pending friend requests: " + std::to_string(list_exp->size())}
+        conn, command_codec::cmd_response{"pending friend requests: " + std::to_string(list_exp->size())}
     );
 
     for(const std::string& from_user_id : *list_exp){
-        reg.request_send(fd, command_codec::cmd_response{"from: " + from_user_id});
+        reg.request_send(conn, command_codec::cmd_response{"from: " + from_user_id});
     }
 
     logger::log_info(std::string(user_id) + " request list_friend_request");
@@ -435,28 +564,28 @@ void db_executor::execute_command(
 void db_executor::execute_command(
     const command_codec::cmd_create_room& cmd,
     epoll_registry& reg,
-    int fd,
+    conn_handle conn,
     std::string_view user_id
 ){
     if(user_id.empty()){
-        reg.request_send(fd, command_codec::cmd_response{"login first"});
+        reg.request_send(conn, command_codec::cmd_response{"login first"});
         return;
     }
 
     if(cmd.room_name.empty()){
-        reg.request_send(fd, command_codec::cmd_response{"room name is empty"});
+        reg.request_send(conn, command_codec::cmd_response{"room name is empty"});
         return;
     }
 
     auto create_exp = db.create_room(user_id, cmd.room_name);
     if(!create_exp){
         logger::log_error("create room failed", "db_executor::execute_command()", create_exp.error());
-        reg.request_send(fd, command_codec::cmd_response{"create room failed"});
+        reg.request_send(conn, command_codec::cmd_response{"create room failed"});
         return;
     }
 
     reg.request_send(
-        fd,
+        conn,
         command_codec::cmd_response{
             "room created: " + std::to_string(*create_exp) + " (" + cmd.room_name + ")"
         }
@@ -470,7 +599,7 @@ void db_executor::execute_command(
         );
     }
     else{
-        reg.request_set_joined_rooms(fd, std::move(*joined_room_ids_exp));
+        reg.request_set_joined_rooms(conn, std::move(*joined_room_ids_exp));
     }
     logger::log_info(std::string(user_id) + " created room " + std::to_string(*create_exp));
 }
@@ -478,36 +607,29 @@ void db_executor::execute_command(
 void db_executor::execute_command(
     const command_codec::cmd_delete_room& cmd,
     epoll_registry& reg,
-    int fd,
+    conn_handle conn,
     std::string_view user_id
 ){
     if(user_id.empty()){
-        reg.request_send(fd, command_codec::cmd_response{"login first"});
+        reg.request_send(conn, command_codec::cmd_response{"login first"});
         return;
     }
 
-    std::int64_t room_id = 0;
-    try{
-        std::size_t pos = 0;
-        room_id = std::stoll(cmd.room_id, &pos);
-        if(pos != cmd.room_id.size() || room_id <= 0){
-            reg.request_send(fd, command_codec::cmd_response{"invalid room id"});
-            return;
-        }
-    } catch(...){
-        reg.request_send(fd, command_codec::cmd_response{"invalid room id"});
+    const auto room_id = command_codec::parse_positive(cmd.room_id);
+    if(!room_id){
+        reg.request_send(conn, command_codec::cmd_response{"invalid room id"});
         return;
     }
 
-    auto delete_exp = db.delete_room(user_id, room_id);
+    auto delete_exp = db.delete_room(user_id, *room_id);
     if(!delete_exp){
         logger::log_error("delete room failed", "db_executor::execute_command()", delete_exp.error());
-        reg.request_send(fd, command_codec::cmd_response{"delete room failed"});
+        reg.request_send(conn, command_codec::cmd_response{"delete room failed"});
         return;
     }
 
     if(!*delete_exp){
-        reg.request_send(fd, command_codec::cmd_response{"room not found or no permission"});
+        reg.request_send(conn, command_codec::cmd_response{"room not found or no permission"});
         return;
     }
 
@@ -520,45 +642,38 @@ void db_executor::execute_command(
         );
     }
     else{
-        reg.request_set_joined_rooms(fd, std::move(*joined_room_ids_exp));
+        reg.request_set_joined_rooms(conn, std::move(*joined_room_ids_exp));
     }
-    reg.request_send(fd, command_codec::cmd_response{"room deleted: " + std::to_string(room_id)});
-    logger::log_info(std::string(user_id) + " deleted room " + std::to_string(room_id));
+    reg.request_send(conn, command_codec::cmd_response{"room deleted: " + std::to_string(*room_id)});
+    logger::log_info(std::string(user_id) + " deleted room " + std::to_string(*room_id));
 }
 
 void db_executor::execute_command(
     const command_codec::cmd_invite_room& cmd,
     epoll_registry& reg,
-    int fd,
+    conn_handle conn,
     std::string_view user_id
 ){
     if(user_id.empty()){
-        reg.request_send(fd, command_codec::cmd_response{"login first"});
+        reg.request_send(conn, command_codec::cmd_response{"login first"});
         return;
     }
 
     if(user_id == cmd.friend_user_id){
-        reg.request_send(fd, command_codec::cmd_response{"cannot invite yourself"});
+        reg.request_send(conn, command_codec::cmd_response{"cannot invite yourself"});
         return;
     }
 
-    std::int64_t room_id = 0;
-    try{
-        std::size_t pos = 0;
-        room_id = std::stoll(cmd.room_id, &pos);
-        if(pos != cmd.room_id.size() || room_id <= 0){
-            reg.request_send(fd, command_codec::cmd_response{"invalid room id"});
-            return;
-        }
-    } catch(...){
-        reg.request_send(fd, command_codec::cmd_response{"invalid room id"});
+    const auto room_id = command_codec::parse_positive(cmd.room_id);
+    if(!room_id){
+        reg.request_send(conn, command_codec::cmd_response{"invalid room id"});
         return;
     }
 
-    auto invite_exp = db.invite_room(user_id, room_id, cmd.friend_user_id);
+    auto invite_exp = db.invite_room(user_id, *room_id, cmd.friend_user_id);
     if(!invite_exp){
         logger::log_error("invite room failed", "db_executor::execute_command()", invite_exp.error());
-        reg.request_send(fd, command_codec::cmd_response{"invite room failed"});
+        reg.request_send(conn, command_codec::cmd_response{"invite room failed"});
         return;
     }
 
@@ -591,25 +706,25 @@ void db_executor::execute_command(
                 }
             }
             reg.request_send(
-                fd,
+                conn,
                 command_codec::cmd_response{
-                    "room invite sent: room=" + std::to_string(room_id) + " user=" + cmd.friend_user_id
+                    "room invite sent: room=" + std::to_string(*room_id) + " user=" + cmd.friend_user_id
                 }
             );
             logger::log_info(
                 std::string(user_id)
                 + " invited " + cmd.friend_user_id
-                + " to room " + std::to_string(room_id)
+                + " to room " + std::to_string(*room_id)
             );
             return;
         case db_service::invite_room_result::already_member:
-            reg.request_send(fd, command_codec::cmd_response{"user already in room"});
+            reg.request_send(conn, command_codec::cmd_response{"user already in room"});
             return;
         case db_service::invite_room_result::not_friend:
-            reg.request_send(fd, command_codec::cmd_response{"can invite friends only"});
+            reg.request_send(conn, command_codec::cmd_response{"can invite friends only"});
             return;
         case db_service::invite_room_result::room_not_found_or_no_permission:
-            reg.request_send(fd, command_codec::cmd_response{"room not found or no permission"});
+            reg.request_send(conn, command_codec::cmd_response{"room not found or no permission"});
             return;
     }
 }
@@ -617,31 +732,24 @@ void db_executor::execute_command(
 void db_executor::execute_command(
     const command_codec::cmd_leave_room& cmd,
     epoll_registry& reg,
-    int fd,
+    conn_handle conn,
     std::string_view user_id
 ){
     if(user_id.empty()){
-        reg.request_send(fd, command_codec::cmd_response{"login first"});
+        reg.request_send(conn, command_codec::cmd_response{"login first"});
         return;
     }
 
-    std::int64_t room_id = 0;
-    try{
-        std::size_t pos = 0;
-        room_id = std::stoll(cmd.room_id, &pos);
-        if(pos != cmd.room_id.size() || room_id <= 0){
-            reg.request_send(fd, command_codec::cmd_response{"invalid room id"});
-            return;
-        }
-    } catch(...){
-        reg.request_send(fd, command_codec::cmd_response{"invalid room id"});
+    const auto room_id = command_codec::parse_positive(cmd.room_id);
+    if(!room_id){
+        reg.request_send(conn, command_codec::cmd_response{"invalid room id"});
         return;
     }
 
-    auto leave_exp = db.leave_room(user_id, room_id);
+    auto leave_exp = db.leave_room(user_id, *room_id);
     if(!leave_exp){
         logger::log_error("leave room failed", "db_executor::execute_command()", leave_exp.error());
-        reg.request_send(fd, command_codec::cmd_response{"leave room failed"});
+        reg.request_send(conn, command_codec::cmd_response{"leave room failed"});
         return;
     }
 
@@ -660,14 +768,14 @@ void db_executor::execute_command(
                     reg.request_set_joined_rooms_for_user(std::string(user_id), std::move(*joined_room_ids_exp));
                 }
             }
-            reg.request_send(fd, command_codec::cmd_response{"left room: " + std::to_string(room_id)});
-            logger::log_info(std::string(user_id) + " left room " + std::to_string(room_id));
+            reg.request_send(conn, command_codec::cmd_response{"left room: " + std::to_string(*room_id)});
+            logger::log_info(std::string(user_id) + " left room " + std::to_string(*room_id));
             return;
         case db_service::leave_room_result::not_member_or_room_not_found:
-            reg.request_send(fd, command_codec::cmd_response{"room not found or not joined"});
+            reg.request_send(conn, command_codec::cmd_response{"room not found or not joined"});
             return;
         case db_service::leave_room_result::owner_cannot_leave:
-            reg.request_send(fd, command_codec::cmd_response{"room owner cannot leave (delete room instead)"});
+            reg.request_send(conn, command_codec::cmd_response{"room owner cannot leave (delete room instead)"});
             return;
     }
 }
@@ -675,35 +783,36 @@ void db_executor::execute_command(
 void db_executor::execute_command(
     const command_codec::cmd_list_room&,
     epoll_registry& reg,
-    int fd,
+    conn_handle conn,
     std::string_view user_id
 ){
     if(user_id.empty()){
-        reg.request_send(fd, command_codec::cmd_response{"login first"});
+        reg.request_send(conn, command_codec::cmd_response{"login first"});
         return;
     }
 
     auto list_exp = db.list_rooms(user_id);
     if(!list_exp){
         logger::log_error("list room failed", "db_executor::execute_command()", list_exp.error());
-        reg.request_send(fd, command_codec::cmd_response{"list room failed"});
+        reg.request_send(conn, command_codec::cmd_response{"list room failed"});
         return;
     }
 
     if(list_exp->empty()){
-        reg.request_send(fd, command_codec::cmd_response{"no rooms"});
+        reg.request_send(conn, command_codec::cmd_response{"no rooms"});
         return;
     }
 
-    reg.request_send(fd, command_codec::cmd_response{"rooms: " + std::to_string(list_exp->size())});
+    reg.request_send(conn, command_codec::cmd_response{"rooms: " + std::to_string(list_exp->size())});
     for(const auto& room : *list_exp){
         reg.request_send(
-            fd,
+            conn,
             command_codec::cmd_response{
                 "room: id=" + std::to_string(room.id)
                 + " name=" + room.name
                 + " owner=" + room.owner_user_id
                 + " members=" + std::to_string(room.member_count)
+                + " unread=" + std::to_string(room.unread_count)
             }
         );
     }
@@ -713,75 +822,121 @@ void db_executor::execute_command(
 void db_executor::execute_command(
     const command_codec::cmd_history& cmd,
     epoll_registry& reg,
-    int fd,
+    conn_handle conn,
     std::string_view user_id
 ){
     if(user_id.empty()){
-        reg.request_send(fd, command_codec::cmd_response{"login first"});
+        reg.request_send(conn, command_codec::cmd_response{"login first"});
         return;
     }
 
-    std::int64_t room_id = 0;
-    try{
-        std::size_t pos = 0;
-        room_id = std::stoll(cmd.room_id, &pos);
-        if(pos != cmd.room_id.size() || room_id <= 0){
-            reg.request_send(fd, command_codec::cmd_response{"invalid room id"});
-            return;
-        }
-    } catch(...){
-        reg.request_send(fd, command_codec::cmd_response{"invalid room id"});
+    const auto room_id = command_codec::parse_positive(cmd.room_id);
+    if(!room_id){
+        reg.request_send(conn, command_codec::cmd_response{"invalid room id"});
         return;
     }
 
-    std::int32_t limit = 0;
-    try{
-        std::size_t pos = 0;
-        const long long parsed = std::stoll(cmd.limit, &pos);
-        if(pos != cmd.limit.size() || parsed <= 0 || parsed > 100){
-            reg.request_send(fd, command_codec::cmd_response{"invalid limit (1-100)"});
-            return;
+    const auto limit = command_codec::parse_positive(cmd.limit);
+    if(!limit || *limit > 100){
+        reg.request_send(conn, command_codec::cmd_response{"invalid limit (1-100)"});
+        return;
+    }
+
+    response_block out;
+    auto stream_exp = db.stream_room_messages(
+        user_id, *room_id, static_cast<std::int32_t>(*limit), 0,
+        [&](db_service::message_info&& msg, std::size_t page_size){
+            if(out.empty()){
+                out.push({"history: room=", std::to_string(*room_id), " count=", std::to_string(page_size)});
+            }
+            push_message(out, "history: ", msg);
         }
-        limit = static_cast<std::int32_t>(parsed);
-    } catch(...){
-        reg.request_send(fd, command_codec::cmd_response{"invalid limit (1-100)"});
+    );
+    if(!stream_exp){
+        logger::log_error("history query failed", "db_executor::execute_command()", stream_exp.error());
+        reg.request_send(conn, command_codec::cmd_response{"history query failed"});
+        return;
+    }
+    if(!*stream_exp){
+        reg.request_send(conn, command_codec::cmd_response{"room not found or no permission"});
         return;
     }
 
-    auto history_exp = db.list_room_messages(user_id, room_id, limit);
-    if(!history_exp){
-        logger::log_error("history query failed", "db_executor::execute_command()", history_exp.error());
-        reg.request_send(fd, command_codec::cmd_response{"history query failed"});
+    if(out.empty()) out.push({"history: room=", std::to_string(*room_id), " count=0"});
+    reg.request_send_block(conn, std::move(out));
+
+    logger::log_info(
+        std::string(user_id)
+        + " request history room=" + std::to_string(*room_id)
+        + " limit=" + std::to_string(*limit)
+    );
+}
+
+void db_executor::execute_command(
+    const command_codec::cmd_history_before& cmd,
+    epoll_registry& reg,
+    conn_handle conn,
+    std::string_view user_id
+){
+    if(user_id.empty()){
+        reg.request_send(conn, command_codec::cmd_response{"login first"});
         return;
     }
 
-    if(!*history_exp){
-        reg.request_send(fd, command_codec::cmd_response{"room not found or no permission"});
+    const auto room_id = command_codec::parse_positive(cmd.room_id);
+    if(!room_id){
+        reg.request_send(conn, command_codec::cmd_response{"invalid room id"});
+        return;
+    }
+    const auto limit = command_codec::parse_positive(cmd.limit);
+    if(!limit || *limit > HISTORY_PAGE_MAX){
+        reg.request_send(
+            conn, command_codec::cmd_response{"invalid limit (1-" + std::to_string(HISTORY_PAGE_MAX) + ")"}
+        );
+        return;
+    }
+    const auto before_id = command_codec::parse_positive(cmd.before_id);
+    if(!before_id){
+        reg.request_send(conn, command_codec::cmd_response{"invalid message id"});
         return;
     }
 
-    const auto& history = **history_exp;
-    reg.request_send(
-        fd,
-        command_codec::cmd_response{
-            "history: room=" + std::to_string(room_id) + " count=" + std::to_string(history.size())
+    response_block out;
+    out.push({"history: room=", std::to_string(*room_id), " before=", std::to_string(*before_id)});
+    std::int64_t oldest_id = 0;
+    auto stream_exp = db.stream_room_messages(
+        user_id, *room_id, static_cast<std::int32_t>(*limit), *before_id,
+        [&](db_service::message_info&& msg, std::size_t){
+            oldest_id = msg.id;
+            push_message(out, "history: ", msg);
+            if(out.text_bytes() >= HISTORY_BLOCK_BYTES){
+                reg.request_send_block(conn, std::move(out));
+                out.clear();
+            }
         }
     );
-    for(const auto& msg : history){
-        reg.request_send(
-            fd,
-            command_codec::cmd_response{
-                "history: id=" + std::to_string(msg.id)
-                + " at=" + msg.created_at
-                + " from=" + msg.sender_user_id
-                + " text=" + msg.body
-            }
-        );
+    if(!stream_exp){
+        logger::log_error("history query failed", "db_executor::execute_command()", stream_exp.error());
+        reg.request_send(conn, command_codec::cmd_response{"history query failed"});
+        return;
     }
+    if(!*stream_exp){
+        reg.request_send(conn, command_codec::cmd_response{"room not found or no permission"});
+        return;
+    }
+
+    // next_before=0 means the page reached the start of the room.
+    const std::size_t count = **stream_exp;
+    out.push({
+        "history: end count=", std::to_string(count),
+        " next_before=", std::to_string(count == static_cast<std::size_t>(*limit) ? oldest_id : 0)
+    });
+    reg.request_send_block(conn, std::move(out));
 
     logger::log_info(
         std::string(user_id)
-        + " request history room=" + std::to_string(room_id)
-        + " limit=" + std::to_string(limit)
+        + " request history room=" + std::to_string(*room_id)
+        + " limit=" + std::to_string(*limit)
+        + " before=" + std::to_string(*before_id)
     );
 }
@@ -1,12 +1,27 @@
 #include "database/db_service.hpp"
 #include "database/db_connector.hpp"
+#include "database/room_notify_listener.hpp"
+#include "core/logger.hpp"
+#include "search/message_index.hpp"
 #include <pqxx/pqxx>
+#include <algorithm>
 #include <cerrno>
 #include <string>
+#include <utility>
 #include <vector>
 
 db_service::db_service(db_connector& connector) noexcept : connector(connector) {}
 
+void db_service::set_room_notify(std::string channel, std::string node_id){
+    std::lock_guard<std::mutex> lock(mtx);
+    notify_channel = std::move(channel);
+    this->node_id = std::move(node_id);
+}
+
+void db_service::set_search_index(message_index* index){
+    search = index;
+}
+
 std::expected<void, error_code> db_service::ping() noexcept{
     std::lock_guard<std::mutex> lock(mtx);
 
@@ -303,7 +318,13 @@ std::expected<bool, error_code> db_service::delete_room(
             pqxx::params{room_id, owner_user_id}
         );
         tx.commit();
-        return !rows.empty();
+        if(rows.empty()) return false;
+
+        if(search != nullptr){
+            auto drop_exp = search->drop_room(room_id);
+            if(!drop_exp) logger::log_warn("search index drop failed", "db_service::delete_room()", drop_exp);
+        }
+        return true;
     } catch(const std::exception& ex){
         return std::unexpected(db_connector::map_exception(ex));
     }
@@ -378,9 +399,26 @@ std::expected<std::optional<std::int64_t>, error_code> db_service::create_room_m
             "RETURNING id",
             pqxx::params{room_id, sender_user_id, body}
         );
+        if(rows.empty()){
+            tx.commit();
+            return std::optional<std::int64_t>{};
+        }
+
+        const std::int64_t message_id = rows[0][0].as<std::int64_t>();
+        if(!notify_channel.empty()){
+            // Delivered to listeners only when the insert commits.
+            tx.exec(
+                "SELECT pg_notify($1, $2)",
+                pqxx::params{notify_channel, room_notify::encode(node_id, room_id, message_id)}
+            );
+        }
         tx.commit();
-        if(rows.empty()) return std::optional<std::int64_t>{};
-        return std::optional<std::int64_t>{rows[0][0].as<std::int64_t>()};
+        unread.note_message(room_id, sender_user_id);
+        if(search != nullptr){
+            auto index_exp = search->add(room_id, message_id, sender_user_id, body);
+            if(!index_exp) logger::log_warn("search index append failed", "db_service::create_room_message()", index_exp);
+        }
+        return std::optional<std::int64_t>{message_id};
     } catch(const std::exception& ex){
         return std::unexpected(db_connector::map_exception(ex));
     }
@@ -436,10 +474,12 @@ std::expected<std::vector<db_service::room_info>, error_code> db_service::list_r
     try{
         pqxx::read_transaction tx(connector.connection());
         auto rows = tx.exec(
-            "SELECT r.id, r.name, r.owner_user_id, COUNT(all_m.user_id)::BIGINT AS member_count "
+            "SELECT r.id, r.name, r.owner_user_id, COUNT(all_m.user_id)::BIGINT AS member_count, "
+            "  COALESCE(MAX(rs.unread_count), 0)::BIGINT AS unread_count "
             "FROM chat.rooms r "
             "JOIN chat.room_members scope_m "
             "  ON scope_m.room_id = r.id AND scope_m.user_id = $1 "
+            "LEFT JOIN chat.read_state rs ON rs.room_id = r.id AND rs.user_id = $1 "
             "LEFT JOIN chat.room_members all_m ON all_m.room_id = r.id "
             "GROUP BY r.id, r.name, r.owner_user_id "
             "ORDER BY r.id ASC",
@@ -455,6 +495,7 @@ std::expected<std::vector<db_service::room_info>, error_code> db_service::list_r
             info.name = row[1].c_str();
             info.owner_user_id = row[2].c_str();
             info.member_count = row[3].as<std::int64_t>();
+            info.unread_count = unread.effective(info.id, user_id, row[4].as<std::int64_t>());
             out.push_back(std::move(info));
         }
         return out;
@@ -463,15 +504,17 @@ std::expected<std::vector<db_service::room_info>, error_code> db_service::list_r
     }
 }
 
-std::expected<std::optional<std::vector<db_service::message_info>>, error_code> db_service::list_room_messages(
+std::expected<std::optional<std::size_t>, error_code> db_service::stream_room_messages(
     std::string_view user_id,
     std::int64_t room_id,
-    std::int32_t limit
+    std::int32_t limit,
+    std::int64_t before_id,
+    const std::function<void(message_info&&, std::size_t)>& on_message
 ) noexcept{
     std::lock_guard<std::mutex> lock(mtx);
 
     try{
-        pqxx::read_transaction tx(connector.connection());
+        pqxx::work tx(connector.connection());
         auto member_rows = tx.exec(
             "SELECT 1 "
             "FROM chat.room_members "
@@ -481,20 +524,109 @@ std::expected<std::optional<std::vector<db_service::message_info>>, error_code>
         );
         if(member_rows.empty()){
             tx.commit();
-            return std::optional<std::vector<message_info>>{};
+            return std::optional<std::size_t>{};
         }
 
-        auto rows = tx.exec(
-            "SELECT id, sender_user_id, body, created_at::TEXT "
+        // COPY-based streaming takes no bind parameters; every value here is an integer.
+        const bool newest = before_id == 0;
+        const std::string query =
+            "SELECT id, sender_user_id, body, created_at::TEXT, COUNT(*) OVER () "
             "FROM ("
             "  SELECT id, sender_user_id, body, created_at "
             "  FROM chat.messages "
-            "  WHERE room_id = $1 "
-            "  ORDER BY created_at DESC, id DESC "
-            "  LIMIT $2"
-            ") h "
-            "ORDER BY id ASC",
-            pqxx::params{room_id, limit}
+            "  WHERE room_id = " + std::to_string(room_id)
+            + (newest ? std::string() : " AND id < " + std::to_string(before_id)) + " "
+            "  ORDER BY id DESC "
+            "  LIMIT " + std::to_string(limit)
+            + ") h "
+            "ORDER BY id " + (newest ? "ASC" : "DESC");
+
+        std::size_t count = 0;
+        std::int64_t max_id = 0;
+        for(auto [id, sender, body, created_at, page_size] :
+            tx.stream<std::int64_t, std::string_view, std::string_view, std::string_view, std::int64_t>(query)){
+            message_info info{};
+            info.id = id;
+            info.room_id = room_id;
+            info.sender_user_id = sender;
+            info.body = body;
+            info.created_at = created_at;
+            on_message(std::move(info), static_cast<std::size_t>(page_size));
+            max_id = std::max(max_id, id);
+            ++count;
+        }
+
+        // The newest page counts as read for both the unread counter and the
+        // catch-up cursor, so /list_room and the next login agree.
+        if(newest){
+            if(max_id > 0){
+                tx.exec(
+                    "UPDATE chat.room_members SET last_read_message_id = $3 "
+                    "WHERE room_id = $1 AND user_id = $2 AND last_read_message_id < $3",
+                    pqxx::params{room_id, user_id, max_id}
+                );
+            }
+            tx.exec(
+                "UPDATE chat.read_state SET unread_count = 0 "
+                "WHERE room_id = $1 AND user_id = $2 AND unread_count <> 0",
+                pqxx::params{room_id, user_id}
+            );
+        }
+        tx.commit();
+        if(newest) unread.note_read(room_id, user_id);
+        return std::optional<std::size_t>{count};
+    } catch(const std::exception& ex){
+        return std::unexpected(db_connector::map_exception(ex));
+    }
+}
+
+std::expected<std::vector<db_service::message_info>, error_code> db_service::take_unread_messages(
+    std::string_view user_id,
+    std::int32_t per_room,
+    std::int32_t max_total
+) noexcept{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    try{
+        pqxx::work tx(connector.connection());
+        auto rows = tx.exec(
+            "WITH picked AS ("
+            "  SELECT rm.room_id, m.id, m.sender_user_id, m.body, m.created_at "
+            "  FROM chat.room_members rm "
+            "  CROSS JOIN LATERAL ("
+            "    SELECT id, sender_user_id, body, created_at "
+            "    FROM chat.messages "
+            "    WHERE room_id = rm.room_id AND id > rm.last_read_message_id "
+            "    ORDER BY id DESC "
+            "    LIMIT $2"
+            "  ) m "
+            "  WHERE rm.user_id = $1 "
+            "  ORDER BY rm.room_id ASC, m.id ASC "
+            "  LIMIT $3"
+            "), progress AS ("
+            // Only the last room can be cut short by the total cap; what is
+            // left past its newest sent message stays unread.
+            "  SELECT p.room_id, p.max_id, ("
+            "    SELECT COUNT(*) FROM chat.messages m WHERE m.room_id = p.room_id AND m.id > p.max_id"
+            "  ) AS remaining "
+            "  FROM (SELECT room_id, MAX(id) AS max_id FROM picked GROUP BY room_id) p"
+            "), advanced AS ("
+            "  UPDATE chat.room_members rm "
+            "  SET last_read_message_id = p.max_id "
+            "  FROM progress p "
+            "  WHERE rm.user_id = $1 AND rm.room_id = p.room_id AND rm.last_read_message_id < p.max_id"
+            "), cleared AS ("
+            "  INSERT INTO chat.read_state AS rs (room_id, user_id, unread_count) "
+            "  SELECT room_id, $1, remaining FROM progress "
+            "  ON CONFLICT (room_id, user_id) DO UPDATE "
+            "  SET unread_count = EXCLUDED.unread_count "
+            "  WHERE rs.unread_count <> EXCLUDED.unread_count"
+            ") "
+            "SELECT k.room_id, k.id, k.sender_user_id, k.body, k.created_at::TEXT, p.remaining "
+            "FROM picked k "
+            "JOIN progress p ON p.room_id = k.room_id "
+            "ORDER BY k.room_id ASC, k.id ASC",
+            pqxx::params{user_id, per_room, max_total}
         );
         tx.commit();
 
@@ -502,13 +634,184 @@ std::expected<std::optional<std::vector<db_service::message_info>>, error_code>
         out.reserve(rows.size());
         for(const auto& row : rows){
             message_info info{};
-            info.id = row[0].as<std::int64_t>();
-            info.sender_user_id = row[1].c_str();
-            info.body = row[2].c_str();
-            info.created_at = row[3].c_str();
+            info.room_id = row[0].as<std::int64_t>();
+            info.id = row[1].as<std::int64_t>();
+            info.sender_user_id = row[2].c_str();
+            info.body = row[3].c_str();
+            info.created_at = row[4].c_str();
+            if(out.empty() || out.back().room_id != info.room_id){
+                unread.note_read(info.room_id, user_id, row[5].as<std::int64_t>());
+            }
             out.push_back(std::move(info));
         }
-        return std::optional<std::vector<message_info>>{std::move(out)};
+        return out;
+    } catch(const std::exception& ex){
+        return std::unexpected(db_connector::map_exception(ex));
+    }
+}
+
+std::expected<void, error_code> db_service::mark_rooms_read(
+    std::string_view user_id
+) noexcept{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    try{
+        pqxx::work tx(connector.connection());
+        tx.exec(
+            "UPDATE chat.room_members rm "
+            "SET last_read_message_id = latest.max_id "
+            "FROM chat.room_members me "
+            "CROSS JOIN LATERAL ("
+            "  SELECT MAX(id) AS max_id FROM chat.messages "
+            "  WHERE room_id = me.room_id AND id > me.last_read_message_id"
+            ") latest "
+            "WHERE me.user_id = $1 "
+            "  AND rm.room_id = me.room_id AND rm.user_id = me.user_id "
+            "  AND latest.max_id > rm.last_read_message_id",
+            pqxx::params{user_id}
+        );
+        tx.exec(
+            "UPDATE chat.read_state SET unread_count = 0 "
+            "WHERE user_id = $1 AND unread_count <> 0",
+            pqxx::params{user_id}
+        );
+        tx.commit();
+        unread.note_read_all(user_id);
+        return {};
+    } catch(const std::exception& ex){
+        return std::unexpected(db_connector::map_exception(ex));
+    }
+}
+
+std::expected<std::size_t, error_code> db_service::sync_search_index() noexcept{
+    std::lock_guard<std::mutex> lock(mtx);
+    if(search == nullptr) return 0;
+
+    try{
+        pqxx::read_transaction tx(connector.connection());
+        std::vector<std::int64_t> room_ids;
+        for(auto row : tx.exec("SELECT id FROM chat.rooms")){
+            room_ids.push_back(row[0].as<std::int64_t>());
+        }
+        auto retain_exp = search->retain_rooms(room_ids);
+        if(!retain_exp) return std::unexpected(retain_exp.error());
+
+        // Ids are taken before commit, so a lower id can become visible after
+        // a higher one. The mark only moves past rows old enough that every
+        // earlier id has committed; newer rows are read again next time and
+        // skipped by the index if it already holds them.
+        const std::string query =
+            "SELECT room_id, id, sender_user_id, body, created_at < now() - INTERVAL '1 minute' "
+            "FROM chat.messages "
+            "WHERE id > " + std::to_string(search->synced_message_id()) + " "
+            "ORDER BY id";
+
+        std::size_t count = 0;
+        std::int64_t settled_id = 0;
+        bool settling = true;
+        for(auto [room_id, id, sender, body, settled] :
+            tx.stream<std::int64_t, std::int64_t, std::string_view, std::string_view, bool>(query)){
+            auto add_exp = search->add(room_id, id, sender, body);
+            if(!add_exp) return std::unexpected(add_exp.error());
+            if(*add_exp) ++count;
+
+            settling = settling && settled;
+            if(settling) settled_id = id;
+        }
+        tx.commit();
+
+        auto mark_exp = search->set_synced_message_id(settled_id);
+        if(!mark_exp) return std::unexpected(mark_exp.error());
+        return count;
+    } catch(const std::exception& ex){
+        return std::unexpected(db_connector::map_exception(ex));
+    }
+}
+
+// The index has its own lock and no query is made, so this does not hold
+// the connection while the log is rewritten.
+std::expected<std::size_t, error_code> db_service::compact_search_index() noexcept{
+    if(search == nullptr || !search->reclaimable()) return 0;
+
+    try{
+        return search->compact();
+    } catch(const std::exception& ex){
+        return std::unexpected(db_connector::map_exception(ex));
+    }
+}
+
+std::expected<db_service::partition_report, error_code> db_service::maintain_message_partitions(
+    std::int64_t partition_rows,
+    std::int32_t ahead,
+    std::int32_t retention_days
+) noexcept{
+    std::lock_guard<std::mutex> lock(mtx);
+
+    try{
+        pqxx::work tx(connector.connection());
+        partition_report report{};
+        auto created_rows = tx.exec(
+            "SELECT chat.ensure_message_partitions($1, $2)",
+            pqxx::params{partition_rows, ahead}
+        );
+        report.created = created_rows[0][0].as<std::int32_t>();
+
+        auto detached_rows = tx.exec(
+            "SELECT chat.detach_expired_message_partitions($1)",
+            pqxx::params{retention_days}
+        );
+        report.detached = detached_rows[0][0].as<std::int32_t>();
+
+        auto first_rows = tx.exec(
+            "SELECT COALESCE(MIN(from_id), 1) FROM chat.message_partitions WHERE detached_at IS NULL"
+        );
+        report.first_message_id = first_rows[0][0].as<std::int64_t>();
+        tx.commit();
+
+        if(search != nullptr) search->set_first_message_id(report.first_message_id);
+        return report;
+    } catch(const std::exception& ex){
+        return std::unexpected(db_connector::map_exception(ex));
+    }
+}
+
+std::size_t db_service::pending_unread() noexcept{
+    std::lock_guard<std::mutex> lock(mtx);
+    return unread.pending_messages();
+}
+
+std::expected<void, error_code> db_service::flush_unread() noexcept{
+    std::lock_guard<std::mutex> lock(mtx);
+    if(unread.empty()) return {};
+
+    try{
+        const auto batch = unread.make_batch();
+        pqxx::work tx(connector.connection());
+        tx.exec(
+            "INSERT INTO chat.read_state AS rs (room_id, user_id, unread_count) "
+            "SELECT rm.room_id, rm.user_id, p.n "
+            "FROM unnest($1::BIGINT[], $2::BIGINT[]) AS p(room_id, n) "
+            "JOIN chat.room_members rm ON rm.room_id = p.room_id "
+            "WHERE NOT EXISTS ("
+            "  SELECT 1 FROM unnest($3::BIGINT[], $4::TEXT[]) AS c(room_id, user_id) "
+            "  WHERE c.room_id = rm.room_id AND c.user_id = rm.user_id"
+            ") "
+            "ON CONFLICT (room_id, user_id) DO UPDATE "
+            "SET unread_count = rs.unread_count + EXCLUDED.unread_count",
+            pqxx::params{batch.room_ids, batch.posted, batch.reset_room_ids, batch.reset_user_ids}
+        );
+        tx.exec(
+            "INSERT INTO chat.read_state AS rs (room_id, user_id, unread_count) "
+            "SELECT c.room_id, c.user_id, c.n "
+            "FROM unnest($1::BIGINT[], $2::TEXT[], $3::BIGINT[]) AS c(room_id, user_id, n) "
+            "JOIN chat.room_members rm ON rm.room_id = c.room_id AND rm.user_id = c.user_id "
+            "ON CONFLICT (room_id, user_id) DO UPDATE "
+            "SET unread_count = EXCLUDED.unread_count",
+            pqxx::params{batch.reset_room_ids, batch.reset_user_ids, batch.reset_counts}
+        );
+        tx.commit();
+        unread.clear();
+        return {};
     } catch(const std::exception& ex){
         return std::unexpected(db_connector::map_exception(ex));
     }
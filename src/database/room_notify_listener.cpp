@@ -0,0 +1,138 @@
+#include "database/room_notify_listener.hpp"
+#include "core/logger.hpp"
+#include "database/db_connector.hpp"
+#include "protocol/command_codec.hpp"
+#include "reactor/epoll_registry.hpp"
+#include "search/message_index.hpp"
+#include <cerrno>
+#include <charconv>
+#include <random>
+#include <utility>
+
+namespace{
+    // await_notification() polls with this timeout so a stop request is seen promptly.
+    constexpr long POLL_US = 200 * 1000;
+
+    bool parse_id(std::string_view sv, std::int64_t& out){
+        auto [ptr, ec] = std::from_chars(sv.data(), sv.data() + sv.size(), out);
+        return ec == std::errc{} && ptr == sv.data() + sv.size() && out > 0;
+    }
+}
+
+std::string room_notify::make_node_id(){
+    std::random_device rd;
+    std::uint64_t v = (std::uint64_t{rd()} << 32) | rd();
+    char buf[16];
+    auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), v, 16);
+    return std::string(buf, ptr);
+}
+
+std::string room_notify::encode(std::string_view node_id, std::int64_t room_id, std::int64_t message_id){
+    std::string out;
+    out.reserve(node_id.size() + 42);
+    out += node_id;
+    out += ':';
+    out += std::to_string(room_id);
+    out += ':';
+    out += std::to_string(message_id);
+    return out;
+}
+
+std::optional<room_notify> room_notify::decode(std::string_view payload){
+    const std::size_t first = payload.find(':');
+    if(first == std::string_view::npos || first == 0) return std::nullopt;
+    const std::size_t second = payload.find(':', first + 1);
+    if(second == std::string_view::npos) return std::nullopt;
+
+    room_notify out;
+    out.node_id = payload.substr(0, first);
+    if(!parse_id(payload.substr(first + 1, second - first - 1), out.room_id)) return std::nullopt;
+    if(!parse_id(payload.substr(second + 1), out.message_id)) return std::nullopt;
+    return out;
+}
+
+room_notify_listener::room_notify_listener(
+    db_connector& connector, epoll_registry& reg, cluster_options opts, message_index* search
+) :
+    connector(connector), reg(reg), opts(std::move(opts)), search(search){}
+
+void room_notify_listener::on_notify(std::string_view payload){
+    std::optional<room_notify> ev = room_notify::decode(payload);
+    if(!ev){
+        logger::log_warn("malformed room notification", "room_notify_listener::on_notify()", error_code::from_errno(EINVAL));
+        return;
+    }
+
+    // The origin node already delivered its own messages locally.
+    if(ev->node_id == opts.node_id) return;
+    if(!remember(ev->message_id)) return;
+    batch.push_back(ev->message_id);
+}
+
+bool room_notify_listener::remember(std::int64_t message_id){
+    if(!seen.insert(message_id).second) return false;
+
+    seen_order.push_back(message_id);
+    if(seen_order.size() > SEEN_WINDOW){
+        seen.erase(seen_order.front());
+        seen_order.pop_front();
+    }
+    return true;
+}
+
+void room_notify_listener::flush(){
+    std::string ids = "{";
+    for(std::int64_t id : batch){
+        if(ids.size() > 1) ids += ',';
+        ids += std::to_string(id);
+    }
+    ids += '}';
+    batch.clear();
+
+    pqxx::read_transaction tx(connector.connection());
+    auto rows = tx.exec(
+        "SELECT m.room_id, u.nickname, m.body, m.id, m.sender_user_id "
+        "FROM chat.messages m "
+        "JOIN auth.users u ON u.id = m.sender_user_id "
+        "WHERE m.id = ANY($1::bigint[]) "
+        "ORDER BY m.id",
+        pqxx::params{ids}
+    );
+    tx.commit();
+
+    for(const auto& row : rows){
+        const auto room_id = row[0].as<std::int64_t>();
+        reg.request_room_relay(room_id, row[1].c_str(), command_codec::cmd_response{row[2].c_str()});
+        if(search == nullptr) continue;
+
+        auto index_exp = search->add(room_id, row[3].as<std::int64_t>(), row[4].c_str(), row[2].c_str());
+        if(!index_exp) logger::log_warn("search index append failed", "room_notify_listener::flush()", index_exp);
+    }
+}
+
+std::expected<void, error_code> room_notify_listener::run(const std::stop_token& st){
+    using clock = std::chrono::steady_clock;
+
+    try{
+        pqxx::connection& conn = connector.connection();
+        conn.listen(opts.channel, [this](pqxx::notification n){ on_notify(n.payload); });
+        logger::log_info("cluster fan-out listening on " + opts.channel + " as node " + opts.node_id);
+
+        while(!st.stop_requested()){
+            conn.await_notification(0, POLL_US);
+            if(batch.empty()) continue;
+
+            // Keep collecting for a short window so a burst costs one query.
+            const clock::time_point deadline = clock::now() + opts.batch_window;
+            while(batch.size() < opts.batch_max){
+                const auto left = std::chrono::duration_cast<std::chrono::microseconds>(deadline - clock::now());
+                if(left.count() <= 0) break;
+                conn.await_notification(0, static_cast<long>(left.count()));
+            }
+            flush();
+        }
+        return {};
+    } catch(const std::exception& ex){
+        return std::unexpected(db_connector::map_exception(ex));
+    }
+}
@@ -0,0 +1,78 @@
+#include "database/unread_counters.hpp"
+
+namespace{
+void append_int(std::string& out, std::int64_t v){
+    out += out.size() > 1 ? "," : "";
+    out += std::to_string(v);
+}
+
+void append_text(std::string& out, std::string_view v){
+    out += out.size() > 1 ? ",\"" : "\"";
+    for(char ch : v){
+        if(ch == '"' || ch == '\\') out.push_back('\\');
+        out.push_back(ch);
+    }
+    out.push_back('"');
+}
+}
+
+void unread_counters::note_message(std::int64_t room_id, std::string_view sender_user_id){
+    auto& room = rooms[room_id];
+    ++room.posted;
+    ++pending;
+
+    auto it = room.caught_up_at.find(sender_user_id);
+    if(it == room.caught_up_at.end()) room.caught_up_at.emplace(std::string(sender_user_id), room.posted);
+    else it->second = room.posted;
+}
+
+void unread_counters::note_read(std::int64_t room_id, std::string_view user_id, std::int64_t left){
+    auto room_it = rooms.find(room_id);
+    if(room_it == rooms.end()) return;
+
+    auto& room = room_it->second;
+    auto it = room.caught_up_at.find(user_id);
+    if(it == room.caught_up_at.end()) room.caught_up_at.emplace(std::string(user_id), room.posted - left);
+    else it->second = room.posted - left;
+}
+
+void unread_counters::note_read_all(std::string_view user_id){
+    for(const auto& [room_id, room] : rooms){
+        note_read(room_id, user_id);
+    }
+}
+
+std::int64_t unread_counters::effective(std::int64_t room_id, std::string_view user_id, std::int64_t stored) const{
+    auto room_it = rooms.find(room_id);
+    if(room_it == rooms.end()) return stored;
+
+    const auto& room = room_it->second;
+    auto it = room.caught_up_at.find(user_id);
+    if(it == room.caught_up_at.end()) return stored + room.posted;
+    return room.posted - it->second;
+}
+
+std::size_t unread_counters::pending_messages() const noexcept{ return pending; }
+bool unread_counters::empty() const noexcept{ return rooms.empty(); }
+
+unread_counters::flush_batch unread_counters::make_batch() const{
+    flush_batch batch{"{", "{", "{", "{", "{"};
+    for(const auto& [room_id, room] : rooms){
+        append_int(batch.room_ids, room_id);
+        append_int(batch.posted, room.posted);
+        for(const auto& [user_id, at] : room.caught_up_at){
+            append_int(batch.reset_room_ids, room_id);
+            append_text(batch.reset_user_ids, user_id);
+            append_int(batch.reset_counts, room.posted - at);
+        }
+    }
+    for(auto* s : {&batch.room_ids, &batch.posted, &batch.reset_room_ids, &batch.reset_user_ids, &batch.reset_counts}){
+        s->push_back('}');
+    }
+    return batch;
+}
+
+void unread_counters::clear() noexcept{
+    rooms.clear();
+    pending = 0;
+}
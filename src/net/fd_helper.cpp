@@ -1,5 +1,8 @@
 #include "net/fd_helper.hpp"
+#include <arpa/inet.h>
 #include <fcntl.h>
+#include <netinet/in.h>
+#include <cstring>
 
 std::expected<unique_fd, error_code> make_server_fd(addrinfo* head){
     int ec = 0;
@@ -28,32 +31,44 @@ std::expected<unique_fd, error_code> make_server_fd(addrinfo* head){
     return std::unexpected(error_code::from_errno(ec));
 }
 
-const sockaddr* endpoint::addr() const noexcept{ return reinterpret_cast<const sockaddr*>(&ss); }
-sockaddr* endpoint::addr() noexcept{ return reinterpret_cast<sockaddr*>(&ss); }
-
-std::expected <void, error_code> endpoint::init_string(){
-    int ec = ::getnameinfo(this->addr(), this->len, ip, sizeof(ip), port, sizeof(port), NI_NUMERICHOST | NI_NUMERICSERV);
-    if(ec != 0) return std::unexpected(error_code::from_gai(ec));
-    return {};
+endpoint endpoint::from_sockaddr(const sockaddr* sa) noexcept{
+    endpoint ep;
+    ep.family = sa->sa_family;
+    if(sa->sa_family == AF_INET){
+        const auto* in = reinterpret_cast<const sockaddr_in*>(sa);
+        std::memcpy(ep.addr.data(), &in->sin_addr, sizeof(in->sin_addr));
+        ep.port = ntohs(in->sin_port);
+    }
+    else if(sa->sa_family == AF_INET6){
+        const auto* in6 = reinterpret_cast<const sockaddr_in6*>(sa);
+        std::memcpy(ep.addr.data(), &in6->sin6_addr, sizeof(in6->sin6_addr));
+        ep.port = ntohs(in6->sin6_port);
+    }
+    return ep;
 }
 
-std::string endpoint::get_ip(){
-    return std::string(ip);
+std::string endpoint::get_ip() const{
+    char buf[INET6_ADDRSTRLEN]{};
+    if(family != AF_INET && family != AF_INET6) return "local";
+    if(::inet_ntop(family, addr.data(), buf, sizeof(buf)) == nullptr) return "?";
+    return std::string(buf);
 }
 
-std::string endpoint::get_port(){
-    return std::string(port);
+std::string endpoint::get_port() const{
+    return std::to_string(port);
 }
 
 std::string to_string(const endpoint& ep){
-    return std::string(ep.ip) + ":" + std::string(ep.port);
+    return ep.get_ip() + ":" + ep.get_port();
 }
 
 std::expected<endpoint, error_code> make_peer_endpoint(int fd){
-    endpoint ep;
+    sockaddr_storage ss{};
     while(true){
-        ep.len = sizeof(ep.ss);
-        if(::getpeername(fd, ep.addr(), &ep.len) == 0) return ep;
+        socklen_t len = sizeof(ss);
+        if(::getpeername(fd, reinterpret_cast<sockaddr*>(&ss), &len) == 0){
+            return endpoint::from_sockaddr(reinterpret_cast<const sockaddr*>(&ss));
+        }
 
         int ec = errno;
         if(ec == EINTR) continue;
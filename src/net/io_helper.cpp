@@ -1,24 +1,87 @@
 #include "net/io_helper.hpp"
+#include "core/buffer_pool.hpp"
 #include "net/fd_helper.hpp"
 #include "net/tls_error.hpp"
 #include "protocol/line_parser.hpp"
 #include <cerrno>
 #include <sys/epoll.h>
 #include <sys/socket.h>
-#include <array>
-#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+namespace{
+    // drain_recv reads straight into the recv buffer's chunk and grows it
+    // when less than this is free.
+    constexpr std::size_t MIN_READ_SIZE = 1024;
+}
+
+offset_buffer::offset_buffer(offset_buffer&& other) noexcept :
+    buf(std::exchange(other.buf, nullptr)),
+    used(std::exchange(other.used, 0)),
+    cap(std::exchange(other.cap, 0)),
+    offset(std::exchange(other.offset, 0)){}
+
+offset_buffer& offset_buffer::operator=(offset_buffer&& other) noexcept{
+    if(this == &other) return *this;
+    buffer_pool::release(buf);
+    buf = std::exchange(other.buf, nullptr);
+    used = std::exchange(other.used, 0);
+    cap = std::exchange(other.cap, 0);
+    offset = std::exchange(other.offset, 0);
+    return *this;
+}
+
+offset_buffer::~offset_buffer(){
+    buffer_pool::release(buf);
+}
+
+void offset_buffer::reserve_extra(std::size_t n){
+    const std::size_t live = remaining();
+    if(cap - used >= n) return;
+    if(cap - live >= n && offset > 0){
+        std::memmove(buf, buf + offset, live);
+        used = static_cast<std::uint32_t>(live);
+        offset = 0;
+        return;
+    }
+
+    const std::size_t need = live + n;
+    if(need > std::numeric_limits<std::uint32_t>::max()) throw std::length_error("offset_buffer too large");
+
+    buffer_pool::block next = buffer_pool::local().allocate(std::max<std::size_t>(need, std::size_t{cap} * 2));
+    if(live > 0) std::memcpy(next.data, buf + offset, live);
+    buffer_pool::release(buf);
+    buf = next.data;
+    cap = static_cast<std::uint32_t>(std::min<std::size_t>(next.capacity, std::numeric_limits<std::uint32_t>::max()));
+    used = static_cast<std::uint32_t>(live);
+    offset = 0;
+}
 
 bool offset_buffer::clear_if_done(){
-    if(buf.size() != offset) return false;
-    buf.clear();
+    if(remaining() != 0) return false;
+    used = 0;
+    offset = 0;
+    return true;
+}
+
+bool offset_buffer::release_if_done(){
+    if(remaining() != 0) return false;
+    buffer_pool::release(buf);
+    buf = nullptr;
+    used = 0;
+    cap = 0;
     offset = 0;
     return true;
 }
 
 bool offset_buffer::compact_if_needed(){
     if(offset < 8192) return false;
-    if(offset * 2 < buf.size()) return false;
-    buf.erase(0, offset);
+    if(std::size_t{offset} * 2 < used) return false;
+    std::memmove(buf, buf + offset, used - offset);
+    used -= offset;
     offset = 0;
     return true;
 }
@@ -27,20 +90,25 @@ void offset_buffer::reset_offset(){
     offset = 0;
 }
 
+void offset_buffer::clear() noexcept{
+    used = 0;
+    offset = 0;
+}
+
 bool offset_buffer::has_pending() const{
-    return offset < buf.size();
+    return remaining() != 0;
 }
 
 const char* offset_buffer::current_data() const{
-    return buf.data() + offset;
+    return buf == nullptr ? nullptr : buf + offset;
 }
 
 std::size_t offset_buffer::remaining() const{
-    return buf.size() - offset;
+    return used - offset;
 }
 
 void offset_buffer::advance(std::size_t n){
-    offset += n;
+    offset += static_cast<std::uint32_t>(n);
 }
 
 std::size_t offset_buffer::get_offset() const{
@@ -48,44 +116,102 @@ std::size_t offset_buffer::get_offset() const{
 }
 
 void offset_buffer::set_offset(std::size_t new_offset){
-    offset = new_offset;
+    offset = static_cast<std::uint32_t>(new_offset);
+}
+
+std::span<char> offset_buffer::prepare(std::size_t min_free){
+    reserve_extra(min_free);
+    return std::span<char>(buf + used, cap - used);
+}
+
+void offset_buffer::commit(std::size_t n) noexcept{
+    used += static_cast<std::uint32_t>(n);
 }
 
-std::string& offset_buffer::raw(){
-    return buf;
+std::string_view offset_buffer::view() const noexcept{
+    return buf == nullptr ? std::string_view{} : std::string_view(buf, used);
 }
 
-const std::string& offset_buffer::raw() const{
-    return buf;
+std::size_t offset_buffer::heap_bytes() const noexcept{
+    return cap;
 }
 
 bool send_buffer::append(const command_codec::command& cmd){
-    return append(command_codec::encode(cmd));
+    return append(command_codec::view(cmd));
 }
 
-bool send_buffer::append(std::string_view sv){
+// Encodes straight into the chunk, so queueing a command costs no temporary.
+bool send_buffer::append(const command_codec::command_view& cmd){
+    bool was_pending = has_pending();
+    const std::size_t n = command_codec::encoded_size(cmd, format);
+    reserve_extra(n);
+    command_codec::encode_to(buf + used, cmd, format);
+    used += static_cast<std::uint32_t>(n);
+    return !was_pending && has_pending();
+}
+
+// Sizes the whole block first, so the chunk grows at most once.
+bool send_buffer::append(const response_block& block){
     bool was_pending = has_pending();
-    buf += sv;
+    std::size_t n = 0;
+    for(std::size_t i = 0; i < block.size(); ++i){
+        n += command_codec::encoded_size(command_codec::basic_cmd_response<std::string_view>{block.line(i)}, format);
+    }
+    if(n == 0) return false;
+
+    reserve_extra(n);
+    char* out = buf + used;
+    for(std::size_t i = 0; i < block.size(); ++i){
+        out = command_codec::encode_to(out, command_codec::basic_cmd_response<std::string_view>{block.line(i)}, format);
+    }
+    used += static_cast<std::uint32_t>(n);
     return !was_pending && has_pending();
 }
 
+void send_buffer::set_format(command_codec::wire_format new_format){
+    format = new_format;
+}
+
+command_codec::wire_format send_buffer::get_format() const{
+    return format;
+}
+
+bool send_buffer::append(std::string_view sv){
+    return append(sv.data(), sv.size());
+}
+
 bool send_buffer::append(const char* p, std::size_t n){
     bool was_pending = has_pending();
-    buf.append(p, n);
+    if(n == 0) return false;
+
+    reserve_extra(n);
+    std::memcpy(buf + used, p, n);
+    used += static_cast<std::uint32_t>(n);
     return !was_pending && has_pending();
 }
 
 void recv_buffer::append(const char* p, std::size_t n){
-    buf.append(p, n);
+    if(n == 0) return;
+
+    reserve_extra(n);
+    std::memcpy(buf + used, p, n);
+    used += static_cast<std::uint32_t>(n);
 }
 
 std::string recv_buffer::take_all(){
-    std::string out = std::move(buf);
-    buf.clear();
-    reset_offset();
+    std::string out(view());
+    clear();
+    release_if_done();
     return out;
 }
 
+std::size_t socket_info::heap_bytes() const noexcept{
+    std::size_t bytes = recv.heap_bytes() + send.heap_bytes() + joined_room_ids.heap_bytes();
+    std::string empty;
+    if(nickname.capacity() > empty.capacity()) bytes += nickname.capacity() + 1;
+    return bytes;
+}
+
 std::expected <std::size_t, error_code> flush_send(socket_info& si){
     if(si.tls.get() == nullptr) return std::unexpected(error_code::from_errno(EINVAL));
 
@@ -115,18 +241,23 @@ std::expected <std::size_t, error_code> flush_send(socket_info& si){
     return send_byte;
 }
 
-std::expected <recv_info, error_code> drain_recv(socket_info& si){
+std::expected <recv_info, error_code> drain_recv(socket_info& si, std::size_t cap){
     if(si.tls.get() == nullptr) return std::unexpected(error_code::from_errno(EINVAL));
 
     recv_info ret;
-    std::array <char, BUF_SIZE> tmp{};
     while(true){
-        auto rd_exp = si.tls.read(tmp.data(), tmp.size());
+        if(si.recv.remaining() >= cap){
+            ret.capped = true;
+            return ret;
+        }
+
+        std::span<char> dst = si.recv.prepare(MIN_READ_SIZE);
+        auto rd_exp = si.tls.read(dst.data(), dst.size());
         if(!rd_exp) return std::unexpected(rd_exp.error());
 
         const tls_io_result& rd = *rd_exp;
         if(rd.byte > 0){
-            si.recv.append(tmp.data(), rd.byte);
+            si.recv.commit(rd.byte);
             ret.byte += rd.byte;
             if(rd.want_read || rd.want_write) return ret;
             continue;
@@ -32,7 +32,9 @@ std::expected <void, error_code> tls_context::set_common_options(SSL_CTX* ctx){
     options |= SSL_OP_IGNORE_UNEXPECTED_EOF;
 #endif
     ::SSL_CTX_set_options(ctx, options);
-    ::SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+    ::SSL_CTX_set_mode(
+        ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER | SSL_MODE_RELEASE_BUFFERS
+    );
     return {};
 }
 
@@ -112,5 +114,12 @@ std::expected <tls_context, error_code> tls_context::create_client(std::string_v
     return tls_context(std::move(ctx), false);
 }
 
+// Applies to sessions created afterwards. With release on, an idle session
+// frees its record buffers between reads and writes instead of keeping ~34KB.
+void tls_context::set_release_buffers(bool enable) noexcept{
+    if(enable) ::SSL_CTX_set_mode(ctx.get(), SSL_MODE_RELEASE_BUFFERS);
+    else ::SSL_CTX_clear_mode(ctx.get(), SSL_MODE_RELEASE_BUFFERS);
+}
+
 SSL_CTX* tls_context::get() const noexcept{ return ctx.get(); }
 bool tls_context::is_server() const noexcept{ return server; }
@@ -1,15 +1,164 @@
 #include "protocol/command_codec.hpp"
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <cstdint>
 #include <type_traits>
+#include <utility>
+
+namespace{
+    using view_t = std::string_view;
+
+    template<class T> struct rebind_string;
+    template<template<class> class C, class S> struct rebind_string<C<S>>{
+        using owned = C<std::string>;
+        using view = C<view_t>;
+    };
+
+    template<class T, class F>
+    decltype(auto) with_fields(const T& c, F&& f){
+        static_assert(T::arity <= command_codec::MAX_ARGS);
+        if constexpr (T::arity == 0) return f();
+        else if constexpr (T::arity == 1){
+            const auto& [a] = c;
+            return f(a);
+        }
+        else if constexpr (T::arity == 2){
+            const auto& [a, b] = c;
+            return f(a, b);
+        }
+        else{
+            const auto& [a, b, d] = c;
+            return f(a, b, d);
+        }
+    }
+
+    template<class T>
+    std::expected <command_codec::command_view, error_code> decode_as(const command_codec::decode_info& info){
+        if(info.arg_count != T::arity){
+            return std::unexpected(error_code::from_decode(command_codec::decode_error::unexpected_argument));
+        }
+        if constexpr (T::arity == 0) return T{};
+        else if constexpr (T::arity == 1) return T{info.args[0]};
+        else if constexpr (T::arity == 2) return T{info.args[0], info.args[1]};
+        else return T{info.args[0], info.args[1], info.args[2]};
+    }
+
+    constexpr std::uint32_t name_hash(std::string_view name, std::uint32_t seed){
+        std::uint32_t h = 2166136261u ^ seed;
+        for(char ch : name){
+            h ^= static_cast<unsigned char>(ch);
+            h *= 16777619u;
+        }
+        return h ^ (h >> 16);
+    }
+
+    template<class V> struct command_table;
+    template<class... Ts> struct command_table<std::variant<Ts...>>{
+        static constexpr std::size_t size = sizeof...(Ts);
+        static constexpr std::size_t slots = std::bit_ceil(size * 4);
+
+        static constexpr std::array<command_codec::descriptor, size> by_index = []{
+            std::array<command_codec::descriptor, size> ret{};
+            std::size_t i = 0;
+            ((ret[i] = command_codec::descriptor{
+                Ts::name, Ts::arity, Ts::route, i, &decode_as<Ts>
+            }, ++i), ...);
+            return ret;
+        }();
+
+        static constexpr bool collision_free(std::uint32_t seed){
+            std::array<bool, slots> used{};
+            for(const auto& d : by_index){
+                std::size_t slot = name_hash(d.name, seed) & (slots - 1);
+                if(used[slot]) return false;
+                used[slot] = true;
+            }
+            return true;
+        }
+
+        static constexpr std::uint32_t seed = []{
+            for(std::uint32_t s = 0; s < 1u << 16; ++s){
+                if(collision_free(s)) return s;
+            }
+            return ~0u;
+        }();
+        static_assert(seed != ~0u, "no perfect hash seed for command names");
+
+        static constexpr std::array<const command_codec::descriptor*, slots> by_name = []{
+            std::array<const command_codec::descriptor*, slots> ret{};
+            for(const auto& d : by_index) ret[name_hash(d.name, seed) & (slots - 1)] = &d;
+            return ret;
+        }();
+    };
+
+    using table = command_table<command_codec::command_view>;
+    static_assert(table::size <= 256, "binary frames carry the command id in one byte");
+
+    std::size_t varint_size(std::size_t v){
+        std::size_t n = 1;
+        while(v >= 0x80){
+            v >>= 7;
+            ++n;
+        }
+        return n;
+    }
+
+    char* put_varint(char* out, std::size_t v){
+        while(v >= 0x80){
+            *out++ = static_cast<char>((v & 0x7f) | 0x80);
+            v >>= 7;
+        }
+        *out++ = static_cast<char>(v);
+        return out;
+    }
+
+    char* put_bytes(char* out, std::string_view sv){
+        if(!sv.empty()) std::memcpy(out, sv.data(), sv.size());
+        return out + sv.size();
+    }
+
+    // Returns the number of bytes read, 0 if data ends mid-varint.
+    std::expected <std::size_t, error_code> get_varint(std::string_view data, std::size_t& v){
+        v = 0;
+        for(std::size_t i = 0; i < data.size(); ++i){
+            if(i == 4) return std::unexpected(error_code::from_decode(command_codec::decode_error::invalid_frame));
+            const auto byte = static_cast<unsigned char>(data[i]);
+            v |= static_cast<std::size_t>(byte & 0x7f) << (7 * i);
+            if((byte & 0x80) == 0) return i + 1;
+        }
+        return 0;
+    }
+
+    void push_token(command_codec::decode_info& info, std::string_view token){
+        if(info.cmd.empty()){
+            info.cmd = token;
+            return;
+        }
+        if(info.arg_count < info.args.size()) info.args[info.arg_count] = token;
+        ++info.arg_count;
+    }
+}
 
 std::string_view command_codec::erase_delimeter(std::string_view line){
     if(!line.empty() && line.back() == '\n') line.remove_suffix(1);
     return line;
 }
 
+std::optional<std::int64_t> command_codec::parse_positive(std::string_view arg) noexcept{
+    std::int64_t value = 0;
+    const char* end = arg.data() + arg.size();
+    auto [ptr, ec] = std::from_chars(arg.data(), end, value);
+    if(ec != std::errc{} || ptr != end || value <= 0) return std::nullopt;
+    return value;
+}
+
 std::string command_codec::decode_strerror(int code){
     if(code == static_cast<int>(decode_error::empty_line)) return "empty_line";
     else if(code == static_cast<int>(decode_error::invalid_command)) return "invalid_command";
     else if(code == static_cast<int>(decode_error::unexpected_argument)) return "unexpected_argument";
+    else if(code == static_cast<int>(decode_error::invalid_frame)) return "invalid_frame";
+    else if(code == static_cast<int>(decode_error::frame_too_large)) return "frame_too_large";
     return "unknown_decode_error";
 }
 
@@ -21,18 +170,12 @@ command_codec::decode_info command_codec::decode_line(std::string_view line){
         std::size_t pos = line.find('\r', start);
         if(pos == std::string_view::npos){
             std::string_view tail = line.substr(start);
-            if(!tail.empty()){
-                if(info.cmd.empty()) info.cmd = tail;
-                else info.args.push_back(tail);
-            }
+            if(!tail.empty()) push_token(info, tail);
             break;
         }
 
         std::string_view token = line.substr(start, pos - start);
-        if(!token.empty()){
-            if(info.cmd.empty()) info.cmd = token;
-            else info.args.push_back(token);
-        }
+        if(!token.empty()) push_token(info, token);
 
         start = pos + 1;
         if(start < line.size() && line[start] == '\n') ++start;
@@ -41,156 +184,152 @@ command_codec::decode_info command_codec::decode_line(std::string_view line){
     return info;
 }
 
-std::string command_codec::encode(const command& cmd){
-    return std::visit([](const auto& c) -> std::string {
-        using T = std::decay_t<decltype(c)>;
-        if constexpr (std::is_same_v<T, cmd_nick>) return "nick\r" + c.nick + "\n";
-        if constexpr (std::is_same_v<T, cmd_say>) return "say\r" + c.room_id + "\r" + c.text + "\n";
-        if constexpr (std::is_same_v<T, cmd_response>) return "response\r" + c.text + "\n";
-        if constexpr (std::is_same_v<T, cmd_login>) return "login\r" + c.id + "\r" + c.pw + "\n";
-        if constexpr (std::is_same_v<T, cmd_register>) return "register\r" + c.id + "\r" + c.pw + "\n";
-        if constexpr (std::is_same_v<T, cmd_friend_request>) return "friend_request\r" + c.to_user_id + "\n";
-        if constexpr (std::is_same_v<T, cmd_friend_accept>) return "friend_accept\r" + c.from_user_id + "\n";
-        if constexpr (std::is_same_v<T, cmd_friend_reject>) return "friend_reject\r" + c.from_user_id + "\n";
-        if constexpr (std::is_same_v<T, cmd_friend_remove>) return "friend_remove\r" + c.friend_user_id + "\n";
-        if constexpr (std::is_same_v<T, cmd_list_friend>) return "list_friend\n";
-        if constexpr (std::is_same_v<T, cmd_list_friend_request>) return "list_friend_request\n";
-        if constexpr (std::is_same_v<T, cmd_create_room>) return "create_room\r" + c.room_name + "\n";
-        if constexpr (std::is_same_v<T, cmd_delete_room>) return "delete_room\r" + c.room_id + "\n";
-        if constexpr (std::is_same_v<T, cmd_invite_room>) return "invite_room\r" + c.room_id + "\r" + c.friend_user_id + "\n";
-        if constexpr (std::is_same_v<T, cmd_leave_room>) return "leave_room\r" + c.room_id + "\n";
-        if constexpr (std::is_same_v<T, cmd_list_room>) return "list_room\n";
-        if constexpr (std::is_same_v<T, cmd_history>) return "history\r" + c.room_id + "\r" + c.limit + "\n";
-    }, cmd);    
-}
-
-std::expected <command_codec::command, error_code> command_codec::decode(std::string_view line){
-    line = erase_delimeter(line);
-    if(line.empty()) return std::unexpected(error_code::from_decode(decode_error::empty_line));
+const command_codec::descriptor* command_codec::find_descriptor(std::string_view name) noexcept{
+    const descriptor* d = table::by_name[name_hash(name, table::seed) & (table::slots - 1)];
+    if(d == nullptr || d->name != name) return nullptr;
+    return d;
+}
 
-    decode_info info = decode_line(line);
-    if(info.cmd.empty()){
-        return std::unexpected(error_code::from_decode(decode_error::empty_line));
-    }
+const command_codec::descriptor& command_codec::descriptor_of(const command& cmd) noexcept{
+    return table::by_index[cmd.index()];
+}
 
-    if(info.cmd == "say"){
-        if(info.args.size() != 2){
-            return std::unexpected(error_code::from_decode(decode_error::unexpected_argument));
-        }
-        return cmd_say{std::string(info.args[0]), std::string(info.args[1])};
-    }
+const command_codec::descriptor& command_codec::descriptor_of(const command_view& cmd) noexcept{
+    return table::by_index[cmd.index()];
+}
 
-    if(info.cmd == "nick"){
-        if(info.args.size() != 1){
-            return std::unexpected(error_code::from_decode(decode_error::unexpected_argument));
-        }
-        return cmd_nick{std::string(info.args[0])};
-    }
+std::size_t command_codec::encoded_size(const command_view& cmd, wire_format format){
+    return std::visit([format](const auto& c) -> std::size_t {
+        using T = std::decay_t<decltype(c)>;
+        return with_fields(c, [format](const auto&... field) -> std::size_t {
+            if(format == wire_format::binary){
+                const std::size_t payload = 1 + (std::size_t{0} + ... + (varint_size(field.size()) + field.size()));
+                return varint_size(payload) + payload;
+            }
+            return T::name.size() + 1 + (std::size_t{0} + ... + (field.size() + 1));
+        });
+    }, cmd);
+}
 
-    if(info.cmd == "response"){
-        if(info.args.size() != 1){
-            return std::unexpected(error_code::from_decode(decode_error::unexpected_argument));
-        }
-        return cmd_response{std::string(info.args[0])};
-    }
+char* command_codec::encode_to(char* out, const command_view& cmd, wire_format format){
+    const std::size_t index = cmd.index();
+    return std::visit([out, format, index](const auto& c) mutable -> char* {
+        using T = std::decay_t<decltype(c)>;
+        return with_fields(c, [&out, format, index](const auto&... field) -> char* {
+            if(format == wire_format::binary){
+                const std::size_t payload = 1 + (std::size_t{0} + ... + (varint_size(field.size()) + field.size()));
+                out = put_varint(out, payload);
+                *out++ = static_cast<char>(index);
+                ((out = put_varint(out, field.size()), out = put_bytes(out, field)), ...);
+                return out;
+            }
 
-    if(info.cmd == "login"){
-        if(info.args.size() != 2){
-            return std::unexpected(error_code::from_decode(decode_error::unexpected_argument));
-        }
-        return cmd_login{std::string(info.args[0]), std::string(info.args[1])};
-    }
+            out = put_bytes(out, T::name);
+            ((*out++ = '\r', out = put_bytes(out, field)), ...);
+            *out++ = '\n';
+            return out;
+        });
+    }, cmd);
+}
 
-    if(info.cmd == "register"){
-        if(info.args.size() != 2){
-            return std::unexpected(error_code::from_decode(decode_error::unexpected_argument));
-        }
-        return cmd_register{std::string(info.args[0]), std::string(info.args[1])};
-    }
+std::string command_codec::encode(const command& cmd){
+    return encode(cmd, wire_format::text);
+}
 
-    if(info.cmd == "friend_request"){
-        if(info.args.size() != 1){
-            return std::unexpected(error_code::from_decode(decode_error::unexpected_argument));
-        }
-        return cmd_friend_request{std::string(info.args[0])};
-    }
+std::string command_codec::encode(const command& cmd, wire_format format){
+    const command_view v = view(cmd);
+    std::string wire(encoded_size(v, format), '\0');
+    encode_to(wire.data(), v, format);
+    return wire;
+}
 
-    if(info.cmd == "friend_accept"){
-        if(info.args.size() != 1){
-            return std::unexpected(error_code::from_decode(decode_error::unexpected_argument));
-        }
-        return cmd_friend_accept{std::string(info.args[0])};
-    }
+std::string_view command_codec::binary_preamble() noexcept{
+    static constexpr char preamble[] = {BINARY_MAGIC, BINARY_VERSION};
+    return std::string_view(preamble, sizeof(preamble));
+}
 
-    if(info.cmd == "friend_reject"){
-        if(info.args.size() != 1){
-            return std::unexpected(error_code::from_decode(decode_error::unexpected_argument));
-        }
-        return cmd_friend_reject{std::string(info.args[0])};
-    }
+std::expected <std::optional<command_codec::wire_format>, error_code> command_codec::detect_wire_format(
+    std::string_view data
+){
+    if(data.empty()) return std::nullopt;
+    if(data[0] != BINARY_MAGIC) return wire_format::text;
+    if(data.size() < binary_preamble().size()) return std::nullopt;
+    if(data[1] != BINARY_VERSION) return std::unexpected(error_code::from_decode(decode_error::invalid_frame));
+    return wire_format::binary;
+}
 
-    if(info.cmd == "friend_remove"){
-        if(info.args.size() != 1){
-            return std::unexpected(error_code::from_decode(decode_error::unexpected_argument));
-        }
-        return cmd_friend_remove{std::string(info.args[0])};
-    }
+std::expected <std::size_t, error_code> command_codec::read_binary_frame(
+    std::string_view data, std::string_view& payload, std::size_t max_size
+){
+    std::size_t len = 0;
+    auto hdr_exp = get_varint(data, len);
+    if(!hdr_exp) return std::unexpected(hdr_exp.error());
+    if(*hdr_exp == 0) return 0;
+    if(len == 0) return std::unexpected(error_code::from_decode(decode_error::invalid_frame));
+    if(len > max_size) return std::unexpected(error_code::from_decode(decode_error::frame_too_large));
+    if(data.size() - *hdr_exp < len) return 0;
 
-    if(info.cmd == "list_friend"){
-        if(!info.args.empty()){
-            return std::unexpected(error_code::from_decode(decode_error::unexpected_argument));
-        }
-        return cmd_list_friend{};
-    }
+    payload = data.substr(*hdr_exp, len);
+    return *hdr_exp + len;
+}
 
-    if(info.cmd == "list_friend_request"){
-        if(!info.args.empty()){
-            return std::unexpected(error_code::from_decode(decode_error::unexpected_argument));
-        }
-        return cmd_list_friend_request{};
-    }
+std::expected <command_codec::command_view, error_code> command_codec::decode_binary(std::string_view payload){
+    if(payload.empty()) return std::unexpected(error_code::from_decode(decode_error::empty_line));
 
-    if(info.cmd == "create_room"){
-        if(info.args.size() != 1){
-            return std::unexpected(error_code::from_decode(decode_error::unexpected_argument));
-        }
-        return cmd_create_room{std::string(info.args[0])};
-    }
+    const auto id = static_cast<unsigned char>(payload[0]);
+    if(id >= table::size) return std::unexpected(error_code::from_decode(decode_error::invalid_command));
+    const descriptor& d = table::by_index[id];
 
-    if(info.cmd == "delete_room"){
-        if(info.args.size() != 1){
-            return std::unexpected(error_code::from_decode(decode_error::unexpected_argument));
+    decode_info info{};
+    info.cmd = d.name;
+    std::size_t pos = 1;
+    while(pos < payload.size()){
+        std::size_t len = 0;
+        auto hdr_exp = get_varint(payload.substr(pos), len);
+        if(!hdr_exp) return std::unexpected(hdr_exp.error());
+        if(*hdr_exp == 0 || payload.size() - pos - *hdr_exp < len){
+            return std::unexpected(error_code::from_decode(decode_error::invalid_frame));
         }
-        return cmd_delete_room{std::string(info.args[0])};
-    }
 
-    if(info.cmd == "invite_room"){
-        if(info.args.size() != 2){
-            return std::unexpected(error_code::from_decode(decode_error::unexpected_argument));
-        }
-        return cmd_invite_room{std::string(info.args[0]), std::string(info.args[1])};
+        pos += *hdr_exp;
+        if(info.arg_count < info.args.size()) info.args[info.arg_count] = payload.substr(pos, len);
+        ++info.arg_count;
+        pos += len;
     }
+    return d.decode(info);
+}
 
-    if(info.cmd == "leave_room"){
-        if(info.args.size() != 1){
-            return std::unexpected(error_code::from_decode(decode_error::unexpected_argument));
-        }
-        return cmd_leave_room{std::string(info.args[0])};
-    }
+std::expected <command_codec::command_view, error_code> command_codec::decode(std::string_view line){
+    line = erase_delimeter(line);
+    if(line.empty()) return std::unexpected(error_code::from_decode(decode_error::empty_line));
 
-    if(info.cmd == "list_room"){
-        if(!info.args.empty()){
-            return std::unexpected(error_code::from_decode(decode_error::unexpected_argument));
-        }
-        return cmd_list_room{};
-    }
+    return decode(decode_line(line));
+}
 
-    if(info.cmd == "history"){
-        if(info.args.size() != 2){
-            return std::unexpected(error_code::from_decode(decode_error::unexpected_argument));
-        }
-        return cmd_history{std::string(info.args[0]), std::string(info.args[1])};
+std::expected <command_codec::command_view, error_code> command_codec::decode(const decode_info& info){
+    if(info.cmd.empty()){
+        return std::unexpected(error_code::from_decode(decode_error::empty_line));
     }
 
-    return std::unexpected(error_code::from_decode(decode_error::invalid_command));
+    const descriptor* d = find_descriptor(info.cmd);
+    if(d == nullptr) return std::unexpected(error_code::from_decode(decode_error::invalid_command));
+    return d->decode(info);
+}
+
+command_codec::command_view command_codec::view(const command& cmd){
+    return std::visit([](const auto& c) -> command_view {
+        using borrowed_t = typename rebind_string<std::decay_t<decltype(c)>>::view;
+        return with_fields(c, [](const auto&... field){
+            return borrowed_t{std::string_view(field)...};
+        });
+    }, cmd);
+}
+
+command_codec::command command_codec::materialize(const command_view& cmd){
+    return std::visit([](const auto& c) -> command {
+        using owned_t = typename rebind_string<std::decay_t<decltype(c)>>::owned;
+        return with_fields(c, [](const auto&... field){
+            return owned_t{std::string(field)...};
+        });
+    }, cmd);
 }
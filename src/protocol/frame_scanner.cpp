@@ -0,0 +1,177 @@
+#include "protocol/frame_scanner.hpp"
+#include <array>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FRAME_SCANNER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace{
+    constexpr std::size_t DELIM_CAP = 256;
+
+    // Kernels record delimiter offsets into out until cap is reached, data
+    // runs out, or max_lines '\n' have been seen, and report how far they got.
+    using kernel_fn = std::size_t (*)(
+        const char* data, std::size_t len, std::uint32_t* out, std::size_t cap,
+        std::size_t max_lines, std::size_t& scanned
+    );
+
+    std::size_t scan_tail(
+        const char* data, std::size_t i, std::size_t len, std::uint32_t* out, std::size_t count,
+        std::size_t cap, std::size_t lines, std::size_t max_lines, std::size_t& scanned
+    ){
+        for(; i < len && count < cap && lines < max_lines; ++i){
+            if(data[i] == '\n') ++lines;
+            else if(data[i] != '\r') continue;
+            out[count++] = static_cast<std::uint32_t>(i);
+        }
+        scanned = i;
+        return count;
+    }
+
+    std::size_t scan_scalar(
+        const char* data, std::size_t len, std::uint32_t* out, std::size_t cap,
+        std::size_t max_lines, std::size_t& scanned
+    ){
+        return scan_tail(data, 0, len, out, 0, cap, 0, max_lines, scanned);
+    }
+
+#ifdef FRAME_SCANNER_X86
+    std::size_t emit_mask(std::uint32_t mask, std::size_t base, std::uint32_t* out, std::size_t count){
+        while(mask != 0){
+            out[count++] = static_cast<std::uint32_t>(base + static_cast<std::size_t>(__builtin_ctz(mask)));
+            mask &= mask - 1;
+        }
+        return count;
+    }
+
+    std::size_t scan_sse2(
+        const char* data, std::size_t len, std::uint32_t* out, std::size_t cap,
+        std::size_t max_lines, std::size_t& scanned
+    ){
+        const __m128i lf = _mm_set1_epi8('\n');
+        const __m128i cr = _mm_set1_epi8('\r');
+        std::size_t count = 0;
+        std::size_t lines = 0;
+        std::size_t i = 0;
+        for(; i + 16 <= len && count + 16 <= cap && lines < max_lines; i += 16){
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            __m128i lf_hit = _mm_cmpeq_epi8(v, lf);
+            __m128i hit = _mm_or_si128(lf_hit, _mm_cmpeq_epi8(v, cr));
+            lines += static_cast<std::size_t>(__builtin_popcount(_mm_movemask_epi8(lf_hit)));
+            count = emit_mask(static_cast<std::uint32_t>(_mm_movemask_epi8(hit)), i, out, count);
+        }
+        return scan_tail(data, i, len, out, count, cap, lines, max_lines, scanned);
+    }
+
+    __attribute__((target("avx2")))
+    std::size_t scan_avx2(
+        const char* data, std::size_t len, std::uint32_t* out, std::size_t cap,
+        std::size_t max_lines, std::size_t& scanned
+    ){
+        const __m256i lf = _mm256_set1_epi8('\n');
+        const __m256i cr = _mm256_set1_epi8('\r');
+        std::size_t count = 0;
+        std::size_t lines = 0;
+        std::size_t i = 0;
+        for(; i + 32 <= len && count + 32 <= cap && lines < max_lines; i += 32){
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            __m256i lf_hit = _mm256_cmpeq_epi8(v, lf);
+            __m256i hit = _mm256_or_si256(lf_hit, _mm256_cmpeq_epi8(v, cr));
+            lines += static_cast<std::size_t>(
+                __builtin_popcount(static_cast<std::uint32_t>(_mm256_movemask_epi8(lf_hit)))
+            );
+            count = emit_mask(static_cast<std::uint32_t>(_mm256_movemask_epi8(hit)), i, out, count);
+        }
+        return scan_tail(data, i, len, out, count, cap, lines, max_lines, scanned);
+    }
+#endif
+
+    kernel_fn kernel_for(frame_scanner::scan_isa isa) noexcept{
+#ifdef FRAME_SCANNER_X86
+        if(isa == frame_scanner::scan_isa::avx2) return scan_avx2;
+        if(isa == frame_scanner::scan_isa::sse2) return scan_sse2;
+#endif
+        return scan_scalar;
+    }
+
+    frame_scanner::scan_isa detect_isa() noexcept{
+#ifdef FRAME_SCANNER_X86
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2")) return frame_scanner::scan_isa::avx2;
+        if(__builtin_cpu_supports("sse2")) return frame_scanner::scan_isa::sse2;
+#endif
+        return frame_scanner::scan_isa::scalar;
+    }
+
+    void push_token(command_codec::decode_info& info, std::string_view token){
+        if(token.empty()) return;
+        if(info.cmd.empty()){
+            info.cmd = token;
+            return;
+        }
+        if(info.arg_count < info.args.size()) info.args[info.arg_count] = token;
+        ++info.arg_count;
+    }
+}
+
+frame_scanner::scan_isa frame_scanner::active_isa() noexcept{
+    static const scan_isa isa = detect_isa();
+    return isa;
+}
+
+bool frame_scanner::isa_supported(scan_isa isa) noexcept{
+    return static_cast<int>(isa) <= static_cast<int>(active_isa());
+}
+
+std::string_view frame_scanner::isa_name(scan_isa isa) noexcept{
+    if(isa == scan_isa::avx2) return "avx2";
+    if(isa == scan_isa::sse2) return "sse2";
+    return "scalar";
+}
+
+std::size_t frame_scanner::scan(std::string_view data, std::span<frame> out, std::size_t& consumed){
+    return scan(data, out, consumed, active_isa());
+}
+
+std::size_t frame_scanner::scan(
+    std::string_view data, std::span<frame> out, std::size_t& consumed, scan_isa isa
+){
+    consumed = 0;
+    if(out.empty() || data.empty()) return 0;
+
+    const kernel_fn kernel = kernel_for(isa);
+    std::array<std::uint32_t, DELIM_CAP> delims;
+    std::size_t count = 0;
+    std::size_t pos = 0;
+    std::size_t frame_start = 0;
+    std::size_t token_start = 0;
+    out[0] = frame{};
+
+    while(pos < data.size()){
+        std::size_t scanned = 0;
+        std::size_t found = kernel(
+            data.data() + pos, data.size() - pos, delims.data(), delims.size(), out.size() - count, scanned
+        );
+
+        for(std::size_t k = 0; k < found; ++k){
+            const std::size_t at = pos + delims[k];
+            push_token(out[count].info, data.substr(token_start, at - token_start));
+            token_start = at + 1;
+            if(data[at] == '\r') continue;
+
+            out[count].line = data.substr(frame_start, at - frame_start);
+            frame_start = token_start;
+            if(++count == out.size()){
+                consumed = frame_start;
+                return count;
+            }
+            out[count] = frame{};
+        }
+        pos += scanned;
+    }
+
+    consumed = frame_start;
+    return count;
+}
@@ -6,16 +6,41 @@ bool line_parser::has_line(std::string_view recv_buf){
 }
 
 bool line_parser::has_line(const offset_buffer& recv_buf){
-    return recv_buf.raw().find('\n', recv_buf.get_offset()) != std::string::npos;
+    return recv_buf.view().find('\n', recv_buf.get_offset()) != std::string_view::npos;
 }
 
-std::optional<std::string> line_parser::parse_line(offset_buffer& buf){
+std::optional<std::string_view> line_parser::parse_line(offset_buffer& buf){
+    if(!buf.clear_if_done()) buf.compact_if_needed();
+
     const std::size_t start = buf.get_offset();
-    std::size_t pos = buf.raw().find('\n', start);
-    if(pos == std::string::npos) return std::nullopt;
+    std::size_t pos = buf.view().find('\n', start);
+    if(pos == std::string_view::npos) return std::nullopt;
 
-    std::string line = buf.raw().substr(start, pos - start);
     buf.set_offset(pos + 1);
+    return buf.view().substr(start, pos - start);
+}
+
+std::size_t line_parser::parse_frames(offset_buffer& buf, std::span<frame_scanner::frame> out){
+    if(!buf.clear_if_done()) buf.compact_if_needed();
+
+    std::size_t consumed = 0;
+    std::size_t count = frame_scanner::scan(buf.view().substr(buf.get_offset()), out, consumed);
+    buf.advance(consumed);
+    return count;
+}
+
+std::expected <std::optional<std::string_view>, error_code> line_parser::parse_binary_frame(
+    offset_buffer& buf, std::size_t max_size
+){
     if(!buf.clear_if_done()) buf.compact_if_needed();
-    return line;
+
+    std::string_view payload;
+    auto frame_exp = command_codec::read_binary_frame(
+        buf.view().substr(buf.get_offset()), payload, max_size
+    );
+    if(!frame_exp) return std::unexpected(frame_exp.error());
+    if(*frame_exp == 0) return std::nullopt;
+
+    buf.advance(*frame_exp);
+    return payload;
 }
@@ -0,0 +1,20 @@
+#include "protocol/response_block.hpp"
+
+void response_block::push(std::initializer_list<std::string_view> parts){
+    for(std::string_view part : parts) text += part;
+    ends.push_back(static_cast<std::uint32_t>(text.size()));
+}
+
+std::size_t response_block::size() const noexcept{ return ends.size(); }
+std::size_t response_block::text_bytes() const noexcept{ return text.size(); }
+bool response_block::empty() const noexcept{ return ends.empty(); }
+
+std::string_view response_block::line(std::size_t i) const noexcept{
+    const std::uint32_t begin = i == 0 ? 0 : ends[i - 1];
+    return std::string_view(text).substr(begin, ends[i] - begin);
+}
+
+void response_block::clear() noexcept{
+    text.clear();
+    ends.clear();
+}
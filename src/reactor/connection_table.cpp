@@ -0,0 +1,61 @@
+#include "reactor/connection_table.hpp"
+
+connection_table::slot* connection_table::slot_at(int fd) noexcept{
+    if(fd < 0) return nullptr;
+    const std::size_t idx = static_cast<std::size_t>(fd);
+    const std::size_t c = idx >> CHUNK_BITS;
+    if(c >= chunks.size() || chunks[c] == nullptr) return nullptr;
+    return &(*chunks[c])[idx & (CHUNK_SIZE - 1)];
+}
+
+const connection_table::slot* connection_table::slot_at(int fd) const noexcept{
+    return const_cast<connection_table*>(this)->slot_at(fd);
+}
+
+socket_info& connection_table::insert(int fd, socket_info si){
+    const std::size_t idx = static_cast<std::size_t>(fd);
+    const std::size_t c = idx >> CHUNK_BITS;
+    if(c >= chunks.size()) chunks.resize(c + 1);
+    if(chunks[c] == nullptr) chunks[c] = std::make_unique<chunk>();
+
+    slot& s = (*chunks[c])[idx & (CHUNK_SIZE - 1)];
+    if(++s.gen == 0) s.gen = 1;
+    si.handle = conn_handle{fd, s.gen};
+    s.si.emplace(std::move(si));
+    ++count;
+    return *s.si;
+}
+
+void connection_table::erase(int fd) noexcept{
+    slot* s = slot_at(fd);
+    if(s == nullptr || !s->si) return;
+    s->si.reset();
+    --count;
+}
+
+socket_info* connection_table::find(int fd) noexcept{
+    slot* s = slot_at(fd);
+    if(s == nullptr || !s->si) return nullptr;
+    return &*s->si;
+}
+
+socket_info* connection_table::find(conn_handle handle) noexcept{
+    slot* s = slot_at(handle.fd);
+    if(s == nullptr || !s->si || s->gen != handle.gen) return nullptr;
+    return &*s->si;
+}
+
+bool connection_table::contains(int fd) const noexcept{
+    const slot* s = slot_at(fd);
+    return s != nullptr && s->si.has_value();
+}
+
+std::size_t connection_table::size() const noexcept{ return count; }
+
+std::size_t connection_table::capacity_bytes() const noexcept{
+    std::size_t bytes = chunks.capacity() * sizeof(chunks[0]);
+    for(const auto& c : chunks){
+        if(c != nullptr) bytes += sizeof(chunk);
+    }
+    return bytes;
+}
@@ -1,12 +1,43 @@
 #include "reactor/epoll_registry.hpp"
+#include "cluster/node_bus.hpp"
 #include "core/logger.hpp"
 #include "net/tls_context.hpp"
 #include "reactor/epoll_utility.hpp"
+#include <algorithm>
 #include <cerrno>
+#include <cstring>
+#include <utility>
 #include <sys/epoll.h>
 
-epoll_registry::epoll_registry(epoll_wakeup wakeup, tls_context& tls_ctx) :
-    epoll_wakeup(std::move(wakeup)), tls_ctx(tls_ctx){}
+namespace{
+    // One outgoing command for a whole fan-out, encoded at most once per wire
+    // format into the registry's batch arena.
+    class fanout_payload{
+        command_codec::command_view cmd;
+        std::pmr::memory_resource& arena;
+        std::array<std::string_view, 2> wire{};
+    public:
+        fanout_payload(command_codec::command_view cmd, std::pmr::memory_resource& arena) :
+            cmd(cmd), arena(arena){}
+
+        std::string_view for_format(command_codec::wire_format format){
+            std::string_view& out = wire[static_cast<std::size_t>(format)];
+            if(out.empty()){
+                const std::size_t n = command_codec::encoded_size(cmd, format);
+                char* p = static_cast<char*>(arena.allocate(n, 1));
+                command_codec::encode_to(p, cmd, format);
+                out = std::string_view(p, n);
+            }
+            return out;
+        }
+    };
+}
+
+epoll_registry::epoll_registry(
+    epoll_wakeup wakeup, tls_context& tls_ctx, send_limits send_lim, recv_limits recv_lim, conn_timeouts timeouts,
+    presence_options presence_opts
+) : epoll_wakeup(std::move(wakeup)), tls_ctx(tls_ctx),
+    send_lim(send_lim), recv_lim(recv_lim), timeouts(timeouts), presence_opts(presence_opts){}
 
 std::expected <int, error_code> epoll_registry::register_fd(unique_fd client_fd, uint32_t interest){
     int fd = client_fd.get();
@@ -32,37 +63,36 @@ std::expected <int, error_code> epoll_registry::register_fd(unique_fd client_fd,
         return std::unexpected(ep_exp.error());
     }
 
-    auto init_str_exp = ep_exp->init_string();
-    if(!init_str_exp){
-        logger::log_error("init_string failed", "epoll_registry::register_fd()", init_str_exp);
-        return std::unexpected(init_str_exp.error());
-    }
-
-    auto add_ep_exp = epoll_utility::add_fd(epfd.get(), fd, interest);
-    if(!add_ep_exp){
-        logger::log_error("add_fd failed", "epoll_registry::register_fd()", add_ep_exp);
-        return std::unexpected(add_ep_exp.error());
-    }
-
     auto tls_exp = tls_session::create_server(tls_ctx, fd);
     if(!tls_exp){
         logger::log_error("tls_session create failed", "epoll_registry::register_fd()", tls_exp);
         return std::unexpected(tls_exp.error());
     }
-    
-    auto [it, inserted] = infos.emplace(
+
+    socket_info& si = infos.insert(
         fd,
         socket_info{
             .tls = std::move(*tls_exp),
-            .interest = interest,
             .ufd = std::move(client_fd),
-            .ep = std::move(*ep_exp)
+            .interest = interest,
+            .ep = *ep_exp
         }
     );
-    (void)inserted;
+
+    auto add_ep_exp = epoll_utility::add_fd(epfd.get(), fd, interest, si.handle.pack());
+    if(!add_ep_exp){
+        logger::log_error("add_fd failed", "epoll_registry::register_fd()", add_ep_exp);
+        infos.erase(fd);
+        return std::unexpected(add_ep_exp.error());
+    }
+
+    const auto now = timer_wheel::clock::now();
+    si.connected_at = now;
+    si.last_recv_at = now;
+    arm_timer(si);
 
     connected_client_count = infos.size();
-    logger::log_info("is connected", it->second);
+    logger::log_info("is connected", si);
     logger::log_info("active clients: " + std::to_string(connected_client_count));
     return fd;
 }
@@ -73,129 +103,416 @@ std::expected <void, error_code> epoll_registry::unregister_fd(int fd){
         return std::unexpected(error_code::from_errno(EINVAL));
     }
 
-    auto it = infos.find(fd);
-    if(it == infos.end()) return {};
+    socket_info* si = infos.find(fd);
+    if(si == nullptr) return {};
 
     auto del_ep_exp = epoll_utility::del_fd(epfd.get(), fd);
     if(!del_ep_exp){
         const error_code& ec = del_ep_exp.error();
         bool ignorable = ec.domain == error_domain::errno_domain
             && (ec.code == ENOENT || ec.code == EBADF);
-        if(!ignorable) logger::log_error("del_fd failed", "epoll_registry::unregister_fd()", it->second, del_ep_exp);
+        if(!ignorable) logger::log_error("del_fd failed", "epoll_registry::unregister_fd()", *si, del_ep_exp);
     }
 
-    remove_fd_from_room_index(it->second);
-    remove_fd_from_user_index(it->second);
-    infos.erase(it);
+    remove_fd_from_room_index(*si);
+    remove_fd_from_user_index(*si);
+    pending_send_total -= std::min(pending_send_total, si->send.remaining());
+    infos.erase(fd);
     connected_client_count = infos.size();
     logger::log_info("active clients: " + std::to_string(connected_client_count));
     return {};
 }
 
+// Callers may still hold si or iterate a container that unregister_fd()
+// edits, so a failed update closes the connection and defers the removal.
 std::expected <void, error_code> epoll_registry::sync_interest(socket_info& si){
-    int fd = si.ufd.get();
     auto mod_exp = epoll_utility::update_interest(epfd.get(), si, si.interest);
     if(!mod_exp){
-        unregister_fd(fd);
+        si.is_closed = true;
+        request_unregister(si);
         return std::unexpected(mod_exp.error());
     }
     return {};
 }
 
+bool epoll_registry::drop_send(socket_info& si, bool droppable){
+    if(!droppable || (!si.send_throttled && pending_send_total < send_lim.global_budget)) return false;
+
+    ++si.dropped_sends;
+    ++dropped_send_total;
+    return true;
+}
+
 std::expected <void, error_code> epoll_registry::append_send(
     socket_info& si,
-    const command_codec::command& cmd
+    const command_codec::command& cmd,
+    bool droppable
 ){
-    if(!si.send.append(cmd)) return {};
+    if(drop_send(si, droppable)) return {};
+
+    const std::size_t before = si.send.remaining();
+    return finish_append(si, before, si.send.append(cmd));
+}
+
+std::expected <void, error_code> epoll_registry::append_wire(socket_info& si, std::string_view wire, bool droppable){
+    if(drop_send(si, droppable)) return {};
+
+    const std::size_t before = si.send.remaining();
+    return finish_append(si, before, si.send.append(wire));
+}
+
+std::expected <void, error_code> epoll_registry::finish_append(
+    socket_info& si, std::size_t before, bool became_pending
+){
+    pending_send_total += si.send.remaining() - before;
+    if(si.send.remaining() > send_lim.high_watermark) throttle_send(si);
+    if(!became_pending) return {};
+
+    si.last_send_at = timer_wheel::clock::now();
+    arm_timer(si);
 
     si.interest |= EPOLLOUT;
     auto sync_exp = sync_interest(si);
     if(!sync_exp){
-        logger::log_warn("sync_interest failed", "epoll_registry::append_send()", si, sync_exp);
+        logger::log_warn("sync_interest failed", "epoll_registry::finish_append()", si, sync_exp);
         return std::unexpected(sync_exp.error());
     }
 
     return {};
 }
 
+void epoll_registry::throttle_send(socket_info& si){
+    if(si.send_throttled) return;
+
+    si.send_throttled = true;
+    si.throttled_since = timer_wheel::clock::now();
+    arm_timer(si);
+    logger::log_warn(
+        "send buffer over high watermark: " + std::to_string(si.send.remaining()) + " bytes",
+        "epoll_registry::throttle_send()", si, error_code::from_errno(ENOBUFS)
+    );
+}
+
+timer_wheel::clock::time_point epoll_registry::next_deadline(const socket_info& si) const{
+    auto deadline = timer_wheel::clock::time_point::max();
+    auto earliest = [&deadline](timer_wheel::clock::time_point since, std::chrono::milliseconds timeout){
+        if(timeout.count() > 0) deadline = std::min(deadline, since + timeout);
+    };
+
+    if(!si.tls.is_handshake_done()) earliest(si.connected_at, timeouts.handshake);
+    else{
+        earliest(si.last_recv_at, timeouts.idle);
+        if(si.ping_sent_at < si.last_recv_at) earliest(si.last_recv_at, timeouts.heartbeat);
+    }
+    if(si.send.has_pending()) earliest(si.last_send_at, timeouts.write_stall);
+    if(si.send_throttled) earliest(si.throttled_since, send_lim.stall_timeout);
+    return deadline;
+}
+
+const char* epoll_registry::expired_timeout(const socket_info& si, timer_wheel::clock::time_point now) const{
+    auto expired = [now](timer_wheel::clock::time_point since, std::chrono::milliseconds timeout){
+        return timeout.count() > 0 && now - since >= timeout;
+    };
+
+    if(!si.tls.is_handshake_done()){
+        if(expired(si.connected_at, timeouts.handshake)) return "tls handshake timeout";
+    }
+    else if(expired(si.last_recv_at, timeouts.idle)) return "idle timeout";
+    if(si.send.has_pending() && expired(si.last_send_at, timeouts.write_stall)) return "write stall timeout";
+    if(si.send_throttled && expired(si.throttled_since, send_lim.stall_timeout)) return "slow consumer evicted";
+    return nullptr;
+}
+
+bool epoll_registry::heartbeat_due(const socket_info& si, timer_wheel::clock::time_point now) const{
+    if(timeouts.heartbeat.count() <= 0 || !si.tls.is_handshake_done()) return false;
+    return si.ping_sent_at < si.last_recv_at && now - si.last_recv_at >= timeouts.heartbeat;
+}
+
+// Pings due in the same tick go out in one pass and are written directly;
+// EPOLLOUT is only armed for a connection whose socket would block.
+void epoll_registry::send_heartbeats(const std::vector<int>& fds){
+    const command_codec::command ping = command_codec::cmd_ping{};
+    for(int fd : fds){
+        socket_info* found = infos.find(fd);
+        if(found == nullptr || found->is_closed) continue;
+        auto& si = *found;
+
+        const bool had_pending = si.send.has_pending();
+        const std::size_t before = si.send.remaining();
+        si.send.append(ping);
+        pending_send_total += si.send.remaining() - before;
+        if(had_pending) continue;
+
+        auto fs_exp = flush_send(si);
+        if(!fs_exp){
+            logger::log_warn("heartbeat flush failed", "epoll_registry::send_heartbeats()", si, fs_exp);
+            auto unreg_exp = unregister_fd(fd);
+            continue;
+        }
+        note_flushed(si, *fs_exp);
+        if(!si.send.has_pending() && !si.tls.needs_write()) continue;
+
+        si.last_send_at = timer_wheel::clock::now();
+        si.interest |= EPOLLOUT;
+        auto sync_exp = sync_interest(si);
+        if(!sync_exp){
+            logger::log_warn("sync_interest failed", "epoll_registry::send_heartbeats()", sync_exp);
+            continue;
+        }
+        arm_timer(si);
+    }
+    logger::log_debug("heartbeat sent to " + std::to_string(fds.size()) + " connections");
+}
+
+// Deadlines only move by writing the timestamps in socket_info; a wheel entry
+// is added only when the next deadline becomes earlier than the armed one.
+void epoll_registry::arm_timer(socket_info& si){
+    const auto deadline = next_deadline(si);
+    if(deadline >= si.timer_at) return;
+
+    si.timer_at = deadline;
+    timers.schedule(si.ufd.get(), deadline);
+}
+
+int epoll_registry::next_timeout_ms() const{
+    const auto now = timer_wheel::clock::now();
+    const int timer_ms = timers.timeout_ms(now);
+    if(presence_flush_at == timer_wheel::clock::time_point::max()) return timer_ms;
+
+    const auto left = std::chrono::ceil<std::chrono::milliseconds>(presence_flush_at - now).count();
+    const int presence_ms = static_cast<int>(std::max<std::int64_t>(left, 0));
+    return timer_ms < 0 ? presence_ms : std::min(timer_ms, presence_ms);
+}
+
+void epoll_registry::expire_timers(){
+    const auto now = timer_wheel::clock::now();
+    if(presence_flush_at <= now) flush_presence();
+
+    std::vector<int> fds;
+    timers.advance(now, fds);
+    if(fds.empty()) return;
+
+    std::vector<int> ping_fds;
+
+    for(int fd : fds){
+        socket_info* found = infos.find(fd);
+        if(found == nullptr) continue;
+        auto& si = *found;
+        if(si.is_closed || si.timer_at > now) continue;
+
+        si.timer_at = timer_wheel::clock::time_point::max();
+        const char* reason = expired_timeout(si, now);
+        if(reason == nullptr){
+            if(heartbeat_due(si, now)){
+                si.ping_sent_at = now;
+                ping_fds.push_back(fd);
+            }
+            arm_timer(si);
+            continue;
+        }
+
+        logger::log_warn(
+            std::string(reason) + ": " + std::to_string(si.send.remaining()) + " bytes pending, "
+                + std::to_string(si.dropped_sends) + " dropped",
+            "epoll_registry::expire_timers()", si, error_code::from_errno(ETIMEDOUT)
+        );
+        auto unreg_exp = unregister_fd(fd);
+    }
+
+    if(!ping_fds.empty()) send_heartbeats(ping_fds);
+}
+
+void epoll_registry::note_recv(socket_info& si){ si.last_recv_at = timer_wheel::clock::now(); }
+
+void epoll_registry::note_handshake_done(socket_info& si){
+    si.last_recv_at = timer_wheel::clock::now();
+    arm_timer(si);
+}
+
+void epoll_registry::reply(socket_info& si, const command_codec::command& cmd){
+    auto append_exp = append_send(si, cmd);
+    if(!append_exp) return;
+}
+
+void epoll_registry::reply(socket_info& si, const response_block& block){
+    const std::size_t before = si.send.remaining();
+    auto append_exp = finish_append(si, before, si.send.append(block));
+    if(!append_exp) return;
+}
+
+void epoll_registry::note_flushed(socket_info& si, std::size_t byte){
+    pending_send_total -= std::min(pending_send_total, byte);
+    if(byte > 0) si.last_send_at = timer_wheel::clock::now();
+    if(send_lim.release_drained) si.send.release_if_done();
+    if(!si.send_throttled || si.send.remaining() > send_lim.low_watermark) return;
+
+    si.send_throttled = false;
+    if(si.dropped_sends == 0) return;
+
+    const std::size_t dropped = si.dropped_sends;
+    si.dropped_sends = 0;
+    auto append_exp = append_send(
+        si, command_codec::cmd_response{"[" + std::to_string(dropped) + " messages dropped]"}
+    );
+}
+
+std::size_t epoll_registry::pending_send_bytes() const noexcept{ return pending_send_total; }
+std::size_t epoll_registry::dropped_send_count() const noexcept{ return dropped_send_total; }
+
+std::size_t conn_memory_report::total() const noexcept{
+    return table_bytes + buffer_bytes + user_id_bytes + index_bytes;
+}
+
+std::size_t conn_memory_report::per_connection() const noexcept{
+    return connections == 0 ? 0 : total() / connections;
+}
+
+conn_memory_report epoll_registry::memory_report() const{
+    // Index entries are estimated as one hash node (value + next pointer +
+    // cached hash) plus their share of the bucket array.
+    constexpr std::size_t node_bytes = sizeof(void*) * 3;
+
+    conn_memory_report report;
+    report.connections = infos.size();
+    report.table_bytes = infos.capacity_bytes();
+    infos.for_each([&report](const socket_info& si){ report.buffer_bytes += si.heap_bytes(); });
+
+    std::string empty;
+    for(const auto& [user_id, fds] : user_online_fds){
+        report.user_id_bytes += sizeof(std::string) + node_bytes;
+        if(user_id.capacity() > empty.capacity()) report.user_id_bytes += user_id.capacity() + 1;
+        report.index_bytes += fds.size() * node_bytes + fds.bucket_count() * sizeof(void*);
+    }
+    for(const auto& [room_id, members] : room_online_fds){
+        report.index_bytes += node_bytes + members.heap_bytes();
+    }
+    return report;
+}
+const recv_limits& epoll_registry::get_recv_limits() const noexcept{ return recv_lim; }
+
+const presence_options& epoll_registry::get_presence_options() const noexcept{ return presence_opts; }
+
+void epoll_registry::update_recv_interest(socket_info& si){
+    const bool pause = si.inflight_db >= recv_lim.max_inflight_db;
+    if(pause == si.recv_paused){
+        if(!pause && si.recv_capped) ready_fds.push_back(si.ufd.get());
+        return;
+    }
+
+    const uint32_t next_interest = pause ? (si.interest & ~EPOLLIN) : (si.interest | EPOLLIN);
+    auto mod_exp = epoll_utility::update_interest(epfd.get(), si, next_interest);
+    if(!mod_exp){
+        logger::log_warn("update_interest failed", "epoll_registry::update_recv_interest()", si, mod_exp);
+        si.is_closed = true;
+        request_unregister(si);
+        return;
+    }
+
+    si.recv_paused = pause;
+    if(pause){
+        logger::log_info("recv paused: " + std::to_string(si.inflight_db) + " db commands in flight", si);
+        return;
+    }
+
+    logger::log_info("recv resumed", si);
+    ready_fds.push_back(si.ufd.get());
+}
+
+bool epoll_registry::has_ready_fds() const noexcept{ return !ready_fds.empty(); }
+
+std::vector<int> epoll_registry::take_ready_fds(){
+    std::vector<int> fds;
+    std::swap(fds, ready_fds);
+    return fds;
+}
+
 void epoll_registry::request_register(unique_fd fd, uint32_t interest){ 
     {
         std::lock_guard<std::mutex> lock(cmd_mtx);
-        cmd_q.emplace(register_command{std::move(fd), interest});
+        cmd_q.emplace_back(register_command{std::move(fd), interest});
     }
     request_wakeup();
 }
 
-void epoll_registry::request_unregister(int fd){ 
+void epoll_registry::request_unregister(conn_handle conn){
     {
         std::lock_guard<std::mutex> lock(cmd_mtx);
-        cmd_q.emplace(unregister_command{fd});
+        cmd_q.emplace_back(unregister_command{conn});
     }
     request_wakeup();
 }
 
 void epoll_registry::request_unregister(socket_info& si){
-    request_unregister(si.ufd.get());
+    request_unregister(si.handle);
 }
 
-void epoll_registry::request_send(int fd, command_codec::command cmd){ 
+void epoll_registry::request_send(conn_handle conn, command_codec::command cmd){
     {
         std::lock_guard<std::mutex> lock(cmd_mtx);
-        cmd_q.emplace(send_one_command{fd, std::move(cmd)});
+        cmd_q.emplace_back(send_one_command{conn, std::move(cmd)});
     }
     request_wakeup();
 }
 
 void epoll_registry::request_send(socket_info& si, command_codec::command cmd){
-    request_send(si.ufd.get(), std::move(cmd));
+    request_send(si.handle, std::move(cmd));
 }
 
-void epoll_registry::request_broadcast(int send_fd, command_codec::command cmd){ 
+void epoll_registry::request_send_block(conn_handle conn, response_block block){
+    if(block.empty()) return;
     {
         std::lock_guard<std::mutex> lock(cmd_mtx);
-        cmd_q.emplace(broadcast_command{send_fd, std::move(cmd)});
+        cmd_q.emplace_back(send_block_command{conn, std::move(block)});
+    }
+    request_wakeup();
+}
+
+void epoll_registry::request_broadcast(conn_handle sender, command_codec::command cmd){
+    {
+        std::lock_guard<std::mutex> lock(cmd_mtx);
+        cmd_q.emplace_back(broadcast_command{sender, std::move(cmd)});
     }
     request_wakeup();
 }
 
 void epoll_registry::request_broadcast(socket_info& si, command_codec::command cmd){
-    request_broadcast(si.ufd.get(), std::move(cmd));
+    request_broadcast(si.handle, std::move(cmd));
 }
 
-void epoll_registry::request_change_nickname(int send_fd, std::string nick){ 
+void epoll_registry::request_change_nickname(conn_handle conn, std::string nick){
     {
         std::lock_guard<std::mutex> lock(cmd_mtx);
-        cmd_q.emplace(change_nickname_command{send_fd, std::move(nick)});
+        cmd_q.emplace_back(change_nickname_command{conn, std::move(nick)});
     }
     request_wakeup();
 }
 
 void epoll_registry::request_change_nickname(socket_info& si, std::string nick){
-    request_change_nickname(si.ufd.get(), std::move(nick));
+    request_change_nickname(si.handle, std::move(nick));
 }
 
-void epoll_registry::request_set_user_id(int fd, std::string user_id){
+void epoll_registry::request_set_user_id(conn_handle conn, std::string user_id){
     {
         std::lock_guard<std::mutex> lock(cmd_mtx);
-        cmd_q.emplace(set_user_id_command{fd, std::move(user_id)});
+        cmd_q.emplace_back(set_user_id_command{conn, std::move(user_id)});
     }
     request_wakeup();
 }
 
 void epoll_registry::request_set_user_id(socket_info& si, std::string user_id){
-    request_set_user_id(si.ufd.get(), std::move(user_id));
+    request_set_user_id(si.handle, std::move(user_id));
 }
 
-void epoll_registry::request_set_joined_rooms(int fd, std::vector<std::int64_t> room_ids){
+void epoll_registry::request_set_joined_rooms(conn_handle conn, std::vector<std::int64_t> room_ids){
     {
         std::lock_guard<std::mutex> lock(cmd_mtx);
-        cmd_q.emplace(set_joined_rooms_command{fd, std::move(room_ids)});
+        cmd_q.emplace_back(set_joined_rooms_command{conn, std::move(room_ids)});
     }
     request_wakeup();
 }
 
 void epoll_registry::request_set_joined_rooms(socket_info& si, std::vector<std::int64_t> room_ids){
-    request_set_joined_rooms(si.ufd.get(), std::move(room_ids));
+    request_set_joined_rooms(si.handle, std::move(room_ids));
 }
 
 void epoll_registry::request_set_joined_rooms_for_user(
@@ -204,27 +521,27 @@ void epoll_registry::request_set_joined_rooms_for_user(
 ){
     {
         std::lock_guard<std::mutex> lock(cmd_mtx);
-        cmd_q.emplace(set_joined_rooms_for_user_command{std::move(user_id), std::move(room_ids)});
+        cmd_q.emplace_back(set_joined_rooms_for_user_command{std::move(user_id), std::move(room_ids)});
     }
     request_wakeup();
 }
 
-void epoll_registry::request_send_friend_list(int fd, std::vector<std::string> friend_ids){
+void epoll_registry::request_send_friend_list(conn_handle conn, std::vector<std::string> friend_ids){
     {
         std::lock_guard<std::mutex> lock(cmd_mtx);
-        cmd_q.emplace(send_friend_list_command{fd, std::move(friend_ids)});
+        cmd_q.emplace_back(send_friend_list_command{conn, std::move(friend_ids)});
     }
     request_wakeup();
 }
 
 void epoll_registry::request_room_broadcast(
-    int sender_fd,
+    conn_handle sender,
     std::int64_t room_id,
     command_codec::command cmd
 ){
     {
         std::lock_guard<std::mutex> lock(cmd_mtx);
-        cmd_q.emplace(room_broadcast_command{sender_fd, room_id, std::move(cmd)});
+        cmd_q.emplace_back(room_broadcast_command{sender, room_id, std::move(cmd)});
     }
     request_wakeup();
 }
@@ -234,7 +551,43 @@ void epoll_registry::request_room_broadcast(
     std::int64_t room_id,
     command_codec::command cmd
 ){
-    request_room_broadcast(si.ufd.get(), room_id, std::move(cmd));
+    request_room_broadcast(si.handle, room_id, std::move(cmd));
+}
+
+void epoll_registry::request_room_relay(
+    std::int64_t room_id,
+    std::string nickname,
+    command_codec::command cmd
+){
+    {
+        std::lock_guard<std::mutex> lock(cmd_mtx);
+        cmd_q.emplace_back(room_relay_command{room_id, std::move(nickname), std::move(cmd)});
+    }
+    request_wakeup();
+}
+
+void epoll_registry::request_db_done(conn_handle conn){
+    {
+        std::lock_guard<std::mutex> lock(cmd_mtx);
+        cmd_q.emplace_back(db_done_command{conn});
+    }
+    request_wakeup();
+}
+
+void epoll_registry::request_set_friends(std::string user_id, std::vector<std::string> friend_ids){
+    {
+        std::lock_guard<std::mutex> lock(cmd_mtx);
+        cmd_q.emplace_back(set_friends_command{std::move(user_id), std::move(friend_ids)});
+    }
+    request_wakeup();
+}
+
+void epoll_registry::request_friend_link(std::string user_a, std::string user_b, bool linked){
+    {
+        std::lock_guard<std::mutex> lock(cmd_mtx);
+        cmd_q.emplace_back(friend_link_command{std::move(user_a), std::move(user_b), linked});
+    }
+    request_wakeup();
 }
 
 void epoll_registry::handle_command(register_command&& cmd){
@@ -242,103 +595,115 @@ void epoll_registry::handle_command(register_command&& cmd){
 }
 
 void epoll_registry::handle_command(const unregister_command& cmd){
-    auto unreg_exp = unregister_fd(cmd.fd);
+    if(infos.find(cmd.conn) == nullptr) return;
+    auto unreg_exp = unregister_fd(cmd.conn.fd);
 }
 
 void epoll_registry::handle_command(send_one_command&& cmd){
-    auto it = infos.find(cmd.fd);
-    if(it == infos.end()) return;
+    socket_info* si = infos.find(cmd.conn);
+    if(si == nullptr) return;
 
-    auto& si = it->second;
-    auto append_exp = append_send(si, cmd.cmd);
+    auto append_exp = append_send(*si, cmd.cmd);
     if(!append_exp) return;
 }
 
-void epoll_registry::handle_command(broadcast_command&& cmd){
-    if(const auto* response = std::get_if<command_codec::cmd_response>(&cmd.cmd)){
-        std::string nickname = "guest";
-        auto sender_it = infos.find(cmd.fd);
-        if(sender_it != infos.end() && !sender_it->second.nickname.empty()){
-            nickname = sender_it->second.nickname;
-        }
+void epoll_registry::handle_command(send_block_command&& cmd){
+    socket_info* si = infos.find(cmd.conn);
+    if(si == nullptr) return;
 
-        command_codec::command named_msg =
-            command_codec::cmd_response{nickname + ": " + response->text};
-        for(auto& [fd, si] : infos){
-            auto append_exp = append_send(si, named_msg);
-            if(!append_exp) continue;
-        }
-        return;
-    }
+    const std::size_t before = si->send.remaining();
+    auto append_exp = finish_append(*si, before, si->send.append(cmd.block));
+    if(!append_exp) return;
+}
 
-    for(auto& [fd, si] : infos){
-        auto append_exp = append_send(si, cmd.cmd);
-        if(!append_exp) continue;
-    }
+std::string_view epoll_registry::sender_nickname(conn_handle sender){
+    const socket_info* si = infos.find(sender);
+    if(si != nullptr && !si->nickname.empty()) return si->nickname;
+    return "guest";
+}
+
+command_codec::command_view epoll_registry::fanout_view(std::string_view nickname, const command_codec::command& cmd){
+    const auto* response = std::get_if<command_codec::cmd_response>(&cmd);
+    if(response == nullptr) return command_codec::view(cmd);
+
+    const std::string_view sep = ": ";
+    const std::size_t n = nickname.size() + sep.size() + response->text.size();
+    char* text = static_cast<char*>(frame_arena.allocate(n, 1));
+    std::memcpy(text, nickname.data(), nickname.size());
+    std::memcpy(text + nickname.size(), sep.data(), sep.size());
+    std::memcpy(text + nickname.size() + sep.size(), response->text.data(), response->text.size());
+    return command_codec::basic_cmd_response<std::string_view>{std::string_view(text, n)};
+}
+
+void epoll_registry::handle_command(broadcast_command&& cmd){
+    fanout_payload payload(fanout_view(sender_nickname(cmd.sender), cmd.cmd), frame_arena);
+    infos.for_each([this, &payload](socket_info& si){
+        auto append_exp = append_wire(si, payload.for_format(si.send.get_format()), true);
+    });
 }
 
 void epoll_registry::handle_command(change_nickname_command&& cmd){
-    auto it = infos.find(cmd.fd);
-    if(it == infos.end()) return;
+    socket_info* si = infos.find(cmd.conn);
+    if(si == nullptr) return;
 
-    it->second.nickname = std::move(cmd.nick);
+    si->nickname = std::move(cmd.nick);
 }
 
 void epoll_registry::handle_command(set_user_id_command&& cmd){
-    auto it = infos.find(cmd.fd);
-    if(it == infos.end()) return;
+    socket_info* si = infos.find(cmd.conn);
+    if(si == nullptr) return;
 
-    remove_fd_from_user_index(it->second);
-    set_fd_joined_rooms(it->second, {});
-    it->second.user_id = std::move(cmd.user_id);
-    if(!it->second.user_id.empty()){
-        user_online_fds[it->second.user_id].insert(it->second.ufd.get());
-    }
+    remove_fd_from_user_index(*si);
+    set_fd_joined_rooms(*si, {});
+    if(cmd.user_id.empty()) return;
+
+    const bool was_online = user_online(cmd.user_id);
+    auto [user_it, inserted] = user_online_fds.try_emplace(std::move(cmd.user_id));
+    user_it->second.insert(si->ufd.get());
+    si->user_id = user_it->first;
+    if(!inserted) return;
+
+    if(bus != nullptr) bus->set_user_presence(user_it->first, true);
+    note_presence(user_it->first, was_online);
 }
 
 void epoll_registry::handle_command(set_joined_rooms_command&& cmd){
-    auto it = infos.find(cmd.fd);
-    if(it == infos.end()) return;
+    socket_info* si = infos.find(cmd.conn);
+    if(si == nullptr) return;
 
-    set_fd_joined_rooms(it->second, std::move(cmd.room_ids));
-    logger::log_info(
-        "joined rooms indexed: " + std::to_string(it->second.joined_room_ids.size()),
-        it->second
-    );
+    set_fd_joined_rooms(*si, std::move(cmd.room_ids));
+    logger::log_info("joined rooms indexed: " + std::to_string(si->joined_room_ids.size()), *si);
 }
 
 void epoll_registry::handle_command(set_joined_rooms_for_user_command&& cmd){
     auto user_it = user_online_fds.find(cmd.user_id);
     if(user_it == user_online_fds.end()) return;
 
-    const std::unordered_set<int> fds = user_it->second;
-    for(int fd : fds){
-        auto it = infos.find(fd);
-        if(it == infos.end()) continue;
+    for(int fd : user_it->second){
+        socket_info* si = infos.find(fd);
+        if(si == nullptr) continue;
 
         std::vector<std::int64_t> rooms_copy = cmd.room_ids;
-        set_fd_joined_rooms(it->second, std::move(rooms_copy));
-        logger::log_info(
-            "joined rooms indexed: " + std::to_string(it->second.joined_room_ids.size()),
-            it->second
-        );
+        set_fd_joined_rooms(*si, std::move(rooms_copy));
+        logger::log_info("joined rooms indexed: " + std::to_string(si->joined_room_ids.size()), *si);
     }
 }
 
 void epoll_registry::handle_command(send_friend_list_command&& cmd){
-    auto it = infos.find(cmd.fd);
-    if(it == infos.end()) return;
+    socket_info* si = infos.find(cmd.conn);
+    if(si == nullptr) return;
 
     auto header_exp = append_send(
-        it->second,
+        *si,
         command_codec::cmd_response{"friends: " + std::to_string(cmd.friend_ids.size())}
     );
     if(!header_exp) return;
 
     for(const auto& friend_id : cmd.friend_ids){
-        const bool is_online = user_online_fds.contains(friend_id);
+        const bool is_online = user_online_fds.contains(friend_id)
+            || (bus != nullptr && bus->remote_online(friend_id));
         auto send_exp = append_send(
-            it->second,
+            *si,
             command_codec::cmd_response{
                 "friend: " + friend_id + " (" + (is_online ? "online" : "offline") + ")"
             }
@@ -348,26 +713,122 @@ void epoll_registry::handle_command(send_friend_list_command&& cmd){
 }
 
 void epoll_registry::handle_command(room_broadcast_command&& cmd){
-    auto room_it = room_online_fds.find(cmd.room_id);
+    const std::string_view nickname = sender_nickname(cmd.sender);
+    if(bus != nullptr){
+        if(const auto* response = std::get_if<command_codec::cmd_response>(&cmd.cmd)){
+            bus->publish(cmd.room_id, nickname, response->text);
+        }
+    }
+    fanout_room(cmd.room_id, fanout_view(nickname, cmd.cmd));
+}
+
+void epoll_registry::handle_command(room_relay_command&& cmd){
+    const std::string_view nickname = cmd.nickname.empty() ? std::string_view("guest") : std::string_view(cmd.nickname);
+    fanout_room(cmd.room_id, fanout_view(nickname, cmd.cmd));
+}
+
+void epoll_registry::fanout_room(std::int64_t room_id, const command_codec::command_view& cmd){
+    auto room_it = room_online_fds.find(room_id);
     if(room_it == room_online_fds.end()) return;
 
-    command_codec::command payload = cmd.cmd;
-    if(const auto* response = std::get_if<command_codec::cmd_response>(&cmd.cmd)){
-        std::string nickname = "guest";
-        auto sender_it = infos.find(cmd.sender_fd);
-        if(sender_it != infos.end() && !sender_it->second.nickname.empty()){
-            nickname = sender_it->second.nickname;
-        }
-        payload = command_codec::cmd_response{nickname + ": " + response->text};
+    fanout_payload payload(cmd, frame_arena);
+    room_members& members = room_it->second;
+    members.for_each([this, &payload](int fd){
+        socket_info* si = infos.find(fd);
+        if(si == nullptr) return;
+
+        auto append_exp = append_wire(*si, payload.for_format(si->send.get_format()), true);
+        if(!append_exp) return;
+    });
+
+    // Evictions during the scan leave the room in place until it ends.
+    if(members.empty()){
+        room_online_fds.erase(room_it);
+        note_room_interest(room_id, false);
+    }
+}
+
+void epoll_registry::note_room_interest(std::int64_t room_id, bool has_members){
+    if(bus != nullptr) bus->set_room_interest(room_id, has_members);
+}
+
+void epoll_registry::handle_command(const db_done_command& cmd){
+    socket_info* si = infos.find(cmd.conn);
+    if(si == nullptr) return;
+
+    if(si->inflight_db > 0) --si->inflight_db;
+    if(si->recv_paused && !si->is_closed) update_recv_interest(*si);
+}
+
+void epoll_registry::handle_command(set_friends_command&& cmd){
+    if(!presence_opts.push || !user_online_fds.contains(cmd.user_id)) return;
+
+    auto& friends = friends_by_user[std::move(cmd.user_id)];
+    friends.clear();
+    for(std::string& friend_id : cmd.friend_ids){
+        friends.insert(std::move(friend_id));
     }
+}
 
-    const std::unordered_set<int> targets = room_it->second;
-    for(int fd : targets){
-        auto it = infos.find(fd);
-        if(it == infos.end()) continue;
+void epoll_registry::handle_command(friend_link_command&& cmd){
+    auto update = [this, &cmd](const std::string& user_id, std::string& friend_id){
+        auto it = friends_by_user.find(user_id);
+        if(it == friends_by_user.end()) return;
+        if(cmd.linked) it->second.insert(friend_id);
+        else it->second.erase(friend_id);
+    };
+    update(cmd.user_a, cmd.user_b);
+    update(cmd.user_b, cmd.user_a);
+}
+
+bool epoll_registry::user_online(std::string_view user_id) const{
+    return user_online_fds.contains(user_id) || (bus != nullptr && bus->remote_online(user_id));
+}
 
-        auto append_exp = append_send(it->second, payload);
-        if(!append_exp) continue;
+void epoll_registry::note_presence(std::string_view user_id, bool was_online){
+    if(!presence_opts.push) return;
+
+    // Only the first change in a window records what friends last saw.
+    if(presence_pending.find(user_id) == presence_pending.end()){
+        presence_pending.emplace(std::string(user_id), was_online);
+    }
+    if(presence_flush_at == timer_wheel::clock::time_point::max()){
+        presence_flush_at = timer_wheel::clock::now() + presence_opts.coalesce;
+    }
+}
+
+void epoll_registry::flush_presence(){
+    presence_flush_at = timer_wheel::clock::time_point::max();
+    // Appends below may close connections, which notes presence again.
+    auto pending = std::exchange(presence_pending, {});
+    for(const auto& [user_id, was_online] : pending){
+        const bool online = user_online(user_id);
+        if(online != was_online) push_presence(user_id, online);
+        if(!user_online_fds.contains(user_id)) friends_by_user.erase(user_id);
+    }
+}
+
+void epoll_registry::push_presence(std::string_view user_id, bool online){
+    auto friends_it = friends_by_user.find(user_id);
+    if(friends_it == friends_by_user.end()) return;
+
+    const command_codec::command cmd = command_codec::cmd_response{
+        "presence: " + std::string(user_id) + (online ? " online" : " offline")
+    };
+    // Targets are collected first so no index is iterated while appending.
+    std::vector<int> fds;
+    for(const std::string& friend_id : friends_it->second){
+        auto online_it = user_online_fds.find(friend_id);
+        if(online_it == user_online_fds.end()) continue;
+        fds.insert(fds.end(), online_it->second.begin(), online_it->second.end());
+    }
+
+    for(int fd : fds){
+        socket_info* si = infos.find(fd);
+        if(si == nullptr || si->is_closed) continue;
+
+        // finish_append() already logs a failure and closes the connection.
+        auto append_exp = append_send(*si, cmd, true);
     }
 }
 
@@ -378,8 +839,9 @@ void epoll_registry::remove_fd_from_room_index(socket_info& si){
         if(room_it == room_online_fds.end()) continue;
 
         room_it->second.erase(fd);
-        if(room_it->second.empty()){
+        if(room_it->second.empty() && !room_it->second.scanning()){
             room_online_fds.erase(room_it);
+            note_room_interest(room_id, false);
         }
     }
     si.joined_room_ids.clear();
@@ -391,8 +853,12 @@ void epoll_registry::remove_fd_from_user_index(socket_info& si){
     auto user_it = user_online_fds.find(si.user_id);
     if(user_it == user_online_fds.end()) return;
 
+    si.user_id = {};
     user_it->second.erase(si.ufd.get());
     if(user_it->second.empty()){
+        if(bus != nullptr) bus->set_user_presence(user_it->first, false);
+        if(user_offline_handler) user_offline_handler(user_it->first);
+        note_presence(user_it->first, true);
         user_online_fds.erase(user_it);
     }
 }
@@ -402,27 +868,33 @@ void epoll_registry::set_fd_joined_rooms(socket_info& si, std::vector<std::int64
 
     int fd = si.ufd.get();
     for(std::int64_t room_id : room_ids){
-        if(room_id <= 0) continue;
-        si.joined_room_ids.insert(room_id);
-        room_online_fds[room_id].insert(fd);
+        if(room_id <= 0 || si.joined_room_ids.contains(room_id)) continue;
+        si.joined_room_ids.push_back(room_id);
+        auto [room_it, inserted] = room_online_fds.try_emplace(room_id);
+        room_it->second.insert(fd);
+        if(inserted) note_room_interest(room_id, true);
     }
 }
 
 void epoll_registry::work(){
     consume_wakeup();
 
-    std::queue<command> pending_cmd;
     {
         std::lock_guard<std::mutex> lock(cmd_mtx);
-        std::swap(pending_cmd, cmd_q);
+        std::swap(cmd_batch, cmd_q);
     }
 
-    while(!pending_cmd.empty()){
-        command cmd = std::move(pending_cmd.front());
-        pending_cmd.pop();
+    for(command& cmd : cmd_batch){
         std::visit([this](auto&& c){ handle_command(std::move(c)); }, std::move(cmd));
     }
+    cmd_batch.clear();
+    frame_arena.release();
 }
 
-epoll_registry::socket_info_it epoll_registry::find(int fd){ return infos.find(fd); }
-epoll_registry::socket_info_it epoll_registry::end(){ return infos.end(); }
+socket_info* epoll_registry::find(int fd){ return infos.find(fd); }
+
+void epoll_registry::set_node_bus(node_bus* new_bus){ bus = new_bus; }
+void epoll_registry::set_user_offline_handler(std::function<void(std::string_view)> handler){
+    user_offline_handler = std::move(handler);
+}
+socket_info* epoll_registry::find(conn_handle conn){ return infos.find(conn); }
@@ -29,6 +29,30 @@ std::expected <void, error_code> epoll_utility::add_fd(int epfd, int fd, uint32_
     return {};
 }
 
+std::expected <void, error_code> epoll_utility::add_fd(int epfd, int fd, uint32_t interest, std::uint64_t key){
+    epoll_event ev{};
+    ev.events = interest;
+    ev.data.u64 = key;
+    int ec = ::epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+    if(ec == -1){
+        int en = errno;
+        return std::unexpected(error_code::from_errno(en));
+    }
+    return {};
+}
+
+std::expected <void, error_code> epoll_utility::modify_fd(int epfd, int fd, uint32_t interest){
+    epoll_event ev{};
+    ev.events = interest;
+    ev.data.fd = fd;
+    int ec = ::epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+    if(ec == -1){
+        int en = errno;
+        return std::unexpected(error_code::from_errno(en));
+    }
+    return {};
+}
+
 std::expected <void, error_code> epoll_utility::del_fd(int epfd, int fd){
     int ec = ::epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
     if(ec == -1){
@@ -43,7 +67,7 @@ std::expected <void, error_code> epoll_utility::update_interest(int epfd, socket
     si.interest = interest;
     epoll_event ev{};
     ev.events = interest;
-    ev.data.fd = fd;
+    ev.data.u64 = si.handle.pack();
     int ec = ::epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
     if(ec == -1){
         int ec = errno;
@@ -9,12 +9,13 @@ std::expected<void, error_code> event_loop::run(
     const std::function<bool(socket_info&, uint32_t)>& on_recv,
     const std::function<void(socket_info&)>& on_send,
     const std::function<bool(socket_info&)>& on_execute,
-    const std::function<void(int, uint32_t)>& on_client_error
+    const std::function<void(conn_handle, uint32_t)>& on_client_error
 ){
     std::stop_callback on_stop(stop_token, [this](){ registry.request_wakeup(); });
 
     while(!stop_token.stop_requested()){
-        int event_sz = ::epoll_wait(registry.get_epfd(), events.data(), events.size(), -1);
+        const int timeout_ms = registry.has_ready_fds() ? 0 : registry.next_timeout_ms();
+        int event_sz = ::epoll_wait(registry.get_epfd(), events.data(), events.size(), timeout_ms);
         if(event_sz == -1){
             int ec = errno;
             if(errno == EINTR) continue;
@@ -24,17 +25,17 @@ std::expected<void, error_code> event_loop::run(
         if(stop_token.stop_requested()) break;
 
         for(int i = 0;i < event_sz;++i){
-            int fd = events[i].data.fd;
+            const conn_handle conn = conn_handle::unpack(events[i].data.u64);
             uint32_t event = events[i].events;
 
             if(is_error_event(event)){
-                on_client_error(fd, event);
+                on_client_error(conn, event);
                 continue;
             }
 
-            auto it = registry.find(fd);
-            if(it == registry.end()) continue;
-            auto& si = it->second;
+            socket_info* found = registry.find(conn);
+            if(found == nullptr) continue;
+            auto& si = *found;
 
             bool keep_alive = true;
             if(is_read_event(event)) keep_alive = on_recv(si, event);
@@ -45,6 +46,19 @@ std::expected<void, error_code> event_loop::run(
                 while(on_execute(si));
             }
         }
+
+        // Connections that stopped reading at the recv cap or were just
+        // resumed may have input buffered where epoll cannot see it.
+        for(int fd : registry.take_ready_fds()){
+            socket_info* found = registry.find(fd);
+            if(found == nullptr || found->is_closed) continue;
+            auto& si = *found;
+
+            if(!on_recv(si, EPOLLIN)) continue;
+            while(on_execute(si));
+        }
+
+        registry.expire_timers();
     }
 
     return {};
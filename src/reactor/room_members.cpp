@@ -0,0 +1,40 @@
+#include "reactor/room_members.hpp"
+#include <algorithm>
+
+void room_members::insert(int fd){
+    fds.push_back(fd);
+}
+
+void room_members::erase(int fd) noexcept{
+    auto it = std::find(fds.begin(), fds.end(), fd);
+    if(it == fds.end()) return;
+
+    if(scans > 0){
+        *it = TOMBSTONE;
+        ++tombstones;
+        return;
+    }
+    *it = fds.back();
+    fds.pop_back();
+}
+
+void room_members::compact() noexcept{
+    std::erase(fds, TOMBSTONE);
+    tombstones = 0;
+}
+
+std::size_t room_members::size() const noexcept{
+    return fds.size() - tombstones;
+}
+
+bool room_members::empty() const noexcept{
+    return size() == 0;
+}
+
+bool room_members::scanning() const noexcept{
+    return scans > 0;
+}
+
+std::size_t room_members::heap_bytes() const noexcept{
+    return fds.capacity() * sizeof(int);
+}
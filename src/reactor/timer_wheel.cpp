@@ -0,0 +1,89 @@
+#include "reactor/timer_wheel.hpp"
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+timer_wheel::timer_wheel(clock::duration tick, clock::time_point now) : tick(tick), origin(now){}
+
+std::uint64_t timer_wheel::tick_of(clock::time_point when) const noexcept{
+    if(when <= origin) return 0;
+    const auto elapsed = when - origin;
+    return static_cast<std::uint64_t>((elapsed + tick - clock::duration(1)) / tick);
+}
+
+void timer_wheel::insert(entry e){
+    const std::uint64_t delta = e.expire_tick - current_tick;
+    std::size_t lv = 0;
+    while(lv + 1 < LEVELS && delta >= (std::uint64_t{1} << (SLOT_BITS * (lv + 1)))) ++lv;
+
+    const std::size_t idx = (e.expire_tick >> (SLOT_BITS * lv)) & (SLOTS - 1);
+    levels[lv].slots[idx].push_back(e);
+    levels[lv].occupied |= std::uint64_t{1} << idx;
+}
+
+void timer_wheel::cascade(std::size_t lv){
+    if(lv >= LEVELS) return;
+
+    const std::size_t idx = (current_tick >> (SLOT_BITS * lv)) & (SLOTS - 1);
+    if(idx == 0) cascade(lv + 1);
+    if((levels[lv].occupied & (std::uint64_t{1} << idx)) == 0) return;
+
+    std::vector<entry> moved;
+    std::swap(moved, levels[lv].slots[idx]);
+    levels[lv].occupied &= ~(std::uint64_t{1} << idx);
+    for(const entry& e : moved) insert(e);
+}
+
+void timer_wheel::schedule(int fd, clock::time_point when){
+    constexpr std::uint64_t horizon = (std::uint64_t{1} << (SLOT_BITS * LEVELS)) - 1;
+    std::uint64_t expire = std::max(tick_of(when), current_tick + 1);
+    expire = std::min(expire, current_tick + horizon);
+
+    insert(entry{fd, expire});
+    ++entry_count;
+}
+
+void timer_wheel::advance(clock::time_point now, std::vector<int>& expired){
+    const std::uint64_t target = now <= origin ? 0 : static_cast<std::uint64_t>((now - origin) / tick);
+    if(entry_count == 0){
+        current_tick = std::max(current_tick, target);
+        return;
+    }
+
+    while(current_tick < target){
+        ++current_tick;
+        const std::size_t idx = current_tick & (SLOTS - 1);
+        if(idx == 0) cascade(1);
+        if((levels[0].occupied & (std::uint64_t{1} << idx)) == 0) continue;
+
+        auto& slot = levels[0].slots[idx];
+        for(const entry& e : slot) expired.push_back(e.fd);
+        entry_count -= slot.size();
+        slot.clear();
+        levels[0].occupied &= ~(std::uint64_t{1} << idx);
+        if(entry_count == 0){
+            current_tick = target;
+            return;
+        }
+    }
+}
+
+int timer_wheel::timeout_ms(clock::time_point now) const noexcept{
+    if(entry_count == 0) return -1;
+
+    // The next tick that either fires a level 0 slot or cascades a higher level.
+    const std::size_t pos = current_tick & (SLOTS - 1);
+    std::uint64_t next = current_tick + (SLOTS - pos);
+    const std::uint64_t ahead = std::rotr(levels[0].occupied, static_cast<int>((pos + 1) & (SLOTS - 1)));
+    if(ahead != 0){
+        next = std::min<std::uint64_t>(next, current_tick + 1 + std::countr_zero(ahead));
+    }
+
+    const clock::time_point at = origin + tick * static_cast<clock::rep>(next);
+    if(at <= now) return 0;
+
+    const auto wait = std::chrono::ceil<std::chrono::milliseconds>(at - now).count();
+    return static_cast<int>(std::min<decltype(wait)>(wait, std::numeric_limits<int>::max()));
+}
+
+std::size_t timer_wheel::size() const noexcept{ return entry_count; }
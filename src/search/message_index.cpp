@@ -0,0 +1,507 @@
+#include "search/message_index.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <unordered_set>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace{
+    constexpr char MAGIC[8] = {'S', 'P', 'I', 'D', 'X', '\0', '\0', '\1'};
+    constexpr std::size_t HEADER_SIZE = 16;
+    constexpr std::size_t USED_OFFSET = 8;
+    constexpr std::size_t MIN_MAP_SIZE = 1 << 20;
+    constexpr std::size_t MAX_TERM_BYTES = 64;
+    constexpr std::size_t MAX_QUERY_TERMS = 8;
+
+    enum class record_kind : std::uint8_t{
+        message = 1,
+        drop_room = 2,
+        sync_mark = 3
+    };
+
+    struct record{
+        record_kind kind{};
+        std::int64_t room_id{};
+        std::int64_t message_id{};
+        std::string_view sender_user_id;
+        std::string_view body;
+        std::size_t size{};
+    };
+
+    std::size_t varint_size(std::uint64_t v){
+        std::size_t n = 1;
+        while(v >= 0x80){
+            v >>= 7;
+            ++n;
+        }
+        return n;
+    }
+
+    char* put_varint(char* out, std::uint64_t v){
+        while(v >= 0x80){
+            *out++ = static_cast<char>((v & 0x7f) | 0x80);
+            v >>= 7;
+        }
+        *out++ = static_cast<char>(v);
+        return out;
+    }
+
+    void append_varint(std::string& out, std::uint64_t v){
+        char tmp[10];
+        out.append(tmp, put_varint(tmp, v));
+    }
+
+    bool get_varint(const char*& p, const char* end, std::uint64_t& v){
+        v = 0;
+        for(int shift = 0; shift < 64 && p < end; shift += 7){
+            const auto byte = static_cast<std::uint8_t>(*p++);
+            v |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+            if((byte & 0x80) == 0) return true;
+        }
+        return false;
+    }
+
+    std::optional<record> parse_record(const char* begin, const char* end){
+        const char* p = begin;
+        if(p >= end) return std::nullopt;
+
+        record rec{};
+        rec.kind = static_cast<record_kind>(*p++);
+        if(rec.kind == record_kind::sync_mark){
+            std::uint64_t message_id = 0;
+            if(!get_varint(p, end, message_id)) return std::nullopt;
+            rec.message_id = static_cast<std::int64_t>(message_id);
+            rec.size = static_cast<std::size_t>(p - begin);
+            return rec;
+        }
+
+        std::uint64_t room_id = 0;
+        if(!get_varint(p, end, room_id)) return std::nullopt;
+        rec.room_id = static_cast<std::int64_t>(room_id);
+
+        if(rec.kind == record_kind::message){
+            std::uint64_t message_id = 0, sender_len = 0, body_len = 0;
+            if(!get_varint(p, end, message_id) || !get_varint(p, end, sender_len) || !get_varint(p, end, body_len)){
+                return std::nullopt;
+            }
+            if(sender_len > static_cast<std::uint64_t>(end - p)) return std::nullopt;
+            rec.sender_user_id = std::string_view(p, sender_len);
+            p += sender_len;
+            if(body_len > static_cast<std::uint64_t>(end - p)) return std::nullopt;
+            rec.body = std::string_view(p, body_len);
+            p += body_len;
+            rec.message_id = static_cast<std::int64_t>(message_id);
+        }
+        else if(rec.kind != record_kind::drop_room) return std::nullopt;
+
+        rec.size = static_cast<std::size_t>(p - begin);
+        return rec;
+    }
+
+    // msync needs a page-aligned start, so the range is widened down to one.
+    bool sync_pages(char* base, std::size_t from, std::size_t to){
+        static const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        const std::size_t start = from / page * page;
+        return to <= start || ::msync(base + start, to - start, MS_SYNC) == 0;
+    }
+
+    char fold(char ch){
+        if(ch >= 'A' && ch <= 'Z') return static_cast<char>(ch - 'A' + 'a');
+        return ch;
+    }
+
+    bool is_word(char ch){
+        const auto byte = static_cast<unsigned char>(ch);
+        return byte >= 0x80 || (byte >= '0' && byte <= '9') || (byte >= 'a' && byte <= 'z') || (byte >= 'A' && byte <= 'Z');
+    }
+}
+
+message_index::~message_index(){ unmap(); }
+
+void message_index::unmap() noexcept{
+    if(base != nullptr) ::munmap(base, mapped);
+    base = nullptr;
+    mapped = 0;
+}
+
+void message_index::tokenize(std::string_view text, const std::function<void(std::string_view)>& on_term){
+    char term[MAX_TERM_BYTES];
+    std::size_t i = 0;
+    while(i < text.size()){
+        while(i < text.size() && !is_word(text[i])) ++i;
+        const std::size_t start = i;
+        while(i < text.size() && is_word(text[i])) ++i;
+
+        const std::size_t len = i - start;
+        if(len == 0 || len > MAX_TERM_BYTES) continue;
+        std::transform(text.begin() + start, text.begin() + i, term, fold);
+        on_term(std::string_view(term, len));
+    }
+}
+
+std::expected<void, error_code> message_index::open(const std::string& path){
+    std::unique_lock lock(mtx);
+    unmap();
+    rooms.clear();
+    recent_ids.clear();
+    used = 0;
+    synced_id = 0;
+    lowest_id = 0;
+    dropped = false;
+    log_path = path;
+
+    std::error_code dir_ec;
+    const std::filesystem::path parent = std::filesystem::path(path).parent_path();
+    if(!parent.empty()) std::filesystem::create_directories(parent, dir_ec);
+    if(dir_ec) return std::unexpected(error_code::from_errno(dir_ec.value()));
+
+    fd.reset(::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600));
+    if(!fd) return std::unexpected(error_code::from_errno(errno));
+    // Nodes sharing a root must not append to one log; the second one fails
+    // with EWOULDBLOCK until it is given its own search.index_path.
+    if(::flock(fd.get(), LOCK_EX | LOCK_NB) == -1){
+        const int ec = errno;
+        fd.reset();
+        return std::unexpected(error_code::from_errno(ec));
+    }
+
+    struct stat st{};
+    if(::fstat(fd.get(), &st) == -1) return std::unexpected(error_code::from_errno(errno));
+
+    const bool fresh = static_cast<std::size_t>(st.st_size) < HEADER_SIZE;
+    std::size_t size = static_cast<std::size_t>(st.st_size);
+    if(size < MIN_MAP_SIZE){
+        if(::ftruncate(fd.get(), static_cast<off_t>(MIN_MAP_SIZE)) == -1) return std::unexpected(error_code::from_errno(errno));
+        size = MIN_MAP_SIZE;
+    }
+
+    void* addr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+    if(addr == MAP_FAILED) return std::unexpected(error_code::from_errno(errno));
+    base = static_cast<char*>(addr);
+    mapped = size;
+
+    if(fresh){
+        std::memcpy(base, MAGIC, sizeof(MAGIC));
+        used = HEADER_SIZE;
+        std::memcpy(base + USED_OFFSET, &used, sizeof(std::uint64_t));
+        return {};
+    }
+
+    if(std::memcmp(base, MAGIC, sizeof(MAGIC)) != 0){
+        unmap();
+        fd.reset();
+        return std::unexpected(error_code::from_errno(EILSEQ));
+    }
+
+    std::uint64_t stored_used = 0;
+    std::memcpy(&stored_used, base + USED_OFFSET, sizeof(stored_used));
+    used = static_cast<std::size_t>(std::clamp<std::uint64_t>(stored_used, HEADER_SIZE, mapped));
+    replay();
+    return {};
+}
+
+bool message_index::is_open() const noexcept{ return base != nullptr; }
+
+void message_index::replay(){
+    std::size_t offset = HEADER_SIZE;
+    while(offset < used){
+        auto rec = parse_record(base + offset, base + used);
+        if(!rec) break;
+
+        if(rec->kind == record_kind::message){
+            index_message(rec->room_id, offset, rec->body);
+            if(rec->message_id > synced_id) recent_ids.insert(rec->message_id);
+            if(lowest_id == 0 || rec->message_id < lowest_id) lowest_id = rec->message_id;
+        }
+        else if(rec->kind == record_kind::sync_mark) mark_synced(rec->message_id);
+        else{
+            rooms.erase(rec->room_id);
+            dropped = true;
+        }
+        offset += rec->size;
+    }
+
+    // A record cut short by a crash is dropped; the database still has it.
+    used = offset;
+    std::memcpy(base + USED_OFFSET, &used, sizeof(std::uint64_t));
+}
+
+std::expected<void, error_code> message_index::reserve(std::size_t extra){
+    if(used + extra <= mapped) return {};
+
+    const std::size_t next = std::max(mapped * 2, used + extra);
+    if(::ftruncate(fd.get(), static_cast<off_t>(next)) == -1) return std::unexpected(error_code::from_errno(errno));
+    void* addr = ::mremap(base, mapped, next, MREMAP_MAYMOVE);
+    if(addr == MAP_FAILED) return std::unexpected(error_code::from_errno(errno));
+    base = static_cast<char*>(addr);
+    mapped = next;
+    return {};
+}
+
+void message_index::index_message(std::int64_t room_id, std::uint64_t offset, std::string_view body){
+    auto& terms = rooms[room_id];
+    tokenize(body, [&](std::string_view term){
+        auto it = terms.find(term);
+        if(it == terms.end()) it = terms.emplace(std::string(term), posting_list{}).first;
+
+        posting_list& list = it->second;
+        if(list.count != 0 && list.last == offset) return;
+        append_varint(list.deltas, offset - list.last);
+        list.last = offset;
+        ++list.count;
+    });
+}
+
+std::expected<bool, error_code> message_index::add(
+    std::int64_t room_id, std::int64_t message_id, std::string_view sender_user_id, std::string_view body
+){
+    std::unique_lock lock(mtx);
+    if(base == nullptr) return false;
+    if(message_id <= synced_id || recent_ids.contains(message_id)) return false;
+
+    const std::size_t size = 1 + varint_size(static_cast<std::uint64_t>(room_id))
+        + varint_size(static_cast<std::uint64_t>(message_id)) + varint_size(sender_user_id.size())
+        + varint_size(body.size()) + sender_user_id.size() + body.size();
+    auto reserve_exp = reserve(size);
+    if(!reserve_exp) return std::unexpected(reserve_exp.error());
+
+    const std::size_t offset = used;
+    char* out = base + offset;
+    *out++ = static_cast<char>(record_kind::message);
+    out = put_varint(out, static_cast<std::uint64_t>(room_id));
+    out = put_varint(out, static_cast<std::uint64_t>(message_id));
+    out = put_varint(out, sender_user_id.size());
+    out = put_varint(out, body.size());
+    std::memcpy(out, sender_user_id.data(), sender_user_id.size());
+    std::memcpy(out + sender_user_id.size(), body.data(), body.size());
+
+    used += size;
+    std::memcpy(base + USED_OFFSET, &used, sizeof(std::uint64_t));
+    index_message(room_id, offset, body);
+    recent_ids.insert(message_id);
+    if(lowest_id == 0 || message_id < lowest_id) lowest_id = message_id;
+    return true;
+}
+
+std::expected<void, error_code> message_index::append_drop(std::int64_t room_id){
+    const std::size_t size = 1 + varint_size(static_cast<std::uint64_t>(room_id));
+    auto reserve_exp = reserve(size);
+    if(!reserve_exp) return std::unexpected(reserve_exp.error());
+
+    char* out = base + used;
+    *out++ = static_cast<char>(record_kind::drop_room);
+    put_varint(out, static_cast<std::uint64_t>(room_id));
+    used += size;
+    std::memcpy(base + USED_OFFSET, &used, sizeof(std::uint64_t));
+    return {};
+}
+
+std::expected<void, error_code> message_index::drop_room(std::int64_t room_id){
+    std::unique_lock lock(mtx);
+    if(base == nullptr || rooms.erase(room_id) == 0) return {};
+    dropped = true;
+    return append_drop(room_id);
+}
+
+std::expected<std::size_t, error_code> message_index::retain_rooms(std::span<const std::int64_t> room_ids){
+    std::unique_lock lock(mtx);
+    if(base == nullptr) return 0;
+
+    const std::unordered_set<std::int64_t> keep(room_ids.begin(), room_ids.end());
+    std::vector<std::int64_t> gone;
+    for(const auto& [room_id, terms] : rooms){
+        if(!keep.contains(room_id)) gone.push_back(room_id);
+    }
+
+    for(std::int64_t room_id : gone){
+        rooms.erase(room_id);
+        dropped = true;
+        auto drop_exp = append_drop(room_id);
+        if(!drop_exp) return std::unexpected(drop_exp.error());
+    }
+    return gone.size();
+}
+
+void message_index::mark_synced(std::int64_t id){
+    synced_id = id;
+    std::erase_if(recent_ids, [id](std::int64_t recent){ return recent <= id; });
+}
+
+std::expected<void, error_code> message_index::set_synced_message_id(std::int64_t id){
+    std::unique_lock lock(mtx);
+    if(base == nullptr || id <= synced_id) return {};
+
+    const std::size_t size = 1 + varint_size(static_cast<std::uint64_t>(id));
+    auto reserve_exp = reserve(size);
+    if(!reserve_exp) return std::unexpected(reserve_exp.error());
+
+    char* out = base + used;
+    *out++ = static_cast<char>(record_kind::sync_mark);
+    put_varint(out, static_cast<std::uint64_t>(id));
+    used += size;
+    std::memcpy(base + USED_OFFSET, &used, sizeof(std::uint64_t));
+    mark_synced(id);
+    return {};
+}
+
+void message_index::set_first_message_id(std::int64_t id){
+    std::unique_lock lock(mtx);
+    first_id = id;
+}
+
+std::int64_t message_index::synced_message_id() const{
+    std::shared_lock lock(mtx);
+    return synced_id;
+}
+
+bool message_index::reclaimable() const{
+    std::shared_lock lock(mtx);
+    return dropped || (lowest_id != 0 && lowest_id < first_id);
+}
+
+void message_index::take_log(message_index& other) noexcept{
+    std::swap(fd, other.fd);
+    std::swap(base, other.base);
+    std::swap(mapped, other.mapped);
+    std::swap(used, other.used);
+    std::swap(synced_id, other.synced_id);
+    std::swap(lowest_id, other.lowest_id);
+    std::swap(dropped, other.dropped);
+    std::swap(rooms, other.rooms);
+    std::swap(recent_ids, other.recent_ids);
+}
+
+std::expected<std::size_t, error_code> message_index::compact(){
+    std::shared_lock read_lock(mtx);
+    if(base == nullptr) return 0;
+
+    const std::string tmp_path = log_path + ".compact";
+    ::unlink(tmp_path.c_str());
+    message_index fresh;
+    auto open_exp = fresh.open(tmp_path);
+    if(!open_exp) return std::unexpected(open_exp.error());
+
+    // The sync mark goes after the messages so the ids below it are
+    // forgotten, as a replay of the new file would.
+    const std::size_t copied = used;
+    std::size_t offset = HEADER_SIZE;
+    while(offset < copied){
+        auto rec = parse_record(base + offset, base + copied);
+        if(!rec) break;
+        offset += rec->size;
+        if(rec->kind != record_kind::message || rec->message_id < first_id || !rooms.contains(rec->room_id)) continue;
+
+        auto add_exp = fresh.add(rec->room_id, rec->message_id, rec->sender_user_id, rec->body);
+        if(!add_exp) return std::unexpected(add_exp.error());
+    }
+    auto mark_exp = fresh.set_synced_message_id(synced_id);
+    if(!mark_exp) return std::unexpected(mark_exp.error());
+    // The bulk of the new log reaches the disk before adds are held up.
+    const std::size_t synced_bytes = fresh.used;
+    if(!sync_pages(fresh.base, 0, synced_bytes)) return std::unexpected(error_code::from_errno(errno));
+    read_lock.unlock();
+
+    // Records appended during the copy are applied to the new log as they
+    // are; only they and the header's length field are synced here.
+    std::unique_lock lock(mtx);
+    while(offset < used){
+        auto rec = parse_record(base + offset, base + used);
+        if(!rec) break;
+        offset += rec->size;
+
+        std::expected<void, error_code> apply_exp;
+        if(rec->kind == record_kind::message){
+            auto add_exp = fresh.add(rec->room_id, rec->message_id, rec->sender_user_id, rec->body);
+            if(!add_exp) apply_exp = std::unexpected(add_exp.error());
+        }
+        else if(rec->kind == record_kind::sync_mark) apply_exp = fresh.set_synced_message_id(rec->message_id);
+        else apply_exp = fresh.drop_room(rec->room_id);
+        if(!apply_exp) return std::unexpected(apply_exp.error());
+    }
+
+    if(!sync_pages(fresh.base, 0, HEADER_SIZE) || !sync_pages(fresh.base, synced_bytes, fresh.used)){
+        return std::unexpected(error_code::from_errno(errno));
+    }
+    if(::rename(tmp_path.c_str(), log_path.c_str()) == -1) return std::unexpected(error_code::from_errno(errno));
+
+    const std::size_t before = used;
+    take_log(fresh);
+    return before > used ? before - used : 0;
+}
+
+std::size_t message_index::room_count() const{
+    std::shared_lock lock(mtx);
+    return rooms.size();
+}
+
+std::size_t message_index::log_bytes() const{
+    std::shared_lock lock(mtx);
+    return used;
+}
+
+std::vector<message_index::match> message_index::search(
+    std::int64_t room_id, std::string_view terms, std::size_t limit
+) const{
+    std::vector<std::string> query;
+    tokenize(terms, [&](std::string_view term){
+        if(query.size() < MAX_QUERY_TERMS && std::find(query.begin(), query.end(), term) == query.end()){
+            query.emplace_back(term);
+        }
+    });
+    if(query.empty() || limit == 0) return {};
+
+    std::shared_lock lock(mtx);
+    auto room_it = rooms.find(room_id);
+    if(room_it == rooms.end()) return {};
+
+    std::vector<const posting_list*> lists;
+    lists.reserve(query.size());
+    for(const auto& term : query){
+        auto it = room_it->second.find(term);
+        if(it == room_it->second.end()) return {};
+        lists.push_back(&it->second);
+    }
+    std::sort(lists.begin(), lists.end(), [](const posting_list* a, const posting_list* b){ return a->count < b->count; });
+
+    // Decode the rarest term, then keep only the offsets every other list
+    // also holds, walking each longer list once.
+    std::vector<std::uint64_t> hits;
+    hits.reserve(lists.front()->count);
+    {
+        const char* p = lists.front()->deltas.data();
+        const char* end = p + lists.front()->deltas.size();
+        std::uint64_t offset = 0, delta = 0;
+        while(p < end && get_varint(p, end, delta)) hits.push_back(offset += delta);
+    }
+
+    for(std::size_t i = 1; i < lists.size() && !hits.empty(); ++i){
+        const char* p = lists[i]->deltas.data();
+        const char* end = p + lists[i]->deltas.size();
+        std::uint64_t offset = 0, delta = 0;
+        std::size_t kept = 0;
+        for(std::uint64_t hit : hits){
+            while(offset < hit && p < end && get_varint(p, end, delta)) offset += delta;
+            if(offset == hit) hits[kept++] = hit;
+            if(offset < hit) break;
+        }
+        hits.resize(kept);
+    }
+
+    std::vector<match> out;
+    out.reserve(std::min(limit, hits.size()));
+    for(auto it = hits.rbegin(); it != hits.rend() && out.size() < limit; ++it){
+        auto rec = parse_record(base + *it, base + used);
+        // Relayed and caught-up messages are appended out of id order, so
+        // expired ones can sit anywhere in the log.
+        if(!rec || rec->message_id < first_id) continue;
+        out.push_back(match{rec->message_id, std::string(rec->sender_user_id), std::string(rec->body)});
+    }
+    return out;
+}
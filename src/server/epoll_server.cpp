@@ -4,17 +4,23 @@
 #include "net/addr.hpp"
 #include "reactor/epoll_utility.hpp"
 #include "protocol/line_parser.hpp"
+#include "search/message_index.hpp"
+#include "core/constant.hpp"
+#include <algorithm>
+#include <array>
 #include <cerrno>
 #include <condition_variable>
 #include <mutex>
 #include <optional>
+#include <span>
 #include <string>
 #include <thread>
 #include <type_traits>
 #include <sys/socket.h>
 
 std::expected <epoll_server, error_code> epoll_server::create(
-    const char* port, db_service& db, tls_context tls_ctx
+    const char* port, db_service& db, tls_context tls_ctx, const server_options& opts,
+    db_connector* notify_db, message_index* search_index
 ){
     auto addr_exp = get_addr_server(port);
     if(!addr_exp){
@@ -34,17 +40,39 @@ std::expected <epoll_server, error_code> epoll_server::create(
         return std::unexpected(wakeup_exp.error());
     }
 
+    std::optional<epoll_listener> bus_listener;
+    if(opts.cluster.enabled && opts.cluster.transport == cluster_transport::bus){
+        auto bus_exp = node_bus::listen(opts.cluster);
+        if(!bus_exp){
+            logger::log_error("node_bus/listen failed", "epoll_server::create()", bus_exp);
+            return std::unexpected(bus_exp.error());
+        }
+        bus_listener.emplace(std::move(*bus_exp));
+    }
+
     return std::expected<epoll_server, error_code>(
-        std::in_place, std::move(*wakeup_exp), std::move(*listen_fd_exp), std::move(tls_ctx), db, port
+        std::in_place, std::move(*wakeup_exp), std::move(*listen_fd_exp), std::move(tls_ctx), db, port, opts, notify_db,
+        std::move(bus_listener), search_index
     );
 }
 
 epoll_server::epoll_server(
-    epoll_wakeup wakeup, epoll_listener listener, tls_context tls_ctx, db_service& db, const char* port
+    epoll_wakeup wakeup, epoll_listener listener, tls_context tls_ctx, db_service& db, const char* port,
+    const server_options& opts, db_connector* notify_db, std::optional<epoll_listener> bus_listener,
+    message_index* search_index
 ) : tls_ctx(std::move(tls_ctx)),
-    registry(std::move(wakeup), this->tls_ctx),
+    registry(std::move(wakeup), this->tls_ctx, opts.send, opts.recv, opts.timeouts, opts.presence),
     listener(std::move(listener)),
-    db_pool(db), port(port){}
+    db_pool(db, 1, opts.catchup, opts.unread, opts.partitions, opts.search), port(port), cluster(opts.cluster), notify_db(notify_db),
+    search(search_index), search_max_results(opts.search.max_results){
+    registry.set_user_offline_handler([this](std::string_view user_id){
+        db_pool.enqueue_mark_read(std::string(user_id));
+    });
+    if(bus_listener){
+        bus.emplace(std::move(*bus_listener), registry, cluster);
+        registry.set_node_bus(&*bus);
+    }
+}
 
 std::expected <void, error_code> epoll_server::run(){
     std::stop_source stop_source;
@@ -82,7 +110,7 @@ std::expected <void, error_code> epoll_server::run(const std::stop_token& stop_t
             [this](socket_info& si, uint32_t event){ return handle_recv(si, event); },
             [this](socket_info& si){ handle_send(si); },
             [this](socket_info& si){ return handle_execute(si); },
-            [this](int fd, uint32_t event){ handle_client_error(fd, event); }
+            [this](conn_handle conn, uint32_t event){ handle_client_error(conn, event); }
         );
 
         if(!run_exp){
@@ -91,6 +119,29 @@ std::expected <void, error_code> epoll_server::run(const std::stop_token& stop_t
         }
     });
 
+    std::jthread notify_thread;
+    if(cluster.enabled && notify_db != nullptr){
+        notify_thread = std::jthread([this, &signal_stop](std::stop_token st){
+            room_notify_listener notify_listener(*notify_db, registry, cluster, search);
+            auto notify_exp = notify_listener.run(st);
+            if(!notify_exp){
+                logger::log_error("room notify thread error", "epoll_server::run()", notify_exp);
+                signal_stop(notify_exp.error());
+            }
+        });
+    }
+
+    std::jthread bus_thread;
+    if(bus){
+        bus_thread = std::jthread([this, &signal_stop](std::stop_token st){
+            auto bus_exp = bus->run(st);
+            if(!bus_exp){
+                logger::log_error("node bus thread error", "epoll_server::run()", bus_exp);
+                signal_stop(bus_exp.error());
+            }
+        });
+    }
+
     logger::log_info("server is on port:" + port);
     std::stop_callback on_external_stop(stop_token, [&](){ signal_stop(); });
 
@@ -102,10 +153,14 @@ std::expected <void, error_code> epoll_server::run(const std::stop_token& stop_t
     logger::log_info("server is requested stop");
     event_thread.request_stop();
     accept_thread.request_stop();
+    if(notify_thread.joinable()) notify_thread.request_stop();
+    if(bus_thread.joinable()) bus_thread.request_stop();
     registry.request_wakeup();
     listener.request_wakeup();
     event_thread.join();
     accept_thread.join();
+    if(notify_thread.joinable()) notify_thread.join();
+    if(bus_thread.joinable()) bus_thread.join();
 
     if(error_opt) return std::unexpected(*error_opt);
     logger::log_info("server is stopped");
@@ -160,6 +215,7 @@ std::expected <void, error_code> epoll_server::progress_tls_handshake(socket_inf
 
     if(!was_handshake_done && si.tls.is_handshake_done()){
         logger::log_info("tls handshake done", si);
+        registry.note_handshake_done(si);
     }
 
     return {};
@@ -178,6 +234,7 @@ void epoll_server::handle_send(socket_info& si){
     }
 
     logger::log_info("send " + std::to_string(*fs_exp) + " byte" + (*fs_exp == 1 ? "" : "s"), si);
+    registry.note_flushed(si, *fs_exp);
 
     auto sync_exp = sync_tls_interest(si);
     if(!sync_exp){
@@ -191,7 +248,7 @@ bool epoll_server::handle_recv(socket_info& si, uint32_t event){
     if(!hs_exp) return false;
     if(si.tls.get() != nullptr && !si.tls.is_handshake_done()) return true;
 
-    auto dr_exp = drain_recv(si);
+    auto dr_exp = drain_recv(si, registry.get_recv_limits().buffer_cap);
     if(!dr_exp){
         logger::log_error("drain_recv failed", "epoll_server::handle_recv()", si, dr_exp);
         handle_disconnect(si);
@@ -199,6 +256,8 @@ bool epoll_server::handle_recv(socket_info& si, uint32_t event){
     }
 
     auto recv_info = *dr_exp;
+    si.recv_capped = recv_info.capped;
+    if(recv_info.byte > 0) registry.note_recv(si);
     logger::log_info("recv " + std::to_string(recv_info.byte) + " byte" + (recv_info.byte == 1 ? "" : "s"), si);
 
     auto sync_exp = sync_tls_interest(si);
@@ -229,67 +288,197 @@ void epoll_server::handle_close(socket_info& si){
     handle_disconnect(si);
 }
 
-void epoll_server::handle_client_error(int fd, uint32_t event){
-    auto it = registry.find(fd);
-    if(it == registry.end()){
+void epoll_server::handle_client_error(conn_handle conn, uint32_t event){
+    socket_info* si = registry.find(conn);
+    if(si == nullptr){
         return;
     }
-    if(it->second.is_closed){
+    if(si->is_closed){
         return;
     }
 
-    if(it->second.tls.is_handshake_done()){
-        auto shutdown_exp = it->second.tls.shutdown();
-        if(!shutdown_exp) logger::log_warn("shutdown_failed", "epoll_server::handle_client_error()", it->second, shutdown_exp);
+    if(si->tls.is_handshake_done()){
+        auto shutdown_exp = si->tls.shutdown();
+        if(!shutdown_exp) logger::log_warn("shutdown_failed", "epoll_server::handle_client_error()", *si, shutdown_exp);
     }
 
     int ec = ECONNRESET;
     int so_error = 0;
     socklen_t len = sizeof(so_error);
-    if(::getsockopt(fd, SOL_SOCKET, SO_ERROR, &so_error, &len) == -1){
+    if(::getsockopt(conn.fd, SOL_SOCKET, SO_ERROR, &so_error, &len) == -1){
         ec = errno;
     }
     else if(so_error != 0){
         ec = so_error;
     }
 
-    logger::log_error("client_error", "epoll_server::handle_client_error()", it->second, error_code::from_errno(ec));
-    handle_disconnect(it->second);
+    logger::log_error("client_error", "epoll_server::handle_client_error()", *si, error_code::from_errno(ec));
+    handle_disconnect(*si);
+}
+
+bool epoll_server::negotiate_format(socket_info& si){
+    auto format_exp = command_codec::detect_wire_format(std::string_view(si.recv.current_data(), si.recv.remaining()));
+    if(!format_exp){
+        logger::log_warn("wire format rejected", "epoll_server::negotiate_format()", si, format_exp);
+        handle_disconnect(si);
+        return false;
+    }
+    if(!*format_exp) return false;
+
+    if(**format_exp == command_codec::wire_format::binary){
+        si.recv.advance(command_codec::binary_preamble().size());
+        logger::log_info("wire format: binary", si);
+    }
+    si.send.set_format(**format_exp);
+    si.format_negotiated = true;
+    return true;
 }
 
 bool epoll_server::handle_execute(socket_info& si){
-    auto line = line_parser::parse_line(si.recv);
-    if(!line) return false;
+    if(si.is_closed) return false;
+    if(execute_batch(si)) return true;
+    if(si.is_closed) return false;
+
+    if(registry.get_recv_limits().release_drained) si.recv.release_if_done();
+    registry.update_recv_interest(si);
+    return false;
+}
+
+bool epoll_server::execute_batch(socket_info& si){
+    if(!si.format_negotiated && !negotiate_format(si)) return false;
+
+    const recv_limits& lim = registry.get_recv_limits();
+    if(si.inflight_db >= lim.max_inflight_db) return false;
+    const std::size_t batch = std::min<std::size_t>(FRAME_BATCH, lim.max_inflight_db - si.inflight_db);
+    if(si.send.get_format() == command_codec::wire_format::binary) return execute_binary(si, batch);
+
+    std::array<frame_scanner::frame, FRAME_BATCH> frames;
+    std::size_t count = line_parser::parse_frames(si.recv, std::span(frames).first(batch));
+    if(count == 0){
+        if(si.recv.remaining() <= lim.max_line) return false;
+        reject_oversized(si, si.recv.remaining());
+        return false;
+    }
 
-    auto dec_exp = command_codec::decode(*line);
+    for(std::size_t i = 0; i < count; ++i){
+        if(frames[i].line.size() > lim.max_line){
+            reject_oversized(si, frames[i].line.size());
+            return false;
+        }
+        if(!execute_frame(si, command_codec::decode(frames[i].info)) || si.is_closed) return false;
+    }
+    return true;
+}
+
+bool epoll_server::execute_binary(socket_info& si, std::size_t batch){
+    for(std::size_t i = 0; i < batch; ++i){
+        auto frame_exp = line_parser::parse_binary_frame(si.recv, registry.get_recv_limits().max_line);
+        if(!frame_exp){
+            logger::log_warn("binary frame rejected", "epoll_server::execute_binary()", si, frame_exp);
+            handle_disconnect(si);
+            return false;
+        }
+        if(!*frame_exp) return false;
+
+        if(!execute_frame(si, command_codec::decode_binary(**frame_exp)) || si.is_closed) return false;
+    }
+    return true;
+}
+
+void epoll_server::reject_oversized(socket_info& si, std::size_t byte){
+    logger::log_warn(
+        "line too long: " + std::to_string(byte) + " bytes", "epoll_server::execute_batch()", si,
+        error_code::from_decode(command_codec::decode_error::frame_too_large)
+    );
+    handle_disconnect(si);
+}
+
+void epoll_server::reject_unqueued(socket_info& si){
+    logger::log_warn(
+        "command queue refused", "epoll_server::execute_frame()", si, error_code::from_errno(ESHUTDOWN)
+    );
+    handle_disconnect(si);
+}
+
+bool epoll_server::execute_frame(
+    socket_info& si, const std::expected<command_codec::command_view, error_code>& dec_exp
+){
     if(!dec_exp){
-        logger::log_warn("decode failed", "epoll_server::handle_execute()", si, dec_exp);
+        logger::log_warn("decode failed", "epoll_server::execute_frame()", si, dec_exp);
         return true;
     }
 
-    auto cmd = std::move(*dec_exp);
+    // The frames after this one are already consumed from si.recv, so a
+    // refused command closes the connection rather than dropping input.
+    const auto& cmd = *dec_exp;
     if(db_executor::is_db_command(cmd)){
-        return db_pool.enqueue(std::move(cmd), registry, si);
+        if(!db_pool.enqueue(command_codec::materialize(cmd), registry, si)){
+            reject_unqueued(si);
+            return false;
+        }
+        ++si.inflight_db;
+        return true;
     }
 
     if(thread_pool::is_pool_command(cmd)){
-        return pool.enqueue(std::move(cmd), registry, si);
+        if(pool.enqueue(command_codec::materialize(cmd), registry, si)) return true;
+        reject_unqueued(si);
+        return false;
     }
 
-    std::visit([this, &si](auto&& c){
+    std::visit([this, &si](const auto& c){
         using T = std::decay_t<decltype(c)>;
-        if constexpr (std::is_same_v<T, command_codec::cmd_say>){
-            registry.request_broadcast(si, command_codec::cmd_response{c.text});
+        if constexpr (std::is_same_v<T, command_codec::basic_cmd_say<std::string_view>>){
+            registry.request_broadcast(si, command_codec::cmd_response{std::string(c.text)});
+        }
+
+        if constexpr (std::is_same_v<T, command_codec::basic_cmd_nick<std::string_view>>){
+            registry.request_change_nickname(si, std::string(c.nick));
+        }
+
+        if constexpr (std::is_same_v<T, command_codec::basic_cmd_response<std::string_view>>){
+            registry.request_send(si, command_codec::cmd_response{std::string(c.text)});
         }
 
-        if constexpr (std::is_same_v<T, command_codec::cmd_nick>){
-            registry.request_change_nickname(si, c.nick);
+        if constexpr (std::is_same_v<T, command_codec::basic_cmd_ping<std::string_view>>){
+            registry.reply(si, command_codec::cmd_pong{});
         }
 
-        if constexpr (std::is_same_v<T, command_codec::cmd_response>){
-            registry.request_send(si, command_codec::cmd_response{c.text});
+        if constexpr (std::is_same_v<T, command_codec::basic_cmd_search<std::string_view>>){
+            execute_search(si, c.room_id, c.terms);
         }
-    }, std::move(cmd));
+    }, cmd);
 
     return true;
 }
+
+void epoll_server::execute_search(socket_info& si, std::string_view room_id_text, std::string_view terms){
+    if(si.user_id.empty()){
+        registry.reply(si, command_codec::cmd_response{"login first"});
+        return;
+    }
+    if(search == nullptr){
+        registry.reply(si, command_codec::cmd_response{"search is disabled"});
+        return;
+    }
+
+    const auto room_id = command_codec::parse_positive(room_id_text);
+    if(!room_id){
+        registry.reply(si, command_codec::cmd_response{"invalid room id"});
+        return;
+    }
+    // Membership comes from the rooms indexed for this connection at login
+    // and on every room change, so no query is needed.
+    if(!si.joined_room_ids.contains(*room_id)){
+        registry.reply(si, command_codec::cmd_response{"room not found or no permission"});
+        return;
+    }
+
+    const auto matches = search->search(*room_id, terms, search_max_results);
+    response_block out;
+    out.push({"search: room=", std::to_string(*room_id), " count=", std::to_string(matches.size())});
+    for(const auto& m : matches){
+        out.push({"search: id=", std::to_string(m.id), " from=", m.sender_user_id, " text=", m.body});
+    }
+    registry.reply(si, out);
+}
@@ -0,0 +1,226 @@
+#include "server/server_options.hpp"
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+std::expected <server_options, error_code> server_options::from_config(const config_loader::config_map& cfg){
+    server_options opts{};
+
+    auto high_exp = config_loader::get_size_or(cfg, "send.high_watermark_bytes", opts.send.high_watermark);
+    if(!high_exp) return std::unexpected(high_exp.error());
+    auto low_exp = config_loader::get_size_or(cfg, "send.low_watermark_bytes", opts.send.low_watermark);
+    if(!low_exp) return std::unexpected(low_exp.error());
+    auto stall_exp = config_loader::get_size_or(
+        cfg, "send.stall_timeout_ms", static_cast<std::size_t>(opts.send.stall_timeout.count())
+    );
+    if(!stall_exp) return std::unexpected(stall_exp.error());
+    auto budget_exp = config_loader::get_size_or(cfg, "send.global_budget_bytes", opts.send.global_budget);
+    if(!budget_exp) return std::unexpected(budget_exp.error());
+
+    auto send_release_exp = config_loader::get_size_or(cfg, "send.release_drained", opts.send.release_drained);
+    if(!send_release_exp) return std::unexpected(send_release_exp.error());
+
+    if(*high_exp == 0 || *low_exp > *high_exp || *budget_exp < *high_exp || *send_release_exp > 1){
+        return std::unexpected(error_code::from_config(config_loader::config_error::invalid_value));
+    }
+
+    auto cap_exp = config_loader::get_size_or(cfg, "recv.buffer_cap_bytes", opts.recv.buffer_cap);
+    if(!cap_exp) return std::unexpected(cap_exp.error());
+    auto line_exp = config_loader::get_size_or(cfg, "recv.max_line_bytes", opts.recv.max_line);
+    if(!line_exp) return std::unexpected(line_exp.error());
+    auto inflight_exp = config_loader::get_size_or(cfg, "recv.max_inflight_db", opts.recv.max_inflight_db);
+    if(!inflight_exp) return std::unexpected(inflight_exp.error());
+
+    auto recv_release_exp = config_loader::get_size_or(cfg, "recv.release_drained", opts.recv.release_drained);
+    if(!recv_release_exp) return std::unexpected(recv_release_exp.error());
+
+    if(*line_exp == 0 || *cap_exp <= *line_exp || *inflight_exp == 0 || *recv_release_exp > 1){
+        return std::unexpected(error_code::from_config(config_loader::config_error::invalid_value));
+    }
+
+    auto handshake_exp = config_loader::get_size_or(
+        cfg, "timeout.handshake_ms", static_cast<std::size_t>(opts.timeouts.handshake.count())
+    );
+    if(!handshake_exp) return std::unexpected(handshake_exp.error());
+    auto idle_exp = config_loader::get_size_or(
+        cfg, "timeout.idle_ms", static_cast<std::size_t>(opts.timeouts.idle.count())
+    );
+    if(!idle_exp) return std::unexpected(idle_exp.error());
+    auto write_stall_exp = config_loader::get_size_or(
+        cfg, "timeout.write_stall_ms", static_cast<std::size_t>(opts.timeouts.write_stall.count())
+    );
+    if(!write_stall_exp) return std::unexpected(write_stall_exp.error());
+    auto heartbeat_exp = config_loader::get_size_or(
+        cfg, "timeout.heartbeat_ms", static_cast<std::size_t>(opts.timeouts.heartbeat.count())
+    );
+    if(!heartbeat_exp) return std::unexpected(heartbeat_exp.error());
+    if(*idle_exp != 0 && *heartbeat_exp >= *idle_exp){
+        return std::unexpected(error_code::from_config(config_loader::config_error::invalid_value));
+    }
+
+    auto push_exp = config_loader::get_size_or(cfg, "presence.push", opts.presence.push);
+    if(!push_exp) return std::unexpected(push_exp.error());
+    auto coalesce_exp = config_loader::get_size_or(
+        cfg, "presence.coalesce_ms", static_cast<std::size_t>(opts.presence.coalesce.count())
+    );
+    if(!coalesce_exp) return std::unexpected(coalesce_exp.error());
+    if(*push_exp > 1){
+        return std::unexpected(error_code::from_config(config_loader::config_error::invalid_value));
+    }
+
+    auto per_room_exp = config_loader::get_size_or(
+        cfg, "catchup.per_room", static_cast<std::size_t>(opts.catchup.per_room)
+    );
+    if(!per_room_exp) return std::unexpected(per_room_exp.error());
+    auto max_messages_exp = config_loader::get_size_or(
+        cfg, "catchup.max_messages", static_cast<std::size_t>(opts.catchup.max_messages)
+    );
+    if(!max_messages_exp) return std::unexpected(max_messages_exp.error());
+    if(*per_room_exp > 1000 || *max_messages_exp == 0 || *max_messages_exp > 10000){
+        return std::unexpected(error_code::from_config(config_loader::config_error::invalid_value));
+    }
+
+    auto unread_messages_exp = config_loader::get_size_or(cfg, "unread.flush_messages", opts.unread.max_messages);
+    if(!unread_messages_exp) return std::unexpected(unread_messages_exp.error());
+    auto unread_ms_exp = config_loader::get_size_or(
+        cfg, "unread.flush_ms", static_cast<std::size_t>(opts.unread.interval.count())
+    );
+    if(!unread_ms_exp) return std::unexpected(unread_ms_exp.error());
+    if(*unread_messages_exp == 0 || *unread_ms_exp == 0){
+        return std::unexpected(error_code::from_config(config_loader::config_error::invalid_value));
+    }
+
+    auto partition_rows_exp = config_loader::get_size_or(
+        cfg, "messages.partition_rows", static_cast<std::size_t>(opts.partitions.partition_rows)
+    );
+    if(!partition_rows_exp) return std::unexpected(partition_rows_exp.error());
+    auto partitions_ahead_exp = config_loader::get_size_or(
+        cfg, "messages.partitions_ahead", static_cast<std::size_t>(opts.partitions.partitions_ahead)
+    );
+    if(!partitions_ahead_exp) return std::unexpected(partitions_ahead_exp.error());
+    auto retention_exp = config_loader::get_size_or(
+        cfg, "messages.retention_days", static_cast<std::size_t>(opts.partitions.retention_days)
+    );
+    if(!retention_exp) return std::unexpected(retention_exp.error());
+    auto maintenance_exp = config_loader::get_size_or(
+        cfg, "messages.maintenance_ms", static_cast<std::size_t>(opts.partitions.interval.count())
+    );
+    if(!maintenance_exp) return std::unexpected(maintenance_exp.error());
+    if(*partition_rows_exp == 0 || *partition_rows_exp > (std::size_t{1} << 40) || *partitions_ahead_exp == 0
+        || *partitions_ahead_exp > 100 || *retention_exp > 36500 || *maintenance_exp == 0){
+        return std::unexpected(error_code::from_config(config_loader::config_error::invalid_value));
+    }
+
+    std::string index_path = config_loader::get_or(cfg, "search.index_path", opts.search.index_path);
+    auto max_results_exp = config_loader::get_size_or(cfg, "search.max_results", opts.search.max_results);
+    if(!max_results_exp) return std::unexpected(max_results_exp.error());
+    auto search_sync_exp = config_loader::get_size_or(
+        cfg, "search.sync_ms", static_cast<std::size_t>(opts.search.sync_interval.count())
+    );
+    if(!search_sync_exp) return std::unexpected(search_sync_exp.error());
+    if(*max_results_exp == 0 || *max_results_exp > 1000 || *search_sync_exp == 0){
+        return std::unexpected(error_code::from_config(config_loader::config_error::invalid_value));
+    }
+
+    auto cluster_enabled_exp = config_loader::get_size_or(cfg, "cluster.enabled", opts.cluster.enabled);
+    if(!cluster_enabled_exp) return std::unexpected(cluster_enabled_exp.error());
+    auto batch_window_exp = config_loader::get_size_or(
+        cfg, "cluster.batch_window_ms", static_cast<std::size_t>(opts.cluster.batch_window.count())
+    );
+    if(!batch_window_exp) return std::unexpected(batch_window_exp.error());
+    auto batch_max_exp = config_loader::get_size_or(cfg, "cluster.batch_max", opts.cluster.batch_max);
+    if(!batch_max_exp) return std::unexpected(batch_max_exp.error());
+
+    std::string channel = config_loader::get_or(cfg, "cluster.channel", opts.cluster.channel);
+    std::string node_id = config_loader::get_or(cfg, "cluster.node_id", "");
+    if(node_id.empty()) node_id = room_notify::make_node_id();
+    if(*cluster_enabled_exp > 1 || *batch_max_exp == 0 || channel.empty() || node_id.find(':') != std::string::npos){
+        return std::unexpected(error_code::from_config(config_loader::config_error::invalid_value));
+    }
+
+    auto bus_flush_exp = config_loader::get_size_or(
+        cfg, "cluster.bus_flush_ms", static_cast<std::size_t>(opts.cluster.bus_flush_delay.count())
+    );
+    if(!bus_flush_exp) return std::unexpected(bus_flush_exp.error());
+    auto bus_flush_bytes_exp = config_loader::get_size_or(cfg, "cluster.bus_flush_bytes", opts.cluster.bus_flush_bytes);
+    if(!bus_flush_bytes_exp) return std::unexpected(bus_flush_bytes_exp.error());
+    auto bus_reconnect_exp = config_loader::get_size_or(
+        cfg, "cluster.bus_reconnect_ms", static_cast<std::size_t>(opts.cluster.bus_reconnect.count())
+    );
+    if(!bus_reconnect_exp) return std::unexpected(bus_reconnect_exp.error());
+    auto digest_exp = config_loader::get_size_or(
+        cfg, "cluster.presence_digest_ms", static_cast<std::size_t>(opts.cluster.presence_digest_interval.count())
+    );
+    if(!digest_exp) return std::unexpected(digest_exp.error());
+
+    const std::string transport = config_loader::get_or(cfg, "cluster.transport", "notify");
+    const bool use_bus = transport == "bus";
+    if((!use_bus && transport != "notify") || *bus_flush_bytes_exp == 0 || *digest_exp == 0){
+        return std::unexpected(error_code::from_config(config_loader::config_error::invalid_value));
+    }
+
+    host_port bus_listen;
+    std::vector<host_port> bus_peers;
+    if(use_bus){
+        auto listen_opt = host_port::parse(config_loader::get_or(cfg, "cluster.bus_listen", ""));
+        if(!listen_opt) return std::unexpected(error_code::from_config(config_loader::config_error::invalid_value));
+        bus_listen = std::move(*listen_opt);
+
+        const std::string peers_raw = config_loader::get_or(cfg, "cluster.bus_peers", "");
+        std::string_view rest = peers_raw;
+        while(!rest.empty()){
+            const std::size_t comma = rest.find(',');
+            std::string_view item = rest.substr(0, comma);
+            rest = comma == std::string_view::npos ? std::string_view{} : rest.substr(comma + 1);
+
+            while(!item.empty() && item.front() == ' ') item.remove_prefix(1);
+            while(!item.empty() && item.back() == ' ') item.remove_suffix(1);
+            if(item.empty()) continue;
+
+            auto peer_opt = host_port::parse(item);
+            if(!peer_opt) return std::unexpected(error_code::from_config(config_loader::config_error::invalid_value));
+            bus_peers.push_back(std::move(*peer_opt));
+        }
+    }
+
+    opts.send.high_watermark = *high_exp;
+    opts.send.low_watermark = *low_exp;
+    opts.send.stall_timeout = std::chrono::milliseconds(*stall_exp);
+    opts.send.global_budget = *budget_exp;
+    opts.send.release_drained = *send_release_exp == 1;
+    opts.recv.buffer_cap = *cap_exp;
+    opts.recv.max_line = *line_exp;
+    opts.recv.max_inflight_db = *inflight_exp;
+    opts.recv.release_drained = *recv_release_exp == 1;
+    opts.timeouts.handshake = std::chrono::milliseconds(*handshake_exp);
+    opts.timeouts.idle = std::chrono::milliseconds(*idle_exp);
+    opts.timeouts.write_stall = std::chrono::milliseconds(*write_stall_exp);
+    opts.timeouts.heartbeat = std::chrono::milliseconds(*heartbeat_exp);
+    opts.presence.push = *push_exp == 1;
+    opts.presence.coalesce = std::chrono::milliseconds(*coalesce_exp);
+    opts.catchup.per_room = static_cast<std::int32_t>(*per_room_exp);
+    opts.catchup.max_messages = static_cast<std::int32_t>(*max_messages_exp);
+    opts.unread.max_messages = *unread_messages_exp;
+    opts.unread.interval = std::chrono::milliseconds(*unread_ms_exp);
+    opts.partitions.partition_rows = static_cast<std::int64_t>(*partition_rows_exp);
+    opts.partitions.partitions_ahead = static_cast<std::int32_t>(*partitions_ahead_exp);
+    opts.partitions.retention_days = static_cast<std::int32_t>(*retention_exp);
+    opts.partitions.interval = std::chrono::milliseconds(*maintenance_exp);
+    opts.search.index_path = std::move(index_path);
+    opts.search.max_results = *max_results_exp;
+    opts.search.sync_interval = std::chrono::milliseconds(*search_sync_exp);
+    opts.cluster.enabled = *cluster_enabled_exp == 1;
+    opts.cluster.channel = std::move(channel);
+    opts.cluster.node_id = std::move(node_id);
+    opts.cluster.batch_window = std::chrono::milliseconds(*batch_window_exp);
+    opts.cluster.batch_max = *batch_max_exp;
+    opts.cluster.transport = use_bus ? cluster_transport::bus : cluster_transport::notify;
+    opts.cluster.bus_listen = std::move(bus_listen);
+    opts.cluster.bus_peers = std::move(bus_peers);
+    opts.cluster.bus_flush_delay = std::chrono::milliseconds(*bus_flush_exp);
+    opts.cluster.bus_flush_bytes = *bus_flush_bytes_exp;
+    opts.cluster.bus_reconnect = std::chrono::milliseconds(*bus_reconnect_exp);
+    opts.cluster.presence_digest_interval = std::chrono::milliseconds(*digest_exp);
+    return opts;
+}